@@ -11,7 +11,7 @@ void ESPHomeKit::onGetAccessories(HKClient *client) {
 
     JSON json = JSON(1024, std::bind(&HKClient::sendChunk, client, std::placeholders::_1, std::placeholders::_2));
     json.startObject();
-    json.setString("accessories");
+    json.setKey("accessories");
     json.startArray();
 
     accessory->serializeToJSON(json, nullptr, client);
@@ -46,6 +46,7 @@ void ESPHomeKit::onGetCharacteristics(HKClient *client, String id, bool meta, bo
     }
 
     bool success = true;
+    std::vector<HKReadRequest> requests;
 
     String idCpy = id;
     while (idCpy.length() > 0) {
@@ -67,6 +68,8 @@ void ESPHomeKit::onGetCharacteristics(HKClient *client, String id, bool meta, bo
             if (HKCharacteristic* target = accessory->findCharacteristic(iid)) {
                 if (!(target->permissions & HKPermissionPairedRead)) {
                     success = false;
+                } else if (accessory->batchGetter) {
+                    requests.push_back({target, HKValue()});
                 }
             } else {
                 HKLOGWARNING("[HKClient::onGetCharacteristics] Could not find characteristic with id=%d.%d\r\n", aid, iid);
@@ -90,9 +93,12 @@ void ESPHomeKit::onGetCharacteristics(HKClient *client, String id, bool meta, bo
         free(response);
     }
 
+    accessory->readValues(requests);
+    auto request = requests.begin();
+
     JSON json = JSON(1024, std::bind(&HKClient::sendChunk, client, std::placeholders::_1, std::placeholders::_2));
     json.startObject();
-    json.setString("characteristics");
+    json.setKey("characteristics");
     json.startArray();
 
     while (id.length() > 0) {
@@ -111,43 +117,51 @@ void ESPHomeKit::onGetCharacteristics(HKClient *client, String id, bool meta, bo
 
                 json.startObject();
 
-                json.setString("aid");
+                json.setKey("aid");
                 json.setInt(aid);
 
                 if (!(target->permissions & HKPermissionPairedRead)) {
-                    json.setString("iid");
+                    json.setKey("iid");
                     json.setInt(iid);
-                    json.setString("status");
+                    json.setKey("status");
                     json.setInt(HAPStatusWriteOnly);
                     json.endObject();
                     continue;
                 }
 
-                target->serializeToJSON(json, nullptr, format, client);
+                // Requests are in the same order as the readable characteristics
+                HKValue *value = nullptr;
+                if (request != requests.end() && request->characteristic == target) {
+                    if (!request->value.isNull) {
+                        value = &request->value;
+                    }
+                    request++;
+                }
+                target->serializeToJSON(json, value, format, client);
 
                 if (!success) {
-                    json.setString("status");
+                    json.setKey("status");
                     json.setInt(HAPStatusSuccess);
                 }
 
                 json.endObject();
             } else {
                 json.startObject();
-                json.setString("aid");
+                json.setKey("aid");
                 json.setInt(aid);
-                json.setString("iid");
+                json.setKey("iid");
                 json.setInt(iid);
-                json.setString("status");
+                json.setKey("status");
                 json.setInt(HAPStatusNoResource);
                 json.endObject();
             }
         } else {
             json.startObject();
-            json.setString("aid");
+            json.setKey("aid");
             json.setInt(aid);
-            json.setString("iid");
+            json.setKey("iid");
             json.setInt(iid);
-            json.setString("status");
+            json.setKey("status");
             json.setInt(HAPStatusNoResource);
             json.endObject();
         }
@@ -194,103 +208,141 @@ void ESPHomeKit::onIdentify(HKClient *client) {
     }
 }
 
+/**
+ * @brief Find a string in a range of the request body
+ * 
+ * @param begin Begin of range
+ * @param end End of range
+ * @param needle Null terminated string to find
+ * @return const char* First occurrence, nullptr if not in range
+ */
+static const char *findInBody(const char *begin, const char *end, const char *needle) {
+    size_t needleLength = strlen(needle);
+    for (const char *p = begin; p + needleLength <= end; p++) {
+        if (memcmp(p, needle, needleLength) == 0) {
+            return p;
+        }
+    }
+    return nullptr;
+}
+
+/**
+ * @brief Locate the JSON value of a key inside an item of the request body, without copying it
+ * 
+ * @param begin Begin of the item
+ * @param end End of the item
+ * @param key Position of the quoted key
+ * @param valueEnd End of the value, whitespace trimmed
+ * @return const char* Begin of the value, nullptr if the key has no value
+ */
+static const char *findBodyValue(const char *begin, const char *end, const char *key, const char *&valueEnd) {
+    const char *valueBegin = (const char *) memchr(key, ':', end - key);
+    if (!valueBegin) {
+        return nullptr;
+    }
+    valueBegin++;
+    valueEnd = (const char *) memchr(valueBegin, ',', end - valueBegin);
+    if (!valueEnd) {
+        valueEnd = end;
+    }
+    while (valueBegin < valueEnd && isspace(*valueBegin)) {
+        valueBegin++;
+    }
+    while (valueEnd > valueBegin && isspace(valueEnd[-1])) {
+        valueEnd--;
+    }
+    return valueBegin;
+}
+
 void ESPHomeKit::onUpdateCharacteristics(HKClient *client, uint8_t *message, const size_t &messageSize) {
     HKLOGINFO("[HKClient::onUpdateCharacteristics] Update Characteristics\r\n");
 
-    char *jsonBodyStr = (char *) malloc(messageSize+1);
-    memcpy(jsonBodyStr, message, messageSize);
-    jsonBodyStr[messageSize] = 0;
-    String jsonBody = String(jsonBodyStr);
-    free(jsonBodyStr);
-
-    if (jsonBody.substring(0, 20) != "{\"characteristics\":[") {
+    // The body is parsed where it is, values are handed to the characteristics as ranges of it
+    const char *body = (const char *) message;
+    const char *bodyEnd = body + messageSize;
+    const char prefix[] = "{\"characteristics\":[";
+    if (messageSize < sizeof(prefix) - 1 || memcmp(body, prefix, sizeof(prefix) - 1) != 0) {
         HKLOGERROR("[HKClient::onUpdateCharacteristics] Could not deserialize json beginning not equal\r\n");
         client->sendJSONErrorResponse(400, HAPStatusInvalidValue);
         return;
     }
 
-    uint cursor = 20;
-    while (jsonBody.length() > cursor) {
-        int begin = jsonBody.indexOf('{', cursor);
-        int end = jsonBody.indexOf('}', cursor);
-        if (begin == -1 || end == -1) {
+    std::vector<HKCharacteristic *> changed;
+    const char *cursor = body + sizeof(prefix) - 1;
+    while (cursor < bodyEnd) {
+        const char *begin = (const char *) memchr(cursor, '{', bodyEnd - cursor);
+        const char *end = (const char *) memchr(cursor, '}', bodyEnd - cursor);
+        if (!begin || !end || end < begin) {
             break;
         }
-        String item = jsonBody.substring(begin + 1, end);
+        begin++;
 
-        int aidPos = item.indexOf("\"aid\"");
-        int iidPos = item.indexOf("\"iid\"");
-        int evPos = item.indexOf("\"ev\"");
-        int valuePos = item.indexOf("\"value\"");
-        if (aidPos == -1 || iidPos == -1 || (evPos == -1 && valuePos == -1)) {
+        const char *aidPos = findInBody(begin, end, "\"aid\"");
+        const char *iidPos = findInBody(begin, end, "\"iid\"");
+        const char *evPos = findInBody(begin, end, "\"ev\"");
+        const char *valuePos = findInBody(begin, end, "\"value\"");
+        if (!aidPos || !iidPos || (!evPos && !valuePos)) {
             break;
         }
 
-        int aidBeginPos = item.indexOf(':', aidPos);
-        int aidEndPos = item.indexOf(',', aidPos);
-        int iidBeginPos = item.indexOf(':', iidPos);
-        int iidEndPos = item.indexOf(',', iidPos);
-        if (aidBeginPos == -1 || aidEndPos == -1 || iidBeginPos == -1 || iidEndPos == -1) {
+        const char *aidEnd;
+        const char *iidEnd;
+        const char *aidBegin = findBodyValue(begin, end, aidPos, aidEnd);
+        const char *iidBegin = findBodyValue(begin, end, iidPos, iidEnd);
+        if (!aidBegin || !iidBegin || aidEnd == end || iidEnd == end) {
             break;
         }
 
-        int aid = item.substring(aidBeginPos + 1, aidEndPos).toInt();
-        int iid = item.substring(iidBeginPos + 1, iidEndPos).toInt();
+        uint aid = strtoul(aidBegin, nullptr, 10);
+        uint iid = strtoul(iidBegin, nullptr, 10);
         if (aid == 0 || iid == 0) {
             break;
         }
 
         String ev;
-        String value;
-        if (evPos != -1) {
-            int evBeginPos = item.indexOf(':', evPos);
-            int evEndPosSeparator = item.indexOf(',', evPos);
-            int evEndPosEnd = item.indexOf('}', evPos);
-            int evEndPos;
-            if (evEndPosEnd == -1) {
-                evEndPosEnd = item.length();
-            }
-            if (evEndPosSeparator == -1 || evEndPosSeparator > evEndPosEnd) {
-                evEndPos = evEndPosEnd;
-            } else {
-                evEndPos = evEndPosSeparator;
-            }
-            if (evBeginPos != -1 && evEndPos != -1) {
-                ev = item.substring(evBeginPos + 1, evEndPos);
-                ev.trim();
+        if (evPos) {
+            const char *evEnd;
+            const char *evBegin = findBodyValue(begin, end, evPos, evEnd);
+            if (evBegin) {
+                ev.concat(evBegin, evEnd - evBegin);
             }
         }
-        if (valuePos != -1) {
-            int valueBeginPos = item.indexOf(':', valuePos);
-            int valueEndPosSeparator = item.indexOf(',', valuePos);
-            int valueEndPosEnd = item.indexOf('}', valuePos);
-            int valueEndPos;
-            if (valueEndPosEnd == -1) {
-                valueEndPosEnd = item.length();
-            }
-            if (valueEndPosSeparator == -1 || valueEndPosSeparator > valueEndPosEnd) {
-                valueEndPos = valueEndPosEnd;
-            } else {
-                valueEndPos = valueEndPosSeparator;
-            }
-            if (valueBeginPos != -1 && valueEndPos != -1) {
-                value = item.substring(valueBeginPos + 1, valueEndPos);
-                value.trim();
+        const char *value = nullptr;
+        size_t valueLength = 0;
+        if (valuePos) {
+            const char *valueEnd;
+            value = findBodyValue(begin, end, valuePos, valueEnd);
+            if (value) {
+                valueLength = valueEnd - value;
             }
         }
 
-        processUpdateCharacteristic(client, aid, iid, ev, value);
+        processUpdateCharacteristic(client, aid, iid, ev, value, valueLength, changed);
 
         cursor = end + 1;
     }
 
+    accessory->commitValues(changed);
+
     char *response = (char *) malloc(sizeof(http_header_204));
     strcpy_P(response, http_header_204);
     client->send((uint8_t *) response, sizeof(http_header_204)-1);
     free(response);
 }
 
-HAPStatus ESPHomeKit::processUpdateCharacteristic(HKClient *client, uint aid, uint iid, String ev, String value) {
+/**
+ * @brief Write value and event registration of one characteristic of a PUT /characteristics request
+ * 
+ * @param client Client that sent the request
+ * @param aid Accessory id
+ * @param iid Characteristic id
+ * @param ev Event registration as JSON, empty if not requested
+ * @param value Value as JSON inside the request body, not null terminated
+ * @param valueLength Length of value, 0 if no value is written
+ * @param changed Characteristics changed by the request
+ * @return HAPStatus Status of the write
+ */
+HAPStatus ESPHomeKit::processUpdateCharacteristic(HKClient *client, uint aid, uint iid, const String &ev, const char *value, size_t valueLength, std::vector<HKCharacteristic *> &changed) {
     if (accessory->getId() != aid) {
         HKLOGWARNING("[HKClient::processUpdateCharacteristic] Could not find accessory with id=%d\r\n", aid);
         return HAPStatusNoResource;
@@ -303,11 +355,14 @@ HAPStatus ESPHomeKit::processUpdateCharacteristic(HKClient *client, uint aid, ui
     }
 
     HAPStatus status = HAPStatusSuccess;
-    if (value.length() > 0) {
-        status = characteristic->setValue(value);
+    if (valueLength > 0) {
+        status = characteristic->setValue(value, valueLength, client);
         if (status != HAPStatusSuccess) {
             return status;
         }
+        if (std::find(changed.begin(), changed.end(), characteristic) == changed.end()) {
+            changed.push_back(characteristic);
+        }
     }
 
     if (ev.length() > 0) {
@@ -316,6 +371,24 @@ HAPStatus ESPHomeKit::processUpdateCharacteristic(HKClient *client, uint aid, ui
     return status;
 }
 
+/**
+ * @brief Copy a device identifier from a TLV into a null terminated buffer of sizeof(Pairing::deviceId) + 1 bytes
+ * 
+ * @param target Target buffer
+ * @param deviceId Identifier, not null terminated
+ * @param size Size of identifier
+ * @return true Copied
+ * @return false Identifier does not fit into a pairing, nothing copied
+ */
+static bool copyDeviceIdentifier(char *target, const uint8_t *deviceId, size_t size) {
+    if (size > sizeof(Pairing::deviceId)) {
+        return false;
+    }
+    memcpy(target, deviceId, size);
+    target[size] = '\0';
+    return true;
+}
+
 /**
  * @brief Handle /pair-setup HomeKit endpoint
  * 
@@ -324,15 +397,9 @@ HAPStatus ESPHomeKit::processUpdateCharacteristic(HKClient *client, uint aid, ui
  * @param MessageSize Size of message
  */
 void ESPHomeKit::onPairSetup(HKClient *client, uint8_t *message, const size_t &messageSize) {
-    std::vector<HKTLV *> tlvs = HKTLV::parseTLV(message, messageSize);
+    HKTLVReader tlvs(message, messageSize);
 
-    int8_t value = -1;
-    HKTLV *state = HKTLV::findTLV(tlvs, TLVTypeState);
-    if (state) {
-        value = state->getIntValue();
-    }
-
-    switch (value) {
+    switch (tlvs.getIntValue(TLVTypeState)) {
     case 1: {
         HKLOGINFO("[HKClient::onPairSetup] Setup Step 1/3\r\n");
         if (HKStorage::isPaired()) {
@@ -351,21 +418,19 @@ void ESPHomeKit::onPairSetup(HKClient *client, uint8_t *message, const size_t &m
         client->setPairing(true);
         srp->start();
 
-        for (auto it = tlvs.begin(); it != tlvs.end();) {
-            delete *it;
-            it = tlvs.erase(it);
-        }
-        tlvs.push_back(new HKTLV(TLVTypeState, 2, 1));
-        tlvs.push_back(new HKTLV(TLVTypePublicKey, srp->getB(), 384));
-        tlvs.push_back(new HKTLV(TLVTypeSalt, srp->getSalt(), 16));
+        // The public key is fragmented into 255 and 129 bytes
+        HKTLVWriter response(3 + 384 + 4 + 18);
+        response.add(TLVTypeState, 2);
+        response.add(TLVTypePublicKey, srp->getB(), 384);
+        response.add(TLVTypeSalt, srp->getSalt(), 16);
 
-        client->sendTLVResponse(tlvs);
+        client->sendTLVResponse(response);
     }
     break;
     case 3: {
         HKLOGINFO("[HKClient::onPairSetup] Setup Step 2/3\r\n");
-        HKTLV* publicKey = HKTLV::findTLV(tlvs, TLVTypePublicKey);
-        HKTLV* proof = HKTLV::findTLV(tlvs, TLVTypeProof);
+        const uint8_t *publicKey = tlvs.getValue(TLVTypePublicKey);
+        const uint8_t *proof = tlvs.getValue(TLVTypeProof);
         if (!publicKey || !proof) {
             HKLOGWARNING("[HKClient::onPairSetup] Could not find Public Key or Proof in Message\r\n");
             client->sendTLVError(4, TLVErrorAuthentication);
@@ -373,17 +438,15 @@ void ESPHomeKit::onPairSetup(HKClient *client, uint8_t *message, const size_t &m
             break;
         }
 
-        srp->setA(publicKey->getValue(), publicKey->getSize(), nullptr);
+        srp->setA((uint8_t *) publicKey, tlvs.getSize(TLVTypePublicKey), nullptr);
+        HKLOGDEBUG("[HKClient::onPairSetup] SRP MPI pool peak: %u of %u bytes, %u on heap\r\n", mbedtls_mpi_pool_peak(), SRP_MPI_POOL_SIZE, mbedtls_mpi_pool_overflows());
 
-        if (srp->checkM1(proof->getValue(), proof->getSize())) {
-            for (auto it = tlvs.begin(); it != tlvs.end();) {
-                delete *it;
-                it = tlvs.erase(it);
-            }
-            tlvs.push_back(new HKTLV(TLVTypeState, 4, 1));
-            tlvs.push_back(new HKTLV(TLVTypeProof, srp->getM2(), 64));
+        if (srp->checkM1((uint8_t *) proof, tlvs.getSize(TLVTypeProof))) {
+            HKTLVWriter response(3 + 66);
+            response.add(TLVTypeState, 4);
+            response.add(TLVTypeProof, srp->getM2(), 64);
 
-            client->sendTLVResponse(tlvs);
+            client->sendTLVResponse(response);
         } else {
             //return error
             HKLOGERROR("[HKClient::onPairSetup] SRP Error\r\n");
@@ -397,58 +460,59 @@ void ESPHomeKit::onPairSetup(HKClient *client, uint8_t *message, const size_t &m
 
         uint8_t sharedSecret[32];
         const char salt1[] = "Pair-Setup-Encrypt-Salt";
-        const char info1[] = "Pair-Setup-Encrypt-Info\001";
+        const char info1[] = "Pair-Setup-Encrypt-Info";
         hkdf(sharedSecret, srp->getK(), 64, (uint8_t *) salt1, sizeof(salt1)-1, (uint8_t *) info1, sizeof(info1)-1);
 
-        HKTLV *encryptedTLV = HKTLV::findTLV(tlvs, TLVTypeEncryptedData);
-        if (!encryptedTLV) {
+        const uint8_t *encryptedData = tlvs.getValue(TLVTypeEncryptedData);
+        size_t encryptedSize = tlvs.getSize(TLVTypeEncryptedData);
+        // The cipher takes 8 bit lengths, so the decrypted message fits on the stack
+        if (!encryptedData || encryptedSize < 16 || encryptedSize - 16 > 255) {
             HKLOGERROR("[HKClient::onPairSetup] Failed: Could not find Encrypted Data\r\n");
             client->sendTLVError(6, TLVErrorAuthentication);
             client->setPairing(false);
             break;
         }
 
-        size_t decryptedDataSize = encryptedTLV->getSize() - 16;
-        uint8_t *decryptedData = (uint8_t *) malloc(decryptedDataSize);
+        size_t decryptedDataSize = encryptedSize - 16;
+        uint8_t decryptedData[255];
 
-        if (!crypto_verifyAndDecrypt(sharedSecret, (uint8_t *) "PS-Msg05", encryptedTLV->getValue(), decryptedDataSize, decryptedData, encryptedTLV->getValue() + decryptedDataSize)) {
+        if (!crypto_verifyAndDecrypt(sharedSecret, (uint8_t *) "PS-Msg05", (uint8_t *) encryptedData, decryptedDataSize, decryptedData, (uint8_t *) encryptedData + decryptedDataSize)) {
             HKLOGERROR("[HKClient::onPairSetup] Decryption failed: MAC not equal\r\n");
-            free(decryptedData);
             client->sendTLVError(6, TLVErrorAuthentication);
             client->setPairing(false);
             break;
         }
 
-        std::vector<HKTLV *> decryptedMessage = HKTLV::parseTLV(decryptedData, decryptedDataSize);
-        free(decryptedData);
-        HKTLV *deviceId = HKTLV::findTLV(decryptedMessage, TLVTypeIdentifier);
+        HKTLVReader decryptedMessage(decryptedData, decryptedDataSize);
+        const uint8_t *deviceId = decryptedMessage.getValue(TLVTypeIdentifier);
+        size_t deviceIdSize = decryptedMessage.getSize(TLVTypeIdentifier);
         if (!deviceId) {
             HKLOGERROR("[HKClient::onPairSetup] Decryption failed: Device ID not found in decrypted Message\r\n");
-            for (auto msg : decryptedMessage) {
-                delete msg;
-            }
             client->sendTLVError(6, TLVErrorAuthentication);
             client->setPairing(false);
             break;
         }
 
-        HKTLV *publicKey = HKTLV::findTLV(decryptedMessage, TLVTypePublicKey);
+        char deviceIdentifier[sizeof(Pairing::deviceId) + 1];
+        if (!copyDeviceIdentifier(deviceIdentifier, deviceId, deviceIdSize)) {
+            HKLOGERROR("[HKClient::onPairSetup] Device ID is longer than %u bytes\r\n", sizeof(Pairing::deviceId));
+            client->sendTLVError(6, TLVErrorAuthentication);
+            client->setPairing(false);
+            break;
+        }
+
+        const uint8_t *publicKey = decryptedMessage.getValue(TLVTypePublicKey);
+        size_t publicKeySize = decryptedMessage.getSize(TLVTypePublicKey);
         if (!publicKey) {
             HKLOGERROR("[HKClient::onPairSetup] Decryption failed: Public Key not found in decrypted Message\r\n");
-            for (auto msg : decryptedMessage) {
-                delete msg;
-            }
             client->sendTLVError(6, TLVErrorAuthentication);
             client->setPairing(false);
             break;
         }
 
-        HKTLV *signature = HKTLV::findTLV(decryptedMessage, TLVTypeSignature);
+        const uint8_t *signature = decryptedMessage.getValue(TLVTypeSignature);
         if (!signature) {
             HKLOGERROR("[HKClient::onPairSetup] Decryption failed: Signature not found in decrypted Message\r\n");
-            for (auto msg : decryptedMessage) {
-                delete msg;
-            }
             client->sendTLVError(6, TLVErrorAuthentication);
             client->setPairing(false);
             break;
@@ -456,76 +520,67 @@ void ESPHomeKit::onPairSetup(HKClient *client, uint8_t *message, const size_t &m
 
         uint8_t deviceX[32];
         const char salt2[] = "Pair-Setup-Controller-Sign-Salt";
-        const char info2[] = "Pair-Setup-Controller-Sign-Info\001";
+        const char info2[] = "Pair-Setup-Controller-Sign-Info";
         hkdf(deviceX, srp->getK(), 64, (uint8_t *) salt2, sizeof(salt2)-1, (uint8_t *) info2, sizeof(info2)-1);
 
-        uint64_t deviceInfoSize = sizeof(deviceX) + deviceId->getSize() + publicKey->getSize();
+        uint64_t deviceInfoSize = sizeof(deviceX) + deviceIdSize + publicKeySize;
         uint8_t *deviceInfo = (uint8_t *) malloc(deviceInfoSize);
         memcpy(deviceInfo, deviceX, sizeof(deviceX));
-        memcpy(deviceInfo + sizeof(deviceX), deviceId->getValue(), deviceId->getSize());
-        memcpy(deviceInfo + sizeof(deviceX) + deviceId->getSize(), publicKey->getValue(), publicKey->getSize());
+        memcpy(deviceInfo + sizeof(deviceX), deviceId, deviceIdSize);
+        memcpy(deviceInfo + sizeof(deviceX) + deviceIdSize, publicKey, publicKeySize);
 
-        if (!Ed25519::verify(signature->getValue(), publicKey->getValue(), deviceInfo, deviceInfoSize)) {
+        if (decryptedMessage.getSize(TLVTypeSignature) != 64 || publicKeySize != 32 || crypto_sign_ed25519_verify_detached(signature, deviceInfo, deviceInfoSize, publicKey) != 0) {
             HKLOGERROR("[HKClient::onPairSetup] Could not verify Ed25519 Device Info, Signature and Public Key\r\n");
             free(deviceInfo);
-            for (auto msg : decryptedMessage) {
-                delete msg;
-            }
             client->sendTLVError(6, TLVErrorAuthentication);
             client->setPairing(false);
             break;
         }
         free(deviceInfo);
 
-        int result = HKStorage::addPairing((char *) deviceId->getValue(), publicKey->getValue(), 1);
+        // The accessory only counts as paired once the pairing is persisted
+        int result = HKStorage::addPairing(deviceIdentifier, publicKey, 1);
         if (result) {
-            HKLOGERROR("[HKClient::onPairSetup] COULD NOT STORE PAIRING\r\n");
+            HKLOGERROR("[HKClient::onPairSetup] Could not store pairing\r\n");
+            client->sendTLVError(6, TLVErrorUnknown);
+            client->setPairing(false);
+            break;
         }
 
         // M6 Response Generation
-        String accessoryId = HKStorage::getAccessoryId();
-        size_t accessoryInfoSize = 32 + accessoryId.length() + 32;
-        uint8_t *accessoryInfo = (uint8_t *) malloc(accessoryInfoSize);
+        const char *accessoryId = HKIdentity::getAccessoryId();
+        size_t accessoryIdLength = HKIdentity::getAccessoryIdLength();
+        size_t accessoryInfoSize = 32 + accessoryIdLength + 32;
+        uint8_t accessoryInfo[32 + ACCESSORY_ID_SIZE + 1 + 32];
         const char salt3[] = "Pair-Setup-Accessory-Sign-Salt";
-        const char info3[] = "Pair-Setup-Accessory-Sign-Info\001";
+        const char info3[] = "Pair-Setup-Accessory-Sign-Info";
         hkdf(accessoryInfo, srp->getK(), 64, (uint8_t *) salt3, sizeof(salt3)-1, (uint8_t *) info3, sizeof(info3)-1);
         delete srp;
 
-        memcpy(accessoryInfo + 32, accessoryId.c_str(), accessoryId.length());
-        memcpy(accessoryInfo + 32 + accessoryId.length(), HKStorage::getAccessoryKey().publicKey, 32);
+        memcpy(accessoryInfo + 32, accessoryId, accessoryIdLength);
+        memcpy(accessoryInfo + 32 + accessoryIdLength, HKIdentity::getPublicKey(), 32);
 
         uint8_t accessorySignature[64];
-        Ed25519::sign(accessorySignature, HKStorage::getAccessoryKey().privateKey, HKStorage::getAccessoryKey().publicKey, accessoryInfo, accessoryInfoSize);
-        free(accessoryInfo);
-
-        std::vector<HKTLV *> responseMessage = {
-                new HKTLV(TLVTypeIdentifier, (uint8_t *) accessoryId.c_str(), accessoryId.length()),
-                new HKTLV(TLVTypePublicKey, HKStorage::getAccessoryKey().publicKey, 32),
-                new HKTLV(TLVTypeSignature, accessorySignature, 64)
-        };
-        size_t responseDataSize = HKTLV::getFormattedTLVSize(responseMessage);
-        uint8_t *responseData = (uint8_t *) malloc(responseDataSize);
-        HKTLV::formatTLV(responseMessage, responseData);
-
-        uint8_t *encryptedResponseData = (uint8_t *) malloc(responseDataSize + 16);
-        crypto_encryptAndSeal(sharedSecret, (uint8_t *) "PS-Msg06", responseData, responseDataSize, encryptedResponseData, encryptedResponseData + responseDataSize);
-        free(responseData);
-
-        for (auto msg : decryptedMessage) {
-            delete msg;
-        }
-        for (auto it = tlvs.begin(); it != tlvs.end();) {
-            delete *it;
-            it = tlvs.erase(it);
-        }
-        tlvs.push_back(new HKTLV(TLVTypeState, 6, 1));
-        tlvs.push_back(new HKTLV(TLVTypeEncryptedData, encryptedResponseData, responseDataSize + 16));
-        free(encryptedResponseData);
+        HKIdentity::sign(accessorySignature, accessoryInfo, accessoryInfoSize);
+
+        HKTLVWriter responseMessage(2 + accessoryIdLength + 34 + 66, 0);
+        responseMessage.add(TLVTypeIdentifier, (const uint8_t *) accessoryId, accessoryIdLength);
+        responseMessage.add(TLVTypePublicKey, HKIdentity::getPublicKey(), 32);
+        responseMessage.add(TLVTypeSignature, accessorySignature, 64);
+        size_t responseDataSize = responseMessage.getSize();
+
+        // Sealed directly into the response, the sub TLV is below 255 bytes and needs no fragmentation
+        HKTLVWriter response(3 + 2 + responseDataSize + 16);
+        response.add(TLVTypeState, 6);
+        uint8_t *encryptedResponseData = response.reserve(TLVTypeEncryptedData, responseDataSize + 16);
+        if (encryptedResponseData) {
+            crypto_encryptAndSeal(sharedSecret, (uint8_t *) "PS-Msg06", (uint8_t *) responseMessage.getData(), responseDataSize, encryptedResponseData, encryptedResponseData + responseDataSize);
+        }
 
-        client->sendTLVResponse(tlvs);
+        client->sendTLVResponse(response);
         client->setPairing(false);
 
-        setupMDNS();
+        mdns.setPaired(true);
         HKLOGINFO("[HKClient::onPairSetup] Pairing Successfull\r\n");
         break;
     }
@@ -533,11 +588,6 @@ void ESPHomeKit::onPairSetup(HKClient *client, uint8_t *message, const size_t &m
     default:
         break;
     }
-
-    for (auto it = tlvs.begin(); it != tlvs.end();) {
-        delete *it;
-        it = tlvs.erase(it);
-    }
 }
 
 /**
@@ -548,19 +598,13 @@ void ESPHomeKit::onPairSetup(HKClient *client, uint8_t *message, const size_t &m
  * @param MessageSize Size of message
  */
 void ESPHomeKit::onPairVerify(HKClient *client, uint8_t *message, const size_t &messageSize) {
-    std::vector<HKTLV *> tlvs = HKTLV::parseTLV(message, messageSize);
-
-    int8_t value = -1;
-    HKTLV *state = HKTLV::findTLV(tlvs, TLVTypeState);
-    if (state) {
-        value = state->getIntValue();
-    }
+    HKTLVReader tlvs(message, messageSize);
 
-    switch (value) {
+    switch (tlvs.getIntValue(TLVTypeState)) {
     case 1: {
         HKLOGINFO("[HKClient::onPairVerify] Verify Step 1/2\r\n");
-        HKTLV *deviceKeyTLV = HKTLV::findTLV(tlvs, TLVTypePublicKey);
-        if (!deviceKeyTLV) {
+        const uint8_t *deviceKey = tlvs.getValue(TLVTypePublicKey);
+        if (!deviceKey || tlvs.getSize(TLVTypePublicKey) != 32) {
             HKLOGERROR("[HKClient::onPairVerify] Device Key not Found\r\n");
             client->sendTLVError(2, TLVErrorUnknown);
             break;
@@ -569,13 +613,12 @@ void ESPHomeKit::onPairVerify(HKClient *client, uint8_t *message, const size_t &
         size_t encryptedResponseSize = client->prepareEncryption(nullptr, nullptr, nullptr);
         uint8_t accessoryPublicKey[32];
         uint8_t *encryptedResponseData = (uint8_t *) malloc(encryptedResponseSize);
-        client->prepareEncryption(accessoryPublicKey, encryptedResponseData, deviceKeyTLV->getValue());
+        client->prepareEncryption(accessoryPublicKey, encryptedResponseData, deviceKey);
 
-        std::vector<HKTLV *> responseMessage = {
-                new HKTLV(TLVTypeState, 2, 1),
-                new HKTLV(TLVTypePublicKey, accessoryPublicKey, 32),
-                new HKTLV(TLVTypeEncryptedData, encryptedResponseData, encryptedResponseSize)
-        };
+        HKTLVWriter responseMessage(3 + 34 + 2 + encryptedResponseSize);
+        responseMessage.add(TLVTypeState, 2);
+        responseMessage.add(TLVTypePublicKey, accessoryPublicKey, 32);
+        responseMessage.add(TLVTypeEncryptedData, encryptedResponseData, encryptedResponseSize);
         free(encryptedResponseData);
 
         client->sendTLVResponse(responseMessage);
@@ -589,23 +632,22 @@ void ESPHomeKit::onPairVerify(HKClient *client, uint8_t *message, const size_t &
             break;
         }
 
-        HKTLV *encryptedData = HKTLV::findTLV(tlvs, TLVTypeEncryptedData);
-        if (!encryptedData) {
+        const uint8_t *encryptedData = tlvs.getValue(TLVTypeEncryptedData);
+        if (!encryptedData || tlvs.getSize(TLVTypeEncryptedData) < 16) {
             HKLOGERROR("[HKClient::onPairVerify] Could not find encrypted data\r\n");
             client->sendTLVError(4, TLVErrorUnknown);
             client->resetEncryption();
             break;
         }
 
-        if (!client->finishEncryption(encryptedData->getValue(), encryptedData->getSize())) {
+        if (!client->finishEncryption(encryptedData, tlvs.getSize(TLVTypeEncryptedData))) {
             HKLOGERROR("[HKClient::onPairVerify] Could not finish encryption\r\n");
             client->sendTLVError(4, TLVErrorAuthentication);
             break;
         }
 
-        std::vector<HKTLV *> responseMessage = {
-                new HKTLV(TLVTypeState, 4, 1)
-        };
+        HKTLVWriter responseMessage(3);
+        responseMessage.add(TLVTypeState, 4);
         client->sendTLVResponse(responseMessage);
 
         client->resetEncryption();
@@ -615,39 +657,25 @@ void ESPHomeKit::onPairVerify(HKClient *client, uint8_t *message, const size_t &
     default:
         break;
     }
-
-    for (auto msg : tlvs) {
-        delete msg;
-    }
 }
 
 void ESPHomeKit::onPairings(HKClient *client, uint8_t *message, const size_t &messageSize) {
     HKLOGINFO("[HKClient::onPairings] Pairings\r\n");
 
-    std::vector<HKTLV *> tlvs = HKTLV::parseTLV(message, messageSize);
-    HKTLV *state = HKTLV::findTLV(tlvs, TLVTypeState);
-    if (!state || state->getIntValue() != 1) {
+    HKTLVReader tlvs(message, messageSize);
+    if (tlvs.getIntValue(TLVTypeState) != 1) {
         client->sendTLVError(2, TLVErrorUnknown);
-
-        for (auto msg : tlvs) {
-            delete msg;
-        }
         HKLOGERROR("[HKClient::onPairings] Unknown State\r\n");
         return;
     }
 
-    HKTLV *method = HKTLV::findTLV(tlvs, TLVTypeMethod);
-    if (!method) {
+    if (!tlvs.contains(TLVTypeMethod)) {
         client->sendTLVError(2, TLVErrorUnknown);
-
-        for (auto msg : tlvs) {
-            delete msg;
-        }
         HKLOGERROR("[HKClient::onPairings] Unknown Message\r\n");
         return;
     }
 
-    switch ((TLVMethod) method->getIntValue()) {
+    switch ((TLVMethod) tlvs.getIntValue(TLVTypeMethod)) {
     case TLVMethodPairSetup:
         onPairSetup(client, message, messageSize);
         break;
@@ -662,75 +690,66 @@ void ESPHomeKit::onPairings(HKClient *client, uint8_t *message, const size_t &me
             break;
         }
 
-        HKTLV *deviceId = HKTLV::findTLV(tlvs, TLVTypeIdentifier);
+        const uint8_t *deviceId = tlvs.getValue(TLVTypeIdentifier);
         if (!deviceId) {
             HKLOGWARNING("[HKClient::onPairings] Invalid add pairing request: no device identifier\r\n");
             client->sendTLVError(2, TLVErrorUnknown);
             break;
         }
 
-        HKTLV *devicePublicKey = HKTLV::findTLV(tlvs, TLVTypePublicKey);
+        const uint8_t *devicePublicKey = tlvs.getValue(TLVTypePublicKey);
         if (!devicePublicKey) {
             HKLOGWARNING("[HKClient::onPairings] Invalid add pairing request: no device public key\r\n");
             client->sendTLVError(2, TLVErrorUnknown);
             break;
         }
 
-        HKTLV *devicePermission = HKTLV::findTLV(tlvs, TLVTypePermissions);
-        if (!devicePermission) {
+        if (!tlvs.contains(TLVTypePermissions)) {
             HKLOGWARNING("[HKClient::onPairings] Invalid add pairing request: no device Permissions\r\n");
             client->sendTLVError(2, TLVErrorUnknown);
             break;
         }
 
-        char *deviceIdentifier = (char *) malloc(deviceId->getSize());
-        strncpy(deviceIdentifier, (char *) deviceId->getValue(), deviceId->getSize());
-        Pairing *comparePairing = HKStorage::findPairing(deviceIdentifier);
+        char deviceIdentifier[sizeof(Pairing::deviceId) + 1];
+        if (!copyDeviceIdentifier(deviceIdentifier, deviceId, tlvs.getSize(TLVTypeIdentifier))) {
+            HKLOGWARNING("[HKClient::onPairings] Invalid add pairing request: device identifier is longer than %u bytes\r\n", sizeof(Pairing::deviceId));
+            client->sendTLVError(2, TLVErrorUnknown);
+            break;
+        }
+        byte devicePermission = tlvs.getIntValue(TLVTypePermissions);
+        const Pairing *comparePairing = HKStorage::findPairing(deviceIdentifier);
         if (comparePairing) {
-            if (devicePublicKey->getSize() != 32 || memcmp(devicePublicKey->getValue(), comparePairing->deviceKey, 32) != 0) {
+            if (tlvs.getSize(TLVTypePublicKey) != 32 || memcmp(devicePublicKey, comparePairing->deviceKey, 32) != 0) {
                 HKLOGWARNING("[HKClient::onPairings] Failed to add pairing: pairing public key differs from given one\r\n");
-                free(deviceIdentifier);
-                delete comparePairing;
                 client->sendTLVError(2, TLVErrorUnknown);
                 break;
             }
-            delete comparePairing;
 
-            if (HKStorage::updatePairing(deviceIdentifier, *devicePermission->getValue())) {
+            if (HKStorage::updatePairing(deviceIdentifier, devicePermission)) {
                 HKLOGWARNING("[HKClient::onPairings] Failed to add pairing: storage error\r\n");
-                free(deviceIdentifier);
                 client->sendTLVError(2, TLVErrorUnknown);
                 break;
             }
 
             HKLOGINFO("[HKClient::onPairings] Updated pairing with id=%s\r\n", deviceIdentifier);
         } else {
-            int r = HKStorage::addPairing(deviceIdentifier, devicePublicKey->getValue(), *devicePermission->getValue());
+            int r = HKStorage::addPairing(deviceIdentifier, devicePublicKey, devicePermission);
             if (r == -2) {
                 HKLOGWARNING("[HKClient::onPairings] Failed to add pairing: max peers\r\n");
-                free(deviceIdentifier);
                 client->sendTLVError(2, TLVErrorMaxPeers);
                 break;
             } else if (r != 0) {
                 HKLOGWARNING("[HKClient::onPairings] Failed to add pairing: Storage error\r\n");
-                free(deviceIdentifier);
                 client->sendTLVError(2, TLVErrorUnknown);
                 break;
             }
 
-            delete comparePairing;
-
             HKLOGINFO("[HKClient::onPairings] Added pairing with id=%s\r\n", deviceIdentifier);
         }
-        free(deviceIdentifier);
 
-        std::vector<HKTLV *> response = {
-            new HKTLV(TLVTypeState, 2, 1),
-        };
+        HKTLVWriter response(3);
+        response.add(TLVTypeState, 2);
         client->sendTLVResponse(response);
-        for (auto responseItem : response) {
-            delete responseItem;
-        }
         break;
     }
     case TLVMethodRemovePairing: {
@@ -742,30 +761,32 @@ void ESPHomeKit::onPairings(HKClient *client, uint8_t *message, const size_t &me
             break;
         }
 
-        HKTLV *deviceId = HKTLV::findTLV(tlvs, TLVTypeIdentifier);
+        const uint8_t *deviceId = tlvs.getValue(TLVTypeIdentifier);
         if (!deviceId) {
             HKLOGWARNING("[HKClient::onPairings] Invalid remove pairing request: no device identifier\r\n");
             client->sendTLVError(2, TLVErrorUnknown);
             break;
         }
 
-        char *deviceIdentifier = (char *) malloc(deviceId->getSize());
-        strncpy(deviceIdentifier, (char *) deviceId->getValue(), deviceId->getSize());
-        Pairing *comparePairing = HKStorage::findPairing(deviceIdentifier);
+        char deviceIdentifier[sizeof(Pairing::deviceId) + 1];
+        if (!copyDeviceIdentifier(deviceIdentifier, deviceId, tlvs.getSize(TLVTypeIdentifier))) {
+            HKLOGWARNING("[HKClient::onPairings] Invalid remove pairing request: device identifier is longer than %u bytes\r\n", sizeof(Pairing::deviceId));
+            client->sendTLVError(2, TLVErrorUnknown);
+            break;
+        }
+        const Pairing *comparePairing = HKStorage::findPairing(deviceIdentifier);
         if (comparePairing) {
             bool isAdmin = comparePairing->permissions & PairingPermissionAdmin;
+            int pairingId = comparePairing->id;
 
             int result = HKStorage::removePairing(deviceIdentifier);
             if (result) {
-                free(deviceIdentifier);
-                delete comparePairing;
                 HKLOGERROR("[HKClient::onPairings] Failed to remove pairing: storage error\r\n");
                 client->sendTLVError(2, TLVErrorUnknown);
                 break;
             }
 
             HKLOGINFO("[HKClient::onPairings] Removed pairing with id=%s\r\n", deviceIdentifier);
-            free(deviceIdentifier);
 
             #if HKLOGLEVEL <= 1
             for (auto pPairing : HKStorage::getPairings()) {
@@ -774,7 +795,7 @@ void ESPHomeKit::onPairings(HKClient *client, uint8_t *message, const size_t &me
             #endif
 
             for (auto client : clients) {
-                if (client->getPairingId() == comparePairing->id) {
+                if (client->getPairingId() == pairingId) {
                     client->stop();
                 }
             }
@@ -787,13 +808,9 @@ void ESPHomeKit::onPairings(HKClient *client, uint8_t *message, const size_t &me
             }
         }
 
-        std::vector<HKTLV *> response = {
-                new HKTLV(TLVTypeState, 2, 1)
-        };
+        HKTLVWriter response(3);
+        response.add(TLVTypeState, 2);
         client->sendTLVResponse(response);
-        for (auto responseItem : response) {
-            delete responseItem;
-        }
         break;
     }
     case TLVMethodListPairings: {
@@ -803,35 +820,24 @@ void ESPHomeKit::onPairings(HKClient *client, uint8_t *message, const size_t &me
             break;
         }
 
-        std::vector<HKTLV *> response = {
-                new HKTLV(TLVTypeState, 2, 1),
-        };
+        std::vector<const Pairing *> pairings = HKStorage::getPairings();
+        HKTLVWriter response(3 + pairings.size() * (2 + 38 + 34 + 3));
+        response.add(TLVTypeState, 2);
 
         bool first = true;
-        std::vector<Pairing *> pairings = HKStorage::getPairings();
         for (auto pairingItem : pairings) {
             if (!first) {
-                response.push_back(new HKTLV(TLVTypeSeparator, nullptr, 0));
+                response.add(TLVTypeSeparator, nullptr, 0);
             }
             first = false;
 
-            response.push_back(new HKTLV(TLVTypeIdentifier, (byte *) pairingItem->deviceId, 36));
-            response.push_back(new HKTLV(TLVTypePublicKey, pairingItem->deviceKey, 32));
-            response.push_back(new HKTLV(TLVTypePermissions, pairingItem->permissions, 1));
+            response.add(TLVTypeIdentifier, (const uint8_t *) pairingItem->deviceId, 36);
+            response.add(TLVTypePublicKey, pairingItem->deviceKey, 32);
+            response.add(TLVTypePermissions, pairingItem->permissions);
         }
 
         client->sendTLVResponse(response);
-        for (auto pairingItem : pairings) {
-            delete pairingItem;
-        }
-        for (auto responseItem : response) {
-            delete responseItem;
-        }
         break;
     }
     }
-
-    for (auto msg : tlvs) {
-        delete msg;
-    }
 }
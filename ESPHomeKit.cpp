@@ -16,8 +16,9 @@
  * @brief Construct a new ESPHomeKit::ESPHomeKit object
  * 
  */
-ESPHomeKit::ESPHomeKit() : server(WiFiServer(PORT)), accessory(nullptr), configNumber(1) {
+ESPHomeKit::ESPHomeKit() : server(WiFiServer(PORT)), accessory(nullptr) {
     HKStorage::checkStorage();
+    HKStorage::loadPairings();
 }
 
 /**
@@ -33,8 +34,9 @@ ESPHomeKit::~ESPHomeKit() {
  */
 void ESPHomeKit::setup(HKAccessory *accessory) {
     this->accessory = accessory;
+    loadIdentity();
 
-    HKLOGINFO("[ESPHomeKit::setup] AccessoryID: %s\r\n", HKStorage::getAccessoryId().c_str());
+    HKLOGINFO("[ESPHomeKit::setup] AccessoryID: %s\r\n", HKIdentity::getAccessoryId());
 
     #if HKLOGLEVEL <= 1
     for (auto pairing : HKStorage::getPairings()) {
@@ -45,6 +47,8 @@ void ESPHomeKit::setup(HKAccessory *accessory) {
     HKLOGINFO("[ESPHomeKit::setup] Password: %s\r\n", HKPASSWORD);
 
     this->accessory->prepareIDs();
+    mdns.setConfigNumber(HKStorage::updateConfigNumber(this->accessory->getLayoutHash()));
+    HKLOGINFO("[ESPHomeKit::setup] Configuration number: %u\r\n", mdns.getConfigNumber());
 }
 
 /**
@@ -54,8 +58,9 @@ void ESPHomeKit::setup(HKAccessory *accessory) {
 void ESPHomeKit::begin() {
     if (!HKStorage::isPaired()) {
         srp = new Srp(String(HKPASSWORD).c_str());
+        HKLOGDEBUG("[ESPHomeKit::begin] SRP MPI pool peak: %u of %u bytes, %u on heap\r\n", mbedtls_mpi_pool_peak(), SRP_MPI_POOL_SIZE, mbedtls_mpi_pool_overflows());
     }
-    setupMDNS();
+    mdns.begin(PORT, mdns.getConfigNumber(), HKStorage::isPaired());
     server.begin();
 }
 
@@ -64,7 +69,8 @@ void ESPHomeKit::begin() {
  * 
  */
 void ESPHomeKit::update() {
-    MDNS.update();
+    mdns.update();
+    accessory->pollValues();
     handleClient();
     accessory->run();
 }
@@ -85,32 +91,41 @@ bool ESPHomeKit::isPairing() {
 }
 
 /**
- * @brief Get name from info service
+ * @brief Get unique name used for mDNS
  * 
  * @return String name
  */
 String ESPHomeKit::getName() {
+    return HKIdentity::getName();
+}
+
+/**
+ * @brief Load the accessory identity and describe it with the accessory information service
+ * 
+ * The name, model and category do not change while running, so the name and constant TXT records are
+ * derived once here instead of on every mDNS update.
+ */
+void ESPHomeKit::loadIdentity() {
+    HKIdentity::load();
     if (!accessory) {
         HKLOGERROR("No Accessory in HomeKit");
-        return "";
+        return;
     }
 
     HKService *info = accessory->getService(HKServiceAccessoryInfo);
     if (!info) {
         HKLOGERROR("No Accessory Information Service in Accessory");
+        return;
     }
 
     HKCharacteristic *serviceName = info->getCharacteristic(HKCharacteristicName);
-    if (!serviceName) {
-        HKLOGERROR("No Accessory Name in Accessory Information Service");
+    HKCharacteristic *model = info->getCharacteristic(HKCharacteristicModelName);
+    if (!serviceName || !model) {
+        HKLOGERROR("No Accessory Name or Model in Accessory Information Service");
+        return;
     }
 
-    String name = serviceName->getValue().stringValue;
-    #ifndef HK_UNIQUE_NAME
-    String accessoryId = HKStorage::getAccessoryId();
-    name += "-" + accessoryId.substring(0, 2) + accessoryId.substring(3, 5);
-    #endif
-    return name;
+    HKIdentity::describe(serviceName->getValue().stringValue, model->getValue().stringValue, accessory->getCategory());
 }
 
 /**
@@ -123,11 +138,13 @@ HKAccessory *ESPHomeKit::getAccessory() {
 }
 
 /**
- * @brief Reset EEPROM
+ * @brief Reset storage
  * 
  */
 void ESPHomeKit::reset() {
     HKStorage::reset();
+    loadIdentity();
+    mdns.setPaired(false);
 }
 
 /**
@@ -136,106 +153,7 @@ void ESPHomeKit::reset() {
  */
 void ESPHomeKit::resetPairings() {
     HKStorage::resetPairings();
-}
-
-/**
- * @brief Prepare mDNS Service
- * 
- * @return true Successfully started Service
- * @return false Service failed
- */
-bool ESPHomeKit::setupMDNS() {
-    HKLOGINFO("[ESPHomeKit::setupMDNS] Setup mDNS\r\n");
-    String uniqueName = getName();
-    if (!mdnsService && !MDNS.begin(uniqueName)) {
-        HKLOGERROR("[ESPHomeKit::setupMDNS] Failed to begin mDNS\r\n");
-        return false;
-    }
-    
-    const char service[] = "hap";
-    const char protocol[] = "tcp";
-    MDNS.setInstanceName(uniqueName);
-    if (!mdnsService) {
-        mdnsService = MDNS.addService(nullptr, service, protocol, PORT);
-        if (!mdnsService) {
-            HKLOGERROR("[ESPHomeKit::setupMDNS] Failed to add service\r\n");
-            return false;
-        }
-    }
-
-    HKService *info = getAccessory()->getService(HKServiceAccessoryInfo);
-    if (info == nullptr) {
-        return false;
-    }
-    HKCharacteristic *model = info->getCharacteristic(HKCharacteristicModelName);
-    if (model == nullptr) {
-        return false;
-    }
-
-    if (!MDNS.addServiceTxt(service, protocol, "md", model->getValue().stringValue)) {
-        HKLOGERROR("[ESPHomeKit::setupMDNS] Failed to add md model\r\n");
-        return false;
-    }
-    if (!MDNS.addServiceTxt(service, protocol, "pv", "1.0")) {
-        HKLOGERROR("[ESPHomeKit::setupMDNS] Failed to add pv \"1.0\"\r\n");
-        return false;
-    }
-    if (!MDNS.addServiceTxt(service, protocol, "id", HKStorage::getAccessoryId())) {
-        HKLOGERROR("[ESPHomeKit::setupMDNS] Failed to add id accessoryId\r\n");
-        return false;
-    }
-    if (!MDNS.addServiceTxt(service, protocol, "c#", String(configNumber))) {
-        HKLOGERROR("[ESPHomeKit::setupMDNS] Failed to add c# configNumber\r\n");
-        return false;
-    }
-    if (!MDNS.addServiceTxt(service, protocol, "s#", "1")) {  // State number
-        HKLOGERROR("[ESPHomeKit::setupMDNS] Failed to add s#\r\n");
-        return false;
-    }
-    if (!MDNS.addServiceTxt(service, protocol, "ff", "0")) {  // feature flags
-        //   bit 0 - supports HAP pairing. required for all ESPHomeKit accessories
-        //   bits 1-7 - reserved
-        HKLOGERROR("[ESPHomeKit::setupMDNS] Failed to add ff\r\n");
-        return false;
-    }
-    if (!MDNS.addServiceTxt(service, protocol, "sf", String(HKStorage::isPaired() ? 0 : 1))) {  // status flags
-        //   bit 0 - not paired
-        //   bit 1 - not configured to join WiFi
-        //   bit 2 - problem detected on accessory
-        //   bits 3-7 - reserved
-        HKLOGERROR("[ESPHomeKit::setupMDNS] Failed to add sf paired\r\n");
-        return false;
-    }
-    if (!MDNS.addServiceTxt(service, protocol, "ci", String(accessory->getCategory()))) {
-        HKLOGERROR("[ESPHomeKit::setupMDNS] Failed to add ci category\r\n");
-        return false;
-    }
-
-    #ifdef HKSETUPID
-    String setupId = HKSETUPID;
-    if (setupId.length() == 4) {
-        size_t dataSize = setupId.length() + HKStorage::getAccessoryId().length() + 1;
-        char *data = (char *) malloc(dataSize);
-        snprintf(data, dataSize, "%s%s", setupId.c_str(), HKStorage::getAccessoryId().c_str());
-        data[dataSize-1] = 0;
-
-        unsigned char shaHash[64];
-        SHA512 sha512 = SHA512();
-        sha512.reset();
-        sha512.update(data, 21);
-        free(data);
-        sha512.finalize(shaHash, 64);
-
-        String encoded = base64::encode(shaHash, 4, false);
-
-        if (!MDNS.addServiceTxt(service, protocol, "sh", encoded)) {
-            HKLOGERROR("[ESPHomeKit::setupMDNS] Failed to add ci category\r\n");
-            return false;
-        }
-    }
-    #endif
-
-    return true;
+    mdns.setPaired(false);
 }
 
 /**
@@ -32,11 +32,14 @@
 
 #include "HKDebug.h"
 #include "HKStorage.h"
+#include "HKIdentity.h"
+#include "HKMDNS.h"
 #include "HKAccessory.h"
 #include "HKClient.h"
 
 class HKAccessory;
 class HKClient;
+class HKCharacteristic;
 
 const char PROGMEM http_header_200_chunked[] = "HTTP/1.1 200 OK\r\n"
                                         "Content-Type: application/hap+json\r\n"
@@ -64,7 +67,7 @@ public:
 
     friend class HKClient;
 private:
-    bool setupMDNS();
+    void loadIdentity();
     void handleClient();
     void parseMessage(HKClient *client, uint8_t *message, const size_t &messageSize);
     
@@ -72,7 +75,7 @@ private:
     void onGetCharacteristics(HKClient *client, String id, bool meta, bool perms, bool type, bool ev);
     void onIdentify(HKClient *client);
     void onUpdateCharacteristics(HKClient *client, uint8_t *message, const size_t &messageSize);
-    HAPStatus processUpdateCharacteristic(HKClient *client, uint aid, uint iid, String ev, String value);
+    HAPStatus processUpdateCharacteristic(HKClient *client, uint aid, uint iid, const String &ev, const char *value, size_t valueLength, std::vector<HKCharacteristic *> &changed);
 
     void onPairSetup(HKClient *client, uint8_t *message, const size_t &messageSize);
     void onPairVerify(HKClient *client, uint8_t *message, const size_t &messageSize);
@@ -80,13 +83,11 @@ private:
 private:
     // Server
     WiFiServer server;
-    esp8266::MDNSImplementation::MDNSResponder::hMDNSService mdnsService;
+    HKMDNS mdns;
     std::vector<HKClient *> clients;
 
     HKAccessory *accessory;
     Srp *srp;
-
-    int configNumber;
 };
 
 
@@ -4,12 +4,31 @@
 
 #include "HKAccessory.h"
 
+static void hashLayout(uint32_t &hash, const void *data, size_t size) {
+    // FNV-1a
+    const uint8_t *bytes = (const uint8_t *) data;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+}
+
+static void hashLayout(uint32_t &hash, uint32_t value) {
+    hashLayout(hash, &value, sizeof(value));
+}
+
+static void hashLayout(uint32_t &hash, const float *value) {
+    hashLayout(hash, value != nullptr);
+    if (value) {
+        hashLayout(hash, value, sizeof(float));
+    }
+}
+
 /**
  * @brief Construct a new HKAccessory::HKAccessory object
  * 
  * @param category Look up your Category in HKDefinitions.h or Apples HAP Documentation
  */
-HKAccessory::HKAccessory(HKAccessoryCategory category) : id(1), category(category) {
+HKAccessory::HKAccessory(HKAccessoryCategory category) : id(1), category(category), layoutHash(0) {
 }
 
 /**
@@ -20,7 +39,7 @@ HKAccessory::HKAccessory(HKAccessoryCategory category) : id(1), category(categor
  * @param firmwareRevision Sets firmware revision of the Accessory Info SErvice
  * @param category Look up your Category in HKDefinitions.h or Apples HAP Documentation
  */
-HKAccessory::HKAccessory(const String &accessoryName, const String &modelName, const String &firmwareRevision, HKAccessoryCategory category) : id(1), category(category) {
+HKAccessory::HKAccessory(const String &accessoryName, const String &modelName, const String &firmwareRevision, HKAccessoryCategory category) : id(1), category(category), layoutHash(0) {
     addInfoService(accessoryName, "MaxMac Co.", modelName, String(ESP.getChipId()), firmwareRevision);
 }
 
@@ -38,28 +57,28 @@ void HKAccessory::addInfoService(const String& accName, const String& manufactur
     addService(infoService);
 
     HKValue identifyValue = HKValue(HKFormatBool);
-    HKCharacteristic *identifyChar = new HKCharacteristic(HKCharacteristicIdentify, identifyValue, HKPermissionPairedWrite, "Identify", HKFormatBool);
+    HKCharacteristic *identifyChar = new HKCharacteristic(HKCharacteristicIdentify, identifyValue);
     identifyChar->setSetter(std::bind(&HKAccessory::identify, this));
     infoService->addCharacteristic(identifyChar);
 
     HKValue manufacturerValue = HKValue(HKFormatString, "MaxMac Co.");
-    HKCharacteristic *manufacturerChar = new HKCharacteristic(HKCharacteristicManufactuer, manufacturerValue, HKPermissionPairedRead, "Manufacturer", HKFormatString);
+    HKCharacteristic *manufacturerChar = new HKCharacteristic(HKCharacteristicManufactuer, manufacturerValue);
     infoService->addCharacteristic(manufacturerChar);
 
     HKValue modelValue = HKValue(HKFormatString, modelName);
-    HKCharacteristic *modelChar = new HKCharacteristic(HKCharacteristicModelName, modelValue, HKPermissionPairedRead, "Model", HKFormatString);
+    HKCharacteristic *modelChar = new HKCharacteristic(HKCharacteristicModelName, modelValue);
     infoService->addCharacteristic(modelChar);
 
     HKValue nameValue = HKValue(HKFormatString, accName);
-    HKCharacteristic *nameChar = new HKCharacteristic(HKCharacteristicName, nameValue, HKPermissionPairedRead, "Name", HKFormatString);
+    HKCharacteristic *nameChar = new HKCharacteristic(HKCharacteristicName, nameValue);
     infoService->addCharacteristic(nameChar);
 
     HKValue serialValue = HKValue(HKFormatString, String(ESP.getChipId()));
-    HKCharacteristic *serialChar = new HKCharacteristic(HKCharacteristicSerialNumber, serialValue, HKPermissionPairedRead, "Serial Number", HKFormatString);
+    HKCharacteristic *serialChar = new HKCharacteristic(HKCharacteristicSerialNumber, serialValue);
     infoService->addCharacteristic(serialChar);
 
     HKValue firmwareValue = HKValue(HKFormatString, firmwareRevision);
-    HKCharacteristic *firmwareChar = new HKCharacteristic(HKCharacteristicFirmwareRevision, firmwareValue, HKPermissionPairedRead, "Firmware Revision", HKFormatString);
+    HKCharacteristic *firmwareChar = new HKCharacteristic(HKCharacteristicFirmwareRevision, firmwareValue);
     infoService->addCharacteristic(firmwareChar);
 }
 
@@ -126,10 +145,10 @@ HKAccessoryCategory HKAccessory::getCategory() const {
 void HKAccessory::serializeToJSON(JSON &json, HKValue *value, HKClient *client) {
     json.startObject();
 
-    json.setString("aid");
+    json.setKey("aid");
     json.setInt(id);
 
-    json.setString("services");
+    json.setKey("services");
     json.startArray();
 
     for (auto service : services) {
@@ -172,9 +191,23 @@ void HKAccessory::clearCallbackEvents(HKClient *client) {
 }
 
 /**
- * @brief Initialize IDs during setup
+ * @brief Poll cached characteristic values, see HKCharacteristic::setCacheTime()
  * 
  */
+void HKAccessory::pollValues() {
+    for (auto service : services) {
+        for (auto characteristic : service->characteristics) {
+            characteristic->pollValue();
+        }
+    }
+}
+
+/**
+ * @brief Initialize IDs during setup and hash the resulting layout
+ * 
+ * The hash covers everything a controller caches from /accessories except values: ids, types, formats,
+ * permissions and metadata. It is stable across firmware builds as long as the layout does not change.
+ */
 void HKAccessory::prepareIDs() {
     setup();
 
@@ -185,4 +218,85 @@ void HKAccessory::prepareIDs() {
             characteristic->id = iid++;
         }
     }
+
+    layoutHash = 2166136261u;
+    hashLayout(layoutHash, id);
+    for (auto service : services) {
+        hashLayout(layoutHash, service->id);
+        hashLayout(layoutHash, service->serviceType);
+        hashLayout(layoutHash, service->hidden | service->primary << 1);
+        for (auto linkedService : service->linkedServices) {
+            hashLayout(layoutHash, linkedService->id);
+        }
+        for (auto characteristic : service->characteristics) {
+            hashLayout(layoutHash, characteristic->id);
+            hashLayout(layoutHash, characteristic->type);
+            const HKCharacteristicMetadata &metadata = characteristic->getMetadata();
+            hashLayout(layoutHash, metadata.format);
+            hashLayout(layoutHash, characteristic->permissions);
+            hashLayout(layoutHash, metadata.unit);
+            hashLayout(layoutHash, metadata.has(HKMetadataMinValue) ? &metadata.minValue : nullptr);
+            hashLayout(layoutHash, metadata.has(HKMetadataMaxValue) ? &metadata.maxValue : nullptr);
+            hashLayout(layoutHash, metadata.has(HKMetadataMinStep) ? &metadata.minStep : nullptr);
+            hashLayout(layoutHash, metadata.has(HKMetadataMaxLen) ? metadata.maxLen : 0);
+            hashLayout(layoutHash, metadata.has(HKMetadataMaxDataLen) ? metadata.maxDataLen : 0);
+            hashLayout(layoutHash, metadata.validValues.count > 0 ? metadata.validValues.values : nullptr, metadata.validValues.count > 0 ? metadata.validValues.count : 0);
+            hashLayout(layoutHash, metadata.validValuesRanges.count > 0 ? metadata.validValuesRanges.ranges : nullptr, metadata.validValuesRanges.count > 0 ? metadata.validValuesRanges.count * sizeof(HKValidValuesRange) : 0);
+        }
+    }
+}
+
+/**
+ * @brief Set function to read several characteristics at once, e.g. all values of a sensor in one bus transaction
+ * It is called with all readable characteristics of a GET request before they are serialized.
+ * Values it leaves null are read with the getter of the characteristic.
+ * 
+ * @param batchGetter Function
+ */
+void HKAccessory::setBatchGetter(const std::function<void(std::vector<HKReadRequest> &)> &batchGetter) {
+    HKAccessory::batchGetter = batchGetter;
+}
+
+/**
+ * @brief Let the batch getter fill the values of requested characteristics
+ * 
+ * @param requests Requested characteristics
+ */
+void HKAccessory::readValues(std::vector<HKReadRequest> &requests) {
+    if (batchGetter && !requests.empty()) {
+        batchGetter(requests);
+    }
+}
+
+/**
+ * @brief Call the commit callback of every service with its characteristics that were written in one request
+ * 
+ * @param changed Characteristics that were written
+ */
+void HKAccessory::commitValues(const std::vector<HKCharacteristic *> &changed) {
+    std::vector<HKCharacteristic *> serviceChanged;
+    for (auto service : services) {
+        if (!service->commitCallback) {
+            continue;
+        }
+
+        serviceChanged.clear();
+        for (auto characteristic : changed) {
+            if (characteristic->service == service) {
+                serviceChanged.push_back(characteristic);
+            }
+        }
+        if (!serviceChanged.empty()) {
+            service->commitCallback(serviceChanged);
+        }
+    }
+}
+
+/**
+ * @brief Hash over the accessory layout, computed by prepareIDs()
+ * 
+ * @return uint32_t Layout hash
+ */
+uint32_t HKAccessory::getLayoutHash() const {
+    return layoutHash;
 }
@@ -27,6 +27,15 @@ class HKCharacteristic;
 class HKClient;
 class ESPHomeKit;
 
+/**
+ * @brief Characteristic requested by a controller, the batch getter may fill its value
+ * 
+ */
+struct HKReadRequest {
+    HKCharacteristic *characteristic;
+    HKValue value;      // left null to fall back to the getter of the characteristic
+};
+
 /**
  * @brief Override HKAccessory
  * 
@@ -49,10 +58,15 @@ public:
     std::vector<HKService *> getServices();
     HKAccessoryCategory getCategory() const;
     uint getId() const;
+    uint32_t getLayoutHash() const;
+    void setBatchGetter(const std::function<void(std::vector<HKReadRequest> &)> &batchGetter);
 private:
     HKCharacteristic *findCharacteristic(uint iid);
     void prepareIDs();
     void clearCallbackEvents(HKClient *client);
+    void pollValues();
+    void readValues(std::vector<HKReadRequest> &requests);
+    void commitValues(const std::vector<HKCharacteristic *> &changed);
     void serializeToJSON(JSON &json, HKValue *value, HKClient *client = nullptr);
     
     friend HKClient;
@@ -60,7 +74,9 @@ private:
 private:
     uint id;
     HKAccessoryCategory category;
+    uint32_t layoutHash;
     std::vector<HKService *> services;
+    std::function<void(std::vector<HKReadRequest> &)> batchGetter;
 };
 
 
@@ -10,6 +10,91 @@
  */
 
 #include "HKCharacteristic.h"
+#include "HKFragments.h"
+
+static int8_t base64Value(char c) {
+    if (c >= 'A' && c <= 'Z') {
+        return c - 'A';
+    } else if (c >= 'a' && c <= 'z') {
+        return c - 'a' + 26;
+    } else if (c >= '0' && c <= '9') {
+        return c - '0' + 52;
+    } else if (c == '+') {
+        return 62;
+    } else if (c == '/') {
+        return 63;
+    }
+    return -1;
+}
+
+/**
+ * @brief Length of base64 encoded data, the backslashes of JSON escaped slashes are skipped
+ * 
+ * @param input Base64 string
+ * @param length Length of input
+ * @return int Decoded length, -1 if input is not valid padded base64
+ */
+static int decodedBase64Length(const char *input, size_t length) {
+    size_t count = 0;
+    size_t padding = 0;
+    for (size_t i = 0; i < length; i++) {
+        if (input[i] == '\\') {
+            continue;
+        }
+        if (input[i] == '=') {
+            padding++;
+            continue;
+        }
+        if (padding || base64Value(input[i]) < 0) {
+            return -1;
+        }
+        count++;
+    }
+    if ((count + padding) % 4 != 0 || padding > 2) {
+        return -1;
+    }
+    return count * 3 / 4;
+}
+
+/**
+ * @brief Decode base64 in place into the target buffer, input has to be checked with decodedBase64Length() before
+ * 
+ * @param input Base64 string
+ * @param length Length of input
+ * @param output Target, decodedBase64Length() bytes
+ */
+static void decodeBase64(const char *input, size_t length, uint8_t *output) {
+    uint32_t bits = 0;
+    uint8_t bitCount = 0;
+    for (size_t i = 0; i < length; i++) {
+        int8_t value = base64Value(input[i]);
+        if (value < 0) {
+            continue;
+        }
+        bits = (bits << 6 | value) & 0xFFFFFF;
+        bitCount += 6;
+        if (bitCount >= 8) {
+            bitCount -= 8;
+            *output++ = bits >> bitCount;
+        }
+    }
+}
+
+/**
+ * @brief Check that data is a complete sequence of TLV8 items
+ * 
+ * @param data TLV8 data
+ * @param length Length of data
+ * @return true Every item fits into data
+ * @return false Data is truncated
+ */
+static bool isValidTLV8(const uint8_t *data, size_t length) {
+    size_t offset = 0;
+    while (offset + 2 <= length) {
+        offset += 2 + data[offset + 1];
+    }
+    return offset == length;
+}
 
 /**
  * @brief Construct a new HKCharacteristic::HKCharacteristic object
@@ -26,12 +111,68 @@
  * @param minStep Minimum step size (only for float and int)
  * @param maxLen Maximum length
  * @param maxDataLen Maximum data length
- * @param validValues Valid values
- * @param validValuesRanges Valid values as range
+ * @param validValues Valid values, the array has to outlive the characteristic
+ * @param validValuesRanges Valid values as range, the array has to outlive the characteristic
+ *
+ * The optional values are copied into a shared metadata record and deleted.
  */
 HKCharacteristic::HKCharacteristic(HKCharacteristicType type, const HKValue &value, uint8_t permissions,
-                                   String description, HKFormat format, HKUnit unit, float *minValue, float *maxValue, float *minStep, uint *maxLen, uint *maxDataLen, HKValidValues validValues, HKValidValuesRanges validValuesRanges) : id(0), service(nullptr), type(type), value(value), permissions(permissions), description(std::move(description)), unit(unit), format(format), minValue(minValue), maxValue(maxValue), minStep(minStep), maxLen(maxLen), maxDataLen(maxDataLen), validValues(validValues), validValuesRanges(validValuesRanges), getter(nullptr), setter(nullptr) {
+                                   String description, HKFormat format, HKUnit unit, float *minValue, float *maxValue, float *minStep, uint *maxLen, uint *maxDataLen, HKValidValues validValues, HKValidValuesRanges validValuesRanges) : id(0), service(nullptr), type(type), value(value), permissions(permissions), metadata(nullptr), getter(nullptr), setter(nullptr), cacheTime(0), cacheUpdated(0), cacheValid(false) {
+    HKCharacteristicMetadata characteristicMetadata = HKCharacteristicMetadata();
+    characteristicMetadata.format = format;
+    characteristicMetadata.unit = unit;
+    characteristicMetadata.description = description.c_str();
+    characteristicMetadata.validValues = validValues;
+    characteristicMetadata.validValuesRanges = validValuesRanges;
+    if (minValue) {
+        characteristicMetadata.flags |= HKMetadataMinValue;
+        characteristicMetadata.minValue = *minValue;
+    }
+    if (maxValue) {
+        characteristicMetadata.flags |= HKMetadataMaxValue;
+        characteristicMetadata.maxValue = *maxValue;
+    }
+    if (minStep) {
+        characteristicMetadata.flags |= HKMetadataMinStep;
+        characteristicMetadata.minStep = *minStep;
+    }
+    if (maxLen) {
+        characteristicMetadata.flags |= HKMetadataMaxLen;
+        characteristicMetadata.maxLen = *maxLen;
+    }
+    if (maxDataLen) {
+        characteristicMetadata.flags |= HKMetadataMaxDataLen;
+        characteristicMetadata.maxDataLen = *maxDataLen;
+    }
+    metadata = HKMetadata::acquire(characteristicMetadata);
+
+    delete minValue;
+    delete maxValue;
+    delete minStep;
+    delete maxLen;
+    delete maxDataLen;
+}
 
+/**
+ * @brief Construct a new HKCharacteristic::HKCharacteristic object with the default metadata of its type
+ * Format, unit, ranges and description are taken from the catalog in HKMetadata.cpp
+ * 
+ * @param type Type of characteristic
+ * @param value Initial Value
+ * @param permissions Permission needed to access values, 0 for the default permissions of the type
+ */
+HKCharacteristic::HKCharacteristic(HKCharacteristicType type, const HKValue &value, uint8_t permissions) : id(0), service(nullptr), type(type), value(value), permissions(permissions), metadata(nullptr), getter(nullptr), setter(nullptr), cacheTime(0), cacheUpdated(0), cacheValid(false) {
+    HKCharacteristicMetadata characteristicMetadata = HKCharacteristicMetadata();
+    uint8_t defaultPermissions = HKPermissionPairedRead;
+    if (!HKMetadata::lookup(type, characteristicMetadata, defaultPermissions)) {
+        HKLOGWARNING("[HKCharacteristic::HKCharacteristic] No default metadata for type %d, set it with setMetadata()\r\n", type);
+        characteristicMetadata.format = value.format;
+        characteristicMetadata.unit = HKUnitNone;
+    }
+    if (!permissions) {
+        HKCharacteristic::permissions = defaultPermissions;
+    }
+    metadata = HKMetadata::acquire(characteristicMetadata);
 }
 
 /**
@@ -39,11 +180,7 @@ HKCharacteristic::HKCharacteristic(HKCharacteristicType type, const HKValue &val
  * 
  */
 HKCharacteristic::~HKCharacteristic() {
-    delete minValue;
-    delete maxValue;
-    delete minStep;
-    delete maxLen;
-    delete maxDataLen;
+    HKMetadata::release(metadata);
 }
 
 /**
@@ -64,6 +201,18 @@ void HKCharacteristic::setSetter(const std::function<void(const HKValue)> &sette
     HKCharacteristic::setter = setter;
 }
 
+/**
+ * @brief Cache values returned by the getter instead of calling it on every read
+ * A cached value older than cacheTime is read again, registered clients are notified if it changed.
+ * While clients are registered for events, the value is also polled every cacheTime
+ * 
+ * @param cacheTime Time in milliseconds a value stays fresh, 0 disables the cache
+ */
+void HKCharacteristic::setCacheTime(unsigned long cacheTime) {
+    HKCharacteristic::cacheTime = cacheTime;
+    cacheValid = false;
+}
+
 /**
  * @brief Get assigned type of characteristic
  * 
@@ -78,10 +227,20 @@ HKCharacteristicType HKCharacteristic::getType() const {
  * 
  * @return const HKValue& Current value
  */
-const HKValue &HKCharacteristic::getValue() const {
-    if (getter) {
+const HKValue &HKCharacteristic::getValue() {
+    if (!getter) {
+        return value;
+    }
+    if (!cacheTime) {
         return getter();
     }
+
+    if (!cacheValid || millis() - cacheUpdated >= cacheTime) {
+        bool initial = !cacheValid;
+        if (refreshValue() && !initial) {
+            notify(value);
+        }
+    }
     return value;
 }
 
@@ -94,6 +253,27 @@ HKService *HKCharacteristic::getService() {
     return service;
 }
 
+/**
+ * @brief Get metadata, shared with other characteristics
+ * 
+ * @return const HKCharacteristicMetadata& Metadata
+ */
+const HKCharacteristicMetadata &HKCharacteristic::getMetadata() const {
+    return *metadata;
+}
+
+/**
+ * @brief Override metadata, e.g. a smaller range than the default of the type
+ * Has to be called before the accessory is added, the layout is only hashed once
+ * 
+ * @param metadata New metadata, the description is copied
+ */
+void HKCharacteristic::setMetadata(const HKCharacteristicMetadata &metadata) {
+    const HKCharacteristicMetadata *previous = HKCharacteristic::metadata;
+    HKCharacteristic::metadata = HKMetadata::acquire(metadata);
+    HKMetadata::release(previous);
+}
+
 /**
  * @brief Get id
  * 
@@ -112,135 +292,58 @@ uint HKCharacteristic::getId() const {
  * @param client Client requesting characteristic
  */
 void HKCharacteristic::serializeToJSON(JSON &json, HKValue *jsonValue, uint jsonFormatOptions, HKClient *client) {
-    json.setString("iid");
+    json.setKey("iid");
     json.setInt(id);
 
     if (jsonFormatOptions & HKCharacteristicFormatType) {
-        json.setString("type");
-        String typeConv = String(type, HEX);
-        typeConv.toUpperCase();
-        json.setString(typeConv.c_str());
+        json.setKey("type");
+        json.setHexString(type);
     }
 
     if (jsonFormatOptions & HKCharacteristicFormatPerms) {
-        json.setString("perms");
-        json.startArray();
-        if (permissions & HKPermissionPairedRead) {
-            json.setString("pr");
-        }
-        if (permissions & HKPermissionPairedWrite) {
-            json.setString("pw");
-        }
-        if (permissions & HKPermissionNotify) {
-            json.setString("ev");
-        }
-        if (permissions & HKPermissionAdditionalAuthorization) {
-            json.setString("aa");
-        }
-        if (permissions & HKPermissionTimedWrite) {
-            json.setString("tw");
-        }
-        if (permissions & HKPermissionHidden) {
-            json.setString("hd");
-        }
-        json.endArray();
+        json.setFragment_P(HKFragmentPerms[permissions & 0x3F]);
     }
 
     if (client && (jsonFormatOptions & HKCharacteristicFormatEvents) && (permissions & HKPermissionNotify)) {
-        json.setString("ev");
+        json.setKey("ev");
         json.setBool(hasCallbackEvent(client));
     }
 
     if (jsonFormatOptions & HKCharacteristicFormatMeta) {
-        json.setString("description");
-        json.setString(description.c_str());
-
-        json.setString("format");
-        switch (format) {
-            case HKFormatBool:
-                json.setString("bool");
-                break;
-            case HKFormatUInt8:
-                json.setString("uint8");
-                break;
-            case HKFormatUInt16:
-                json.setString("uint16");
-                break;
-            case HKFormatUInt32:
-                json.setString("uint32");
-                break;
-            case HKFormatUInt64:
-                json.setString("uint64");
-                break;
-            case HKFormatInt:
-                json.setString("int");
-                break;
-            case HKFormatFloat:
-                json.setString("float");
-                break;
-            case HKFormatString:
-                json.setString("string");
-                break;
-            case HKFormatTLV:
-                json.setString("tlv8");
-                break;
-            case HKFormatData:
-                json.setString("data");
-                break;
-        }
+        json.setKey("description");
+        json.setString(metadata->description);
 
-        switch (unit) {
-            case HKUnitNone:
-                break;
-            case HKUnitCelsius:
-                json.setString("unit");
-                json.setString("celsius");
-                break;
-            case HKUnitPercentage:
-                json.setString("unit");
-                json.setString("percentage");
-                break;
-            case HKUnitArcdegrees:
-                json.setString("unit");
-                json.setString("arcdegrees");
-                break;
-            case HKUnitLux:
-                json.setString("unit");
-                json.setString("lux");
-                break;
-            case HKUnitSeconds:
-                json.setString("unit");
-                json.setString("seconds");
-                break;
-        }
+        json.setFragment_P(HKFragmentFormat[metadata->format]);
+        json.setFragment_P(HKFragmentUnit[metadata->unit]);
 
-        if (minValue) {
-            json.setString("minValue");
-            json.setFloat(*minValue);
+        if (metadata->has(HKMetadataMinValue)) {
+            json.setKey("minValue");
+            json.setFloat(metadata->minValue);
         }
 
-        if (maxValue) {
-            json.setString("maxValue");
-            json.setFloat(*maxValue);
+        if (metadata->has(HKMetadataMaxValue)) {
+            json.setKey("maxValue");
+            json.setFloat(metadata->maxValue);
         }
 
-        if (minStep) {
-            json.setString("minStep");
-            json.setFloat(*minStep);
+        if (metadata->has(HKMetadataMinStep)) {
+            json.setKey("minStep");
+            json.setFloat(metadata->minStep);
         }
 
-        if (maxLen) {
-            json.setString("maxLen");
-            json.setFloat(*maxLen);
+        if (metadata->has(HKMetadataMaxLen)) {
+            json.setKey("maxLen");
+            json.setFloat(metadata->maxLen);
         }
 
-        if (maxDataLen) {
-            json.setString("maxDataLen");
-            json.setFloat(*maxDataLen);
+        if (metadata->has(HKMetadataMaxDataLen)) {
+            json.setKey("maxDataLen");
+            json.setFloat(metadata->maxDataLen);
         }
 
+        const HKValidValues &validValues = metadata->validValues;
         if (validValues.count) {
-            json.setString("valid-values");
+            json.setKey("valid-values");
             json.startArray();
 
             for (int i = 0; i < validValues.count; i++) {
@@ -249,8 +352,9 @@ void HKCharacteristic::serializeToJSON(JSON &json, HKValue *jsonValue, uint json
             json.endArray();
         }
 
+        const HKValidValuesRanges &validValuesRanges = metadata->validValuesRanges;
         if (validValuesRanges.count) {
-            json.setString("valid-values-range");
+            json.setKey("valid-values-range");
             json.startArray();
 
             for (int i = 0; i < validValuesRanges.count; i++) {
@@ -266,17 +370,18 @@ void HKCharacteristic::serializeToJSON(JSON &json, HKValue *jsonValue, uint json
     }
 
     if (permissions & HKPermissionPairedRead) {
-        HKValue v = jsonValue ? *jsonValue : getter ? getter() : value;
+        HKFormat format = metadata->format;
+        const HKValue &v = jsonValue ? *jsonValue : getValue();
 
         if (v.isNull) {
-            json.setString("value");
+            json.setKey("value");
             json.setNull();
         } else if (v.format != format) {
             HKLOGERROR("[HKCharacteristic::serializeToJSON] Value format is different from format (id=%d.%d: %d != %d, service=%s, type=%d)\r\n", service->getAccessory()->getId(), id, v.format, format, service->getCharacteristic(HKCharacteristicName)->getValue().stringValue, type);
         } else {
             switch (v.format) {
                 case HKFormatBool:
-                    json.setString("value");
+                    json.setKey("value");
                     json.setBool(v.boolValue);
                     break;
                 case HKFormatUInt8:
@@ -284,20 +389,21 @@ void HKCharacteristic::serializeToJSON(JSON &json, HKValue *jsonValue, uint json
                 case HKFormatUInt32:
                 case HKFormatUInt64:
                 case HKFormatInt:
-                    json.setString("value");
+                    json.setKey("value");
                     json.setInt(v.intValue);
                     break;
                 case HKFormatFloat:
-                    json.setString("value");
-                    json.setFloat(v.floatValue);
+                    json.setKey("value");
+                    json.setFloat(v.floatValue, metadata->has(HKMetadataMinStep) ? metadata->minStep : 0);
                     break;
                 case HKFormatString:
-                    json.setString("value");
+                    json.setKey("value");
                     json.setString(v.stringValue);
                     break;
                 case HKFormatTLV:
-                    break;
                 case HKFormatData:
+                    json.setKey("value");
+                    json.setBase64(v.getData(), v.dataLength);
                     break;
                 default:
                     break;
@@ -309,27 +415,36 @@ void HKCharacteristic::serializeToJSON(JSON &json, HKValue *jsonValue, uint json
 /**
  * @brief Set current value from JSON input
  * 
- * @param jsonValue input as JSON String
+ * @param jsonValue input as JSON, points into the request body and is not null terminated
+ * @param length Length of jsonValue
+ * @param client Client writing the value, it does not get an event for its own write
  * @return HAPStatus Was setting the value successful
  */
-HAPStatus HKCharacteristic::setValue(const String& jsonValue) {
+HAPStatus HKCharacteristic::setValue(const char *jsonValue, size_t length, HKClient *client) {
     if (!(permissions & HKPermissionPairedWrite)) {
         HKLOGERROR("[HKCharacteristic::setValue] Failed to set characteristic value (id=%d.%d, service=%s, type=%d): no write permission\r\n", service->getAccessory()->getId(), id, service->getCharacteristic(HKCharacteristicName)->getValue().stringValue, type);
         return HAPStatusReadOnly;
     }
 
+    const HKCharacteristicMetadata &metadata = *HKCharacteristic::metadata;
+    const HKFormat format = metadata.format;
+    // Scalars are short, only they are copied out of the body to be parsed
+    String scalar;
+    if (format != HKFormatTLV && format != HKFormatData) {
+        scalar.concat(jsonValue, length);
+    }
     HKValue hkValue = HKValue();
     switch (format) {
         case HKFormatBool: {
             bool result;
-            String compare = jsonValue;
+            String compare = scalar;
             compare.toLowerCase();
             if (compare == "false" || compare == "0") {
                 result = false;
             } else if (compare == "true" || compare == "1") {
                 result = true;
             } else {
-                HKLOGERROR("[HKCharacteristic::setValue] Failed to update (id=%d.%d, service=%s, type=%d): Json is not of type bool (%s)\r\n", service->getAccessory()->getId(), id, service->getCharacteristic(HKCharacteristicName)->getValue().stringValue, type, jsonValue.c_str());
+                HKLOGERROR("[HKCharacteristic::setValue] Failed to update (id=%d.%d, service=%s, type=%d): Json is not of type bool (%s)\r\n", service->getAccessory()->getId(), id, service->getCharacteristic(HKCharacteristicName)->getValue().stringValue, type, scalar.c_str());
                 return HAPStatusInvalidValue;
             }
 
@@ -339,8 +454,7 @@ HAPStatus HKCharacteristic::setValue(const String& jsonValue) {
                 hkValue = HKValue(HKFormatBool, result);
                 setter(hkValue);
             } else {
-                hkValue = value;
-                value.boolValue = result;
+                value = HKValue(HKFormatBool, result);
             }
             break;
         }
@@ -349,7 +463,7 @@ HAPStatus HKCharacteristic::setValue(const String& jsonValue) {
         case HKFormatUInt32:
         case HKFormatUInt64:
         case HKFormatInt: {
-            uint64_t result = jsonValue.toInt();
+            uint64_t result = scalar.toInt();
 
             uint64_t checkMinValue = 0;
             uint64_t checkMaxValue = 0;
@@ -383,11 +497,11 @@ HAPStatus HKCharacteristic::setValue(const String& jsonValue) {
                     break;
             }
 
-            if (minValue) {
-                checkMinValue = std::llrintf(*minValue);
+            if (metadata.has(HKMetadataMinValue)) {
+                checkMinValue = std::llrintf(metadata.minValue);
             }
-            if (maxValue) {
-                checkMaxValue = std::llrintf(*maxValue);
+            if (metadata.has(HKMetadataMaxValue)) {
+                checkMaxValue = std::llrintf(metadata.maxValue);
             }
 
             if (result < checkMinValue || result > checkMaxValue) {
@@ -395,6 +509,7 @@ HAPStatus HKCharacteristic::setValue(const String& jsonValue) {
                 return HAPStatusInvalidValue;
             }
 
+            const HKValidValues &validValues = metadata.validValues;
             if (validValues.count) {
                 bool matches = false;
                 for (int i = 0; i < validValues.count; i++) {
@@ -410,6 +525,7 @@ HAPStatus HKCharacteristic::setValue(const String& jsonValue) {
                 }
             }
 
+            const HKValidValuesRanges &validValuesRanges = metadata.validValuesRanges;
             if (validValuesRanges.count) {
                 bool matches = false;
                 for (int i = 0; i < validValuesRanges.count; i++) {
@@ -430,15 +546,14 @@ HAPStatus HKCharacteristic::setValue(const String& jsonValue) {
                 hkValue = HKValue(format, result);
                 setter(hkValue);
             } else {
-                hkValue = value;
-                value.intValue = result;
+                value = HKValue(format, result);
             }
             break;
         }
         case HKFormatFloat: {
-            float result = jsonValue.toFloat();
+            float result = scalar.toFloat();
 
-            if ((minValue && result < *minValue) || (maxValue && result > *maxValue)) {
+            if ((metadata.has(HKMetadataMinValue) && result < metadata.minValue) || (metadata.has(HKMetadataMaxValue) && result > metadata.maxValue)) {
                 HKLOGERROR("[HKCharacteristic::setValue] Failed to update (id=%d.%d, service=%s, type=%d): float is not in range\r\n", service->getAccessory()->getId(), id, service->getCharacteristic(HKCharacteristicName)->getValue().stringValue, type);
                 return HAPStatusInvalidValue;
             }
@@ -449,15 +564,14 @@ HAPStatus HKCharacteristic::setValue(const String& jsonValue) {
                 hkValue = HKValue(HKFormatFloat, result);
                 setter(hkValue);
             } else {
-                hkValue = value;
-                value.floatValue = result;
+                value = HKValue(HKFormatFloat, result);
             }
             break;
         }
         case HKFormatString: {
-            const char *result = jsonValue.c_str();
+            const char *result = scalar.c_str();
 
-            uint checkMaxLen = maxLen ? *maxLen : 64;
+            uint checkMaxLen = metadata.has(HKMetadataMaxLen) ? metadata.maxLen : 64;
             if (strlen(result) > checkMaxLen) {
                 HKLOGERROR("[HKCharacteristic::setValue] Failed to update (id=%d.%d, service=%s, type=%d): String is too long\r\n", service->getAccessory()->getId(), id, service->getCharacteristic(HKCharacteristicName)->getValue().stringValue, type);
                 return HAPStatusInvalidValue;
@@ -469,26 +583,63 @@ HAPStatus HKCharacteristic::setValue(const String& jsonValue) {
                 hkValue = HKValue(HKFormatString, result);
                 setter(hkValue);
             } else {
-                hkValue = value;
-                value.stringValue = result;
+                value = HKValue(HKFormatString, result);
             }
             break;
         }
-        case HKFormatTLV: {
-            HKLOGERROR("[HKCharacteristic::setValue] (id=%d.%d, service=%s, type=%d) TLV not supported yet\r\n", service->getAccessory()->getId(), id, service->getCharacteristic(HKCharacteristicName)->getValue().stringValue, type);
-            break;
-        }
+        case HKFormatTLV:
         case HKFormatData: {
-            HKLOGERROR("[HKCharacteristic::setValue] (id=%d.%d, service=%s, type=%d) Data not supported yet\r\n", service->getAccessory()->getId(), id, service->getCharacteristic(HKCharacteristicName)->getValue().stringValue, type);
+            // Base64 string, decoded straight into the buffer of the new value
+            const char *input = jsonValue;
+            size_t inputLength = length;
+            if (inputLength < 2 || input[0] != '"' || input[inputLength - 1] != '"') {
+                HKLOGERROR("[HKCharacteristic::setValue] Failed to update (id=%d.%d, service=%s, type=%d): Json is not a string\r\n", service->getAccessory()->getId(), id, service->getCharacteristic(HKCharacteristicName)->getValue().stringValue, type);
+                return HAPStatusInvalidValue;
+            }
+            input++;
+            inputLength -= 2;
+
+            int dataLength = decodedBase64Length(input, inputLength);
+            uint checkMaxDataLen = metadata.has(HKMetadataMaxDataLen) ? metadata.maxDataLen : HKCHARACTERISTIC_MAX_DATA_LEN;
+            if (dataLength < 0 || (uint) dataLength > checkMaxDataLen) {
+                HKLOGERROR("[HKCharacteristic::setValue] Failed to update (id=%d.%d, service=%s, type=%d): invalid base64 or too long\r\n", service->getAccessory()->getId(), id, service->getCharacteristic(HKCharacteristicName)->getValue().stringValue, type);
+                return HAPStatusInvalidValue;
+            }
+
+            HKValue result = HKValue(format, nullptr, dataLength);
+            if (dataLength > 0) {
+                if (!result.getMutableData()) {
+                    HKLOGERROR("[HKCharacteristic::setValue] Failed to update (id=%d.%d, service=%s, type=%d): out of memory\r\n", service->getAccessory()->getId(), id, service->getCharacteristic(HKCharacteristicName)->getValue().stringValue, type);
+                    return HAPStatusOutOfResources;
+                }
+                decodeBase64(input, inputLength, result.getMutableData());
+            }
+
+            if (format == HKFormatTLV && !isValidTLV8(result.getData(), result.dataLength)) {
+                HKLOGERROR("[HKCharacteristic::setValue] Failed to update (id=%d.%d, service=%s, type=%d): TLV8 is truncated\r\n", service->getAccessory()->getId(), id, service->getCharacteristic(HKCharacteristicName)->getValue().stringValue, type);
+                return HAPStatusInvalidValue;
+            }
+
+            HKLOGINFO("[HKCharacteristic::setValue] Update Characteristic (id=%d.%d, service=%s, type=%d) with %d bytes\r\n", service->getAccessory()->getId(), id, service->getCharacteristic(HKCharacteristicName)->getValue().stringValue, type, dataLength);
+
+            if (setter) {
+                hkValue = std::move(result);
+                setter(hkValue);
+            } else {
+                value = std::move(result);
+            }
             break;
         }
     }
 
-    if (!hkValue.isNull) {
-        if (getter) {
-            hkValue = getter();
-        }
-        notify(hkValue);
+    // Without a setter the new value is stored in value, with a setter it is in hkValue
+    if (getter && cacheTime) {
+        refreshValue();
+        notify(value, client);
+    } else if (getter) {
+        notify(getter(), client);
+    } else {
+        notify(setter ? hkValue : value, client);
     }
     return HAPStatusSuccess;
 }
@@ -532,10 +683,40 @@ HAPStatus HKCharacteristic::setEvent(HKClient *client, const String& jsonValue)
  * @brief Notify connected clients about a change of value
  * 
  * @param newValue New value
+ * @param origin Client that caused the change, it is not notified
  */
-void HKCharacteristic::notify(const HKValue& newValue) {
+void HKCharacteristic::notify(const HKValue& newValue, HKClient *origin) {
     for (HKClient *client : notifiers) {
-        client->scheduleEvent(this, newValue);
+        if (client != origin) {
+            client->scheduleEvent(this, newValue);
+        }
+    }
+}
+
+/**
+ * @brief Read the getter into the cached value
+ * 
+ * @return true Value differs from the previously cached one
+ * @return false Value is unchanged
+ */
+bool HKCharacteristic::refreshValue() {
+    const HKValue &newValue = getter();
+    cacheUpdated = millis();
+    cacheValid = true;
+    if (value == newValue) {
+        return false;
+    }
+    value = newValue;
+    return true;
+}
+
+/**
+ * @brief Refresh an expired cached value while clients are registered for events, called from the update routine
+ * 
+ */
+void HKCharacteristic::pollValue() {
+    if (getter && cacheTime && !notifiers.empty()) {
+        getValue();
     }
 }
 
@@ -13,6 +13,8 @@
 #define HAP_SERVER_HKCHARACTERISTIC_H
 
 #define HKCHARACTERISTIC_CLASS_ID 0
+// Default maxDataLen of data values in the HAP specification
+#define HKCHARACTERISTIC_MAX_DATA_LEN 2097152
 
 #include <Arduino.h>
 #include "JSON/JSON.h"
@@ -20,21 +22,7 @@
 #include "HKClient.h"
 #include "HKService.h"
 #include "ESPHomeKit.h"
-
-struct HKValidValues {
-    int count;
-    uint8_t *values;
-};
-
-struct HKValidValuesRange {
-    uint8_t start;
-    uint8_t end;
-};
-
-struct HKValidValuesRanges {
-    int count;
-    HKValidValuesRange *ranges;
-};
+#include "HKMetadata.h"
 
 class HKAccessory;
 class HKService;
@@ -45,24 +33,30 @@ class HKCharacteristic {
 public:
     HKCharacteristic(HKCharacteristicType type, const HKValue &value, uint8_t permissions,
                      String description, HKFormat format, HKUnit unit=HKUnitNone, float *minValue=nullptr, float *maxValue=nullptr, float *minStep=nullptr, uint *maxLen=nullptr, uint *maxDataLen=nullptr, HKValidValues validValues=HKValidValues(), HKValidValuesRanges validValuesRanges=HKValidValuesRanges());
+    HKCharacteristic(HKCharacteristicType type, const HKValue &value, uint8_t permissions=0);
     virtual ~HKCharacteristic();
     virtual uint getClassId() { return HKCHARACTERISTIC_CLASS_ID; };
 
     uint getId() const;
     HKCharacteristicType getType() const;
-    const HKValue &getValue() const;
+    const HKValue &getValue();
     HKService *getService();
+    const HKCharacteristicMetadata &getMetadata() const;
+    void setMetadata(const HKCharacteristicMetadata &metadata);
 
     void setGetter(const std::function<const HKValue &()> &getter);
     void setSetter(const std::function<void(const HKValue)> &setter);
-    void notify(const HKValue& newValue);
+    void setCacheTime(unsigned long cacheTime);
+    void notify(const HKValue& newValue, HKClient *origin = nullptr);
 private:
-    HAPStatus setValue(const String& jsonValue);
+    HAPStatus setValue(const char *jsonValue, size_t length, HKClient *client = nullptr);
     HAPStatus setEvent(HKClient *client, const String& jsonValue);
     void addCallbackEvent(HKClient *client);
     void removeCallbackEvent(HKClient *client);
     bool hasCallbackEvent(HKClient *client);
     void serializeToJSON(JSON &json, HKValue *jsonValue, uint format = 0xF, HKClient *client = nullptr);
+    bool refreshValue();
+    void pollValue();
 
     friend HKAccessory;
     friend HKService;
@@ -75,22 +69,15 @@ private:
     HKCharacteristicType type;
     HKValue value;
     uint8_t permissions;
-    String description;
-    HKUnit unit;
-    HKFormat format;
-
-    float *minValue;
-    float *maxValue;
-    float *minStep;
-    uint *maxLen;
-    uint *maxDataLen;
-
-    HKValidValues validValues;
-    HKValidValuesRanges validValuesRanges;
+    const HKCharacteristicMetadata *metadata;   // shared, see HKMetadata
 
     std::function<const HKValue &()> getter;
     std::function<void(const HKValue)> setter;
 
+    unsigned long cacheTime;        // 0 calls the getter on every read
+    unsigned long cacheUpdated;
+    bool cacheValid;
+
     std::vector<HKClient *> notifiers;
 };
 
@@ -102,7 +89,7 @@ struct ClientEvent {
 
 class HKEvent {
 public:
-    inline HKEvent(HKCharacteristic *characteristic, HKValue value) : characteristic(characteristic), value(value) {};
+    inline HKEvent(HKCharacteristic *characteristic, HKValue value) : characteristic(characteristic), value(std::move(value)) {};
     inline HKCharacteristic *getCharacteristic() { return characteristic; };
     inline HKValue *getValue() { return &value; };
 private:
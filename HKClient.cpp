@@ -147,7 +147,7 @@ uint8_t HKClient::getPermission() {
 }
 
 /**
- * @brief Pairing id to look up in EEPROM
+ * @brief Pairing id to look up in storage
  * 
  * @return int Id
  */
@@ -182,7 +182,7 @@ void HKClient::setEncryption(bool encryption) {
  */
 size_t HKClient::prepareEncryption(uint8_t *accessoryPublicKey, uint8_t *encryptedResponseData, const uint8_t *devicePublicKey) {
     if (encryptedResponseData == nullptr) {
-        return 2 + HKStorage::getAccessoryId().length() + 2 + 64 + 16;
+        return 2 + HKIdentity::getAccessoryIdLength() + 2 + 64 + 16;
     }
     if (verifyContext == nullptr) {
         verifyContext = new VerifyContext();
@@ -191,39 +191,36 @@ size_t HKClient::prepareEncryption(uint8_t *accessoryPublicKey, uint8_t *encrypt
 
     os_get_random(verifyContext->accessorySecretKey, 32);
 
+    #if HKLOGLEVEL == 0
+    unsigned long scalarmultStart = micros();
+    #endif
     crypto_scalarmult_curve25519_base(verifyContext->accessoryPublicKey, verifyContext->accessorySecretKey);
     crypto_scalarmult_curve25519(verifyContext->sharedKey, verifyContext->accessorySecretKey, verifyContext->devicePublicKey);
+    HKLOGDEBUG("[HKClient::prepareEncryption] X25519 took %lu us\r\n", micros() - scalarmultStart);
 
     memcpy(accessoryPublicKey, verifyContext->accessoryPublicKey, 32);
 
-    String accessoryId = HKStorage::getAccessoryId();
-    size_t accessoryInfoSize = 32 + accessoryId.length() + 32;
-    uint8_t *accessoryInfo = (uint8_t *) malloc(accessoryInfoSize);
+    const char *accessoryId = HKIdentity::getAccessoryId();
+    size_t accessoryIdLength = HKIdentity::getAccessoryIdLength();
+    size_t accessoryInfoSize = 32 + accessoryIdLength + 32;
+    uint8_t accessoryInfo[32 + ACCESSORY_ID_SIZE + 1 + 32];
     memcpy(accessoryInfo, accessoryPublicKey, 32);
-    memcpy(accessoryInfo + 32, accessoryId.c_str(), accessoryId.length());
-    memcpy(accessoryInfo + 32 + accessoryId.length(), devicePublicKey, 32);
+    memcpy(accessoryInfo + 32, accessoryId, accessoryIdLength);
+    memcpy(accessoryInfo + 32 + accessoryIdLength, devicePublicKey, 32);
 
     uint8_t accessorySignature[64];
-    Ed25519::sign(accessorySignature, HKStorage::getAccessoryKey().privateKey, HKStorage::getAccessoryKey().publicKey, accessoryInfo, accessoryInfoSize);
-    free(accessoryInfo);
-
-    std::vector<HKTLV *> subResponseMessage = {
-            new HKTLV(TLVTypeIdentifier, (uint8_t *) accessoryId.c_str(), accessoryId.length()),
-            new HKTLV(TLVTypeSignature, accessorySignature, 64)
-    };
-    size_t responseSize = HKTLV::getFormattedTLVSize(subResponseMessage);
-    if (encryptedResponseData == nullptr) {
-        return responseSize + 16;
-    }
-    uint8_t *responseData = (uint8_t *) malloc(responseSize);
-    HKTLV::formatTLV(subResponseMessage, responseData);
+    HKIdentity::sign(accessorySignature, accessoryInfo, accessoryInfoSize);
+
+    HKTLVWriter subResponseMessage(2 + accessoryIdLength + 2 + 64, 0);
+    subResponseMessage.add(TLVTypeIdentifier, (const uint8_t *) accessoryId, accessoryIdLength);
+    subResponseMessage.add(TLVTypeSignature, accessorySignature, 64);
+    size_t responseSize = subResponseMessage.getSize();
 
     const char salt1[] = "Pair-Verify-Encrypt-Salt";
-    const char info1[] = "Pair-Verify-Encrypt-Info\001";
+    const char info1[] = "Pair-Verify-Encrypt-Info";
     hkdf(verifyContext->sessionKey, verifyContext->sharedKey, 32, (uint8_t *) salt1, sizeof(salt1)-1, (uint8_t *) info1, sizeof(info1)-1);
 
-    crypto_encryptAndSeal(verifyContext->sessionKey, (uint8_t *) "PV-Msg02", responseData, responseSize, encryptedResponseData, encryptedResponseData + responseSize);
-    free(responseData);
+    crypto_encryptAndSeal(verifyContext->sessionKey, (uint8_t *) "PV-Msg02", (uint8_t *) subResponseMessage.getData(), responseSize, encryptedResponseData, encryptedResponseData + responseSize);
 
     return responseSize + 16;
 }
@@ -236,84 +233,74 @@ size_t HKClient::prepareEncryption(uint8_t *accessoryPublicKey, uint8_t *encrypt
  * @return true Encryption successful
  * @return false Could not setup encryption
  */
-bool HKClient::finishEncryption(uint8_t *encryptedData, const size_t &encryptedSize) {
+bool HKClient::finishEncryption(const uint8_t *encryptedData, const size_t &encryptedSize) {
+    // Identifier and signature, the cipher takes 8 bit lengths anyway
+    uint8_t decryptedData[255];
     size_t decryptedDataSize = encryptedSize - 16;
-    uint8_t *decryptedData = (uint8_t *) malloc(decryptedDataSize);
-    if (!crypto_verifyAndDecrypt(verifyContext->sessionKey, (byte *) "PV-Msg03", encryptedData, decryptedDataSize, decryptedData, encryptedData + decryptedDataSize)) {
+    if (encryptedSize < 16 || decryptedDataSize > sizeof(decryptedData) || !crypto_verifyAndDecrypt(verifyContext->sessionKey, (byte *) "PV-Msg03", (uint8_t *) encryptedData, decryptedDataSize, decryptedData, (uint8_t *) encryptedData + decryptedDataSize)) {
         HKLOGINFO("[HKClient::onPairVerify] Could not verify message\r\n");
         delete verifyContext;
         verifyContext = nullptr;
         return false;
     }
 
-    std::vector<HKTLV *> decryptedMessage = HKTLV::parseTLV(decryptedData, decryptedDataSize);
-    free(decryptedData);
-    HKTLV *deviceId = HKTLV::findTLV(decryptedMessage, TLVTypeIdentifier);
-    if (!deviceId) {
+    HKTLVReader decryptedMessage(decryptedData, decryptedDataSize);
+    const uint8_t *deviceId = decryptedMessage.getValue(TLVTypeIdentifier);
+    size_t deviceIdSize = decryptedMessage.getSize(TLVTypeIdentifier);
+    if (!deviceId || deviceIdSize > sizeof(Pairing::deviceId)) {
         HKLOGINFO("[HKClient::onPairVerify] Could not find device ID\r\n");
-        for (auto msg : decryptedMessage) {
-            delete msg;
-        }
         delete verifyContext;
         verifyContext = nullptr;
         return false;
     }
 
-    HKTLV *deviceSignature = HKTLV::findTLV(decryptedMessage, TLVTypeSignature);
+    const uint8_t *deviceSignature = decryptedMessage.getValue(TLVTypeSignature);
     if (!deviceSignature) {
         HKLOGINFO("[HKClient::onPairVerify] Could not find device Signature\r\n");
-        for (auto msg : decryptedMessage) {
-            delete msg;
-        }
         delete verifyContext;
         verifyContext = nullptr;
         return false;
     }
 
-    Pairing *pairingItem = HKStorage::findPairing((char *) deviceId->getValue());
+    char deviceIdentifier[sizeof(Pairing::deviceId) + 1];
+    memcpy(deviceIdentifier, deviceId, deviceIdSize);
+    deviceIdentifier[deviceIdSize] = '\0';
+    const Pairing *pairingItem = HKStorage::findPairing(deviceIdentifier);
     if (!pairingItem) {
         HKLOGINFO("[HKClient::onPairVerify] Device is not paired\r\n");
-        for (auto msg : decryptedMessage) {
-            delete msg;
-        }
         delete verifyContext;
         verifyContext = nullptr;
         return false;
     }
 
-    size_t deviceInfoSize = sizeof(verifyContext->devicePublicKey) + sizeof(verifyContext->accessoryPublicKey) + deviceId->getSize();
+    size_t deviceInfoSize = sizeof(verifyContext->devicePublicKey) + sizeof(verifyContext->accessoryPublicKey) + deviceIdSize;
     uint8_t *deviceInfo = (uint8_t *) malloc(deviceInfoSize);
     memcpy(deviceInfo, verifyContext->devicePublicKey, sizeof(verifyContext->devicePublicKey));
-    memcpy(deviceInfo + sizeof(verifyContext->devicePublicKey), deviceId->getValue(), deviceId->getSize());
-    memcpy(deviceInfo + sizeof(verifyContext->devicePublicKey) + deviceId->getSize(), verifyContext->accessoryPublicKey, sizeof(verifyContext->accessoryPublicKey));
+    memcpy(deviceInfo + sizeof(verifyContext->devicePublicKey), deviceId, deviceIdSize);
+    memcpy(deviceInfo + sizeof(verifyContext->devicePublicKey) + deviceIdSize, verifyContext->accessoryPublicKey, sizeof(verifyContext->accessoryPublicKey));
 
-    if (!Ed25519::verify(deviceSignature->getValue(), pairingItem->deviceKey, deviceInfo, deviceInfoSize)) {
+    if (decryptedMessage.getSize(TLVTypeSignature) != 64 || crypto_sign_ed25519_verify_detached(deviceSignature, deviceInfo, deviceInfoSize, pairingItem->deviceKey) != 0) {
         HKLOGINFO("[HKClient::onPairVerify] Could not verify device readInfo\r\n");
         free(deviceInfo);
-        delete pairingItem;
-        for (auto msg : decryptedMessage) {
-            delete msg;
-        }
         delete verifyContext;
         verifyContext = nullptr;
         return false;
     }
     free(deviceInfo);
 
+    // Both session keys share salt and secret, so extract once and expand twice
     const byte salt[] = "Control-Salt";
-    const byte readInfo[] = "Control-Read-Encryption-Key\001";
-    hkdf(readKey, verifyContext->sharedKey, 32, (uint8_t *) salt, sizeof(salt)-1, (uint8_t *) readInfo, sizeof(readInfo)-1);
+    crypto_auth_hmacsha512_state prk;
+    crypto_kdf_hkdf_sha512_extract(&prk, salt, sizeof(salt)-1, verifyContext->sharedKey, 32);
+
+    const byte readInfo[] = "Control-Read-Encryption-Key";
+    crypto_kdf_hkdf_sha512_expand(readKey, 32, &prk, readInfo, sizeof(readInfo)-1);
 
-    const byte writeInfo[] = "Control-Write-Encryption-Key\001";
-    hkdf(writeKey, verifyContext->sharedKey, 32, (uint8_t *) salt, sizeof(salt)-1, (uint8_t *) writeInfo, sizeof(writeInfo)-1);
+    const byte writeInfo[] = "Control-Write-Encryption-Key";
+    crypto_kdf_hkdf_sha512_expand(writeKey, 32, &prk, writeInfo, sizeof(writeInfo)-1);
 
     pairingId = pairingItem->id;
     permission = pairingItem->permissions;
-    delete pairingItem;
-
-    for (auto msg : decryptedMessage) {
-        delete msg;
-    }
 
     return true;
 }
@@ -431,22 +418,26 @@ void HKClient::sendJSONErrorResponse(int errorCode, HAPStatus status) {
 /**
  * @brief Send TLVs to client
  * 
- * @param message TLVs
+ * The header is formatted once the body size is known and put into the headroom of the writer, so header and
+ * body go out in one piece without being copied into another buffer.
+ * 
+ * @param response TLVs, written with HKTLV_WRITER_HEADROOM
  */
-void HKClient::sendTLVResponse(const std::vector<HKTLV *> &message) {
-    size_t bodySize = HKTLV::getFormattedTLVSize(message);
-
-    uint8_t *body = (uint8_t *) malloc(bodySize);
-    HKTLV::formatTLV(message, body);
-    size_t headersSize = sizeof(http_header_tlv8) + 3;
-
-    char *response = (char *) malloc(headersSize + bodySize);
-    size_t currentSize = snprintf_P(response, headersSize, http_header_tlv8, bodySize);
-    memcpy(response + currentSize, body, bodySize);
-    free(body);
+void HKClient::sendTLVResponse(HKTLVWriter &response) {
+    if (!response.isValid()) {
+        HKLOGERROR("[HKClient::sendTLVResponse] Response is incomplete\r\n");
+        return;
+    }
 
-    send((uint8_t *) response, currentSize + bodySize);
-    free(response);
+    char header[sizeof(http_header_tlv8) + 8];
+    size_t headerSize = snprintf_P(header, sizeof(header), http_header_tlv8, response.getSize());
+    uint8_t *message = response.prepend((uint8_t *) header, headerSize);
+    if (message) {
+        send(message, headerSize + response.getSize());
+    } else {
+        send((uint8_t *) header, headerSize);
+        send((uint8_t *) response.getData(), response.getSize());
+    }
 }
 
 /**
@@ -456,16 +447,11 @@ void HKClient::sendTLVResponse(const std::vector<HKTLV *> &message) {
  * @param error Error descirption
  */
 void HKClient::sendTLVError(const uint8_t &state, const TLVError &error) {
-    std::vector<HKTLV *> message = {
-            new HKTLV(TLVTypeState, state, 1),
-            new HKTLV(TLVTypeError, error, 1)
-    };
+    HKTLVWriter message(6);
+    message.add(TLVTypeState, state);
+    message.add(TLVTypeError, (uint8_t) error);
 
     sendTLVResponse(message);
-    for (auto it = message.begin(); it != message.end();) {
-        delete *it;
-        it = message.erase(it);
-    }
 }
 
 /**
@@ -482,13 +468,13 @@ void HKClient::processNotifications() {
 
         JSON json = JSON(256, std::bind(&HKClient::sendChunk, this, std::placeholders::_1, std::placeholders::_2));
         json.startObject();
-        json.setString("characteristics");
+        json.setKey("characteristics");
         json.startArray();
 
         for (auto it = events.begin(); it != events.end();) {
             json.startObject();
 
-            json.setString("aid");
+            json.setKey("aid");
             json.setInt((*it)->getCharacteristic()->getService()->getAccessory()->getId());
 
             (*it)->getCharacteristic()->serializeToJSON(json, (*it)->getValue(), 0);
@@ -513,7 +499,7 @@ void HKClient::processNotifications() {
  * @param newValue Value of Characteristic
  */
 void HKClient::scheduleEvent(HKCharacteristic *characteristic, HKValue newValue) {
-    events.push_back(new HKEvent(characteristic, newValue));
+    events.push_back(new HKEvent(characteristic, std::move(newValue)));
 }
 
 // PRIVATE FUNCTIONS
@@ -15,6 +15,7 @@
 #include "HKDefinitions.h"
 #include "HKCharacteristic.h"
 #include "HKStorage.h"
+#include "HKIdentity.h"
 
 struct VerifyContext {
     byte accessorySecretKey[32];
@@ -63,7 +64,7 @@ public:
     void setEncryption(bool encryption);
 
     size_t prepareEncryption(uint8_t *accessoryPublicKey, uint8_t *encryptedResponseData, const uint8_t *devicePublicKey);
-    bool finishEncryption(uint8_t *encryptedData, const size_t &encryptedSize);
+    bool finishEncryption(const uint8_t *encryptedData, const size_t &encryptedSize);
     bool didStartEncryption();
     void resetEncryption();
 
@@ -71,7 +72,7 @@ public:
     void sendChunk(uint8_t *message, size_t messageSize);
     void sendJSONResponse(int errorCode, const char *message, const size_t &messageSize);
     void sendJSONErrorResponse(int errorCode, HAPStatus status);
-    void sendTLVResponse(const std::vector<HKTLV *> &message);
+    void sendTLVResponse(HKTLVWriter &response);
     void sendTLVError(const uint8_t &state, const TLVError &error);
 
     void processNotifications();
@@ -255,6 +255,16 @@ enum PairingPermission {
     PairingPermissionAdmin = (1 << 0)
 };
 
+// Strings shorter than this are stored in the value itself, longer ones and TLV8 or data values in a shared buffer
+#ifndef HKVALUE_INLINE_STRING_SIZE
+#define HKVALUE_INLINE_STRING_SIZE 12
+#endif
+
+struct HKSharedString {
+    uint16_t references;
+    char data[1];
+};
+
 class HKValue {
 public:
     bool isNull : 1;
@@ -264,55 +274,71 @@ public:
         bool boolValue;
         int intValue;
         float floatValue;
-        const char *stringValue;
-        //TLVValues *tlvValues;
-        // Data
+        char inlineString[HKVALUE_INLINE_STRING_SIZE];
+        size_t dataLength;      // TLV8 and data values
     };
+    const char *stringValue;    // inlineString or data of a HKSharedString, read only, use getData() for TLV8 and data values
 
-    inline HKValue() : isNull(true), isStatic(false), format(HKFormatBool) {};
-    inline explicit HKValue(HKFormat format) : isNull(false), isStatic(false), format(format) {};
-    inline HKValue(HKFormat format, bool value) : isNull(false), isStatic(false), format(format), boolValue(value) {};
-    inline explicit HKValue(HKFormat format, int value) : isNull(false), isStatic(false), format(format), intValue(value) {};
-    inline explicit HKValue(HKFormat format, uint8_t value) : isNull(false), isStatic(false), format(format), intValue(value) {};
-    inline explicit HKValue(HKFormat format, uint16_t value) : isNull(false), isStatic(false), format(format), intValue(value) {};
-    inline explicit HKValue(HKFormat format, uint32_t value) : isNull(false), isStatic(false), format(format), intValue(value) {};
-    inline explicit HKValue(HKFormat format, uint64_t value) : isNull(false), isStatic(false), format(format), intValue(value) {};
-    inline explicit HKValue(HKFormat format, float value) : isNull(false), isStatic(false), format(format), floatValue(value) {};
-    inline explicit HKValue(HKFormat format, const char *value) : isNull(false), isStatic(false), format(format) {
-        stringValue = strdup(value);
+    inline HKValue() : isNull(true), isStatic(false), format(HKFormatBool), stringValue(nullptr) {};
+    inline explicit HKValue(HKFormat format) : isNull(false), isStatic(false), format(format), stringValue(nullptr) {
+        if (format == HKFormatString) {
+            setString("", 0);
+        } else if (format == HKFormatTLV || format == HKFormatData) {
+            dataLength = 0;
+        }
     };
-    inline explicit HKValue(HKFormat format, const String& value) : isNull(false), isStatic(false), format(format) {
-        stringValue = strdup(value.c_str());
+    inline HKValue(HKFormat format, bool value) : isNull(false), isStatic(false), format(format), boolValue(value), stringValue(nullptr) {};
+    inline explicit HKValue(HKFormat format, int value) : isNull(false), isStatic(false), format(format), intValue(value), stringValue(nullptr) {};
+    inline explicit HKValue(HKFormat format, uint8_t value) : isNull(false), isStatic(false), format(format), intValue(value), stringValue(nullptr) {};
+    inline explicit HKValue(HKFormat format, uint16_t value) : isNull(false), isStatic(false), format(format), intValue(value), stringValue(nullptr) {};
+    inline explicit HKValue(HKFormat format, uint32_t value) : isNull(false), isStatic(false), format(format), intValue(value), stringValue(nullptr) {};
+    inline explicit HKValue(HKFormat format, uint64_t value) : isNull(false), isStatic(false), format(format), intValue(value), stringValue(nullptr) {};
+    inline explicit HKValue(HKFormat format, float value) : isNull(false), isStatic(false), format(format), floatValue(value), stringValue(nullptr) {};
+    inline explicit HKValue(HKFormat format, const char *value) : isNull(false), isStatic(false), format(format), stringValue(nullptr) {
+        setString(value ? value : "", value ? strlen(value) : 0);
     };
-    inline HKValue(const HKValue &other) : isNull(other.isNull), isStatic(other.isStatic), format(other.format) {
-        switch (format) {
-            case HKFormatBool:
-                boolValue = other.boolValue;
-                break;
-            case HKFormatInt:
-            case HKFormatUInt8:
-            case HKFormatUInt16:
-            case HKFormatUInt32:
-            case HKFormatUInt64:
-                intValue = other.intValue;
-                break;
-            case HKFormatFloat:
-                floatValue = other.floatValue;
-                break;
-            case HKFormatString:
-                stringValue = strdup(other.stringValue);
-                break;
-            default:
-                break;
-        }
+    inline explicit HKValue(HKFormat format, const String& value) : isNull(false), isStatic(false), format(format), stringValue(nullptr) {
+        setString(value.c_str(), value.length());
+    };
+    /**
+     * @brief TLV8 or data value, data is copied. If data is null the buffer is left uninitialized to be filled through getMutableData()
+     */
+    inline explicit HKValue(HKFormat format, const uint8_t *data, size_t length) : isNull(false), isStatic(false), format(format), dataLength(0), stringValue(nullptr) {
+        setData(data, length);
+    };
+    inline HKValue(const HKValue &other) : isNull(other.isNull), isStatic(other.isStatic), format(other.format), stringValue(nullptr) {
+        copyFrom(other);
+    };
+    inline HKValue(HKValue &&other) noexcept : isNull(other.isNull), isStatic(other.isStatic), format(other.format), stringValue(nullptr) {
+        moveFrom(other);
     };
     inline ~HKValue() {
-        if (format == HKFormatString) {
-            free((char *) stringValue);
+        release();
+    }
+
+    inline HKValue &operator=(const HKValue &other) {
+        if (this != &other) {
+            release();
+            isNull = other.isNull;
+            isStatic = other.isStatic;
+            format = other.format;
+            copyFrom(other);
+        }
+        return *this;
+    }
+
+    inline HKValue &operator=(HKValue &&other) noexcept {
+        if (this != &other) {
+            release();
+            isNull = other.isNull;
+            isStatic = other.isStatic;
+            format = other.format;
+            moveFrom(other);
         }
+        return *this;
     }
 
-    inline bool operator==(const HKValue& b)
+    inline bool operator==(const HKValue& b) const
     {
         if (isNull != b.isNull) {
             return false;
@@ -333,23 +359,105 @@ public:
             case HKFormatFloat:
                 return floatValue == b.floatValue;
             case HKFormatString:
-                return !strcmp(stringValue, b.stringValue);
+                return stringValue == b.stringValue || !strcmp(stringValue, b.stringValue);
             case HKFormatTLV:
-                /*if (!tlvValues && !b.tlvValues) {
-                    return true;
-                }
-                if (!tlvValues || !b.tlvValues) {
-                    return false;
-                }
-                */
-                return false;
-
             case HKFormatData:
-                return false;
+                return dataLength == b.dataLength && (stringValue == b.stringValue || !memcmp(stringValue, b.stringValue, dataLength));
             default:
                 return false;
         }
     }
+
+    inline const uint8_t *getData() const {
+        return (const uint8_t *) stringValue;
+    }
+
+    /**
+     * @brief Writable TLV8 or data buffer, only while the value does not share it
+     */
+    inline uint8_t *getMutableData() {
+        HKSharedString *shared = sharedString();
+        return shared && shared->references == 1 ? (uint8_t *) shared->data : nullptr;
+    }
+private:
+    inline bool hasBuffer() const {
+        return format == HKFormatString || format == HKFormatTLV || format == HKFormatData;
+    }
+
+    inline HKSharedString *sharedString() const {
+        if (!stringValue || stringValue == inlineString) {
+            return nullptr;
+        }
+        return (HKSharedString *) (stringValue - offsetof(HKSharedString, data));
+    }
+
+    inline void setString(const char *value, size_t length) {
+        if (length < HKVALUE_INLINE_STRING_SIZE) {
+            memcpy(inlineString, value, length);
+            inlineString[length] = '\0';
+            stringValue = inlineString;
+            return;
+        }
+
+        auto shared = (HKSharedString *) malloc(sizeof(HKSharedString) + length);
+        if (!shared) {
+            inlineString[0] = '\0';
+            stringValue = inlineString;
+            return;
+        }
+        shared->references = 1;
+        memcpy(shared->data, value, length);
+        shared->data[length] = '\0';
+        stringValue = shared->data;
+    }
+
+    inline void setData(const uint8_t *data, size_t length) {
+        if (length == 0) {
+            return;
+        }
+        auto shared = (HKSharedString *) malloc(sizeof(HKSharedString) + length);
+        if (!shared) {
+            return;
+        }
+        shared->references = 1;
+        if (data) {
+            memcpy(shared->data, data, length);
+        }
+        stringValue = shared->data;
+        dataLength = length;
+    }
+
+    inline void copyFrom(const HKValue &other) {
+        memcpy(inlineString, other.inlineString, sizeof(inlineString));
+        if (hasBuffer() && other.stringValue) {
+            HKSharedString *shared = other.sharedString();
+            if (shared) {
+                shared->references++;
+                stringValue = other.stringValue;
+            } else {
+                stringValue = inlineString;
+            }
+        }
+    }
+
+    inline void moveFrom(HKValue &other) {
+        memcpy(inlineString, other.inlineString, sizeof(inlineString));
+        if (hasBuffer() && other.stringValue) {
+            stringValue = other.sharedString() ? other.stringValue : inlineString;
+        }
+        // The moved-from value is left null, it no longer owns a string
+        other.stringValue = nullptr;
+        other.isNull = true;
+        other.format = HKFormatBool;
+    }
+
+    inline void release() {
+        HKSharedString *shared = sharedString();
+        if (shared && --shared->references == 0) {
+            free(shared);
+        }
+        stringValue = nullptr;
+    }
 };
 
 #endif //LED_HAP_ESP8266_HKDEFINITIONS_H
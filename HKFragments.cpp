@@ -0,0 +1,107 @@
+/**
+ * @file HKFragments.cpp
+ * @brief Pre-rendered JSON fragments for service and characteristic metadata
+ * @version 0.1
+ * @date 2026-10-18
+ * 
+ * @copyright Copyright (c) 2020
+ * 
+ */
+
+#include "HKFragments.h"
+
+const char HKFragmentPerms[64][HKFRAGMENT_PERMS_SIZE] PROGMEM = {
+    "\"perms\":[]",
+    "\"perms\":[\"pr\"]",
+    "\"perms\":[\"pw\"]",
+    "\"perms\":[\"pr\",\"pw\"]",
+    "\"perms\":[\"ev\"]",
+    "\"perms\":[\"pr\",\"ev\"]",
+    "\"perms\":[\"pw\",\"ev\"]",
+    "\"perms\":[\"pr\",\"pw\",\"ev\"]",
+    "\"perms\":[\"aa\"]",
+    "\"perms\":[\"pr\",\"aa\"]",
+    "\"perms\":[\"pw\",\"aa\"]",
+    "\"perms\":[\"pr\",\"pw\",\"aa\"]",
+    "\"perms\":[\"ev\",\"aa\"]",
+    "\"perms\":[\"pr\",\"ev\",\"aa\"]",
+    "\"perms\":[\"pw\",\"ev\",\"aa\"]",
+    "\"perms\":[\"pr\",\"pw\",\"ev\",\"aa\"]",
+    "\"perms\":[\"tw\"]",
+    "\"perms\":[\"pr\",\"tw\"]",
+    "\"perms\":[\"pw\",\"tw\"]",
+    "\"perms\":[\"pr\",\"pw\",\"tw\"]",
+    "\"perms\":[\"ev\",\"tw\"]",
+    "\"perms\":[\"pr\",\"ev\",\"tw\"]",
+    "\"perms\":[\"pw\",\"ev\",\"tw\"]",
+    "\"perms\":[\"pr\",\"pw\",\"ev\",\"tw\"]",
+    "\"perms\":[\"aa\",\"tw\"]",
+    "\"perms\":[\"pr\",\"aa\",\"tw\"]",
+    "\"perms\":[\"pw\",\"aa\",\"tw\"]",
+    "\"perms\":[\"pr\",\"pw\",\"aa\",\"tw\"]",
+    "\"perms\":[\"ev\",\"aa\",\"tw\"]",
+    "\"perms\":[\"pr\",\"ev\",\"aa\",\"tw\"]",
+    "\"perms\":[\"pw\",\"ev\",\"aa\",\"tw\"]",
+    "\"perms\":[\"pr\",\"pw\",\"ev\",\"aa\",\"tw\"]",
+    "\"perms\":[\"hd\"]",
+    "\"perms\":[\"pr\",\"hd\"]",
+    "\"perms\":[\"pw\",\"hd\"]",
+    "\"perms\":[\"pr\",\"pw\",\"hd\"]",
+    "\"perms\":[\"ev\",\"hd\"]",
+    "\"perms\":[\"pr\",\"ev\",\"hd\"]",
+    "\"perms\":[\"pw\",\"ev\",\"hd\"]",
+    "\"perms\":[\"pr\",\"pw\",\"ev\",\"hd\"]",
+    "\"perms\":[\"aa\",\"hd\"]",
+    "\"perms\":[\"pr\",\"aa\",\"hd\"]",
+    "\"perms\":[\"pw\",\"aa\",\"hd\"]",
+    "\"perms\":[\"pr\",\"pw\",\"aa\",\"hd\"]",
+    "\"perms\":[\"ev\",\"aa\",\"hd\"]",
+    "\"perms\":[\"pr\",\"ev\",\"aa\",\"hd\"]",
+    "\"perms\":[\"pw\",\"ev\",\"aa\",\"hd\"]",
+    "\"perms\":[\"pr\",\"pw\",\"ev\",\"aa\",\"hd\"]",
+    "\"perms\":[\"tw\",\"hd\"]",
+    "\"perms\":[\"pr\",\"tw\",\"hd\"]",
+    "\"perms\":[\"pw\",\"tw\",\"hd\"]",
+    "\"perms\":[\"pr\",\"pw\",\"tw\",\"hd\"]",
+    "\"perms\":[\"ev\",\"tw\",\"hd\"]",
+    "\"perms\":[\"pr\",\"ev\",\"tw\",\"hd\"]",
+    "\"perms\":[\"pw\",\"ev\",\"tw\",\"hd\"]",
+    "\"perms\":[\"pr\",\"pw\",\"ev\",\"tw\",\"hd\"]",
+    "\"perms\":[\"aa\",\"tw\",\"hd\"]",
+    "\"perms\":[\"pr\",\"aa\",\"tw\",\"hd\"]",
+    "\"perms\":[\"pw\",\"aa\",\"tw\",\"hd\"]",
+    "\"perms\":[\"pr\",\"pw\",\"aa\",\"tw\",\"hd\"]",
+    "\"perms\":[\"ev\",\"aa\",\"tw\",\"hd\"]",
+    "\"perms\":[\"pr\",\"ev\",\"aa\",\"tw\",\"hd\"]",
+    "\"perms\":[\"pw\",\"ev\",\"aa\",\"tw\",\"hd\"]",
+    "\"perms\":[\"pr\",\"pw\",\"ev\",\"aa\",\"tw\",\"hd\"]",
+};
+
+const char HKFragmentFormat[10][HKFRAGMENT_FORMAT_SIZE] PROGMEM = {
+    "\"format\":\"bool\"",
+    "\"format\":\"uint8\"",
+    "\"format\":\"uint16\"",
+    "\"format\":\"uint32\"",
+    "\"format\":\"uint64\"",
+    "\"format\":\"int\"",
+    "\"format\":\"float\"",
+    "\"format\":\"string\"",
+    "\"format\":\"tlv8\"",
+    "\"format\":\"data\"",
+};
+
+const char HKFragmentUnit[6][HKFRAGMENT_UNIT_SIZE] PROGMEM = {
+    "",
+    "\"unit\":\"celsius\"",
+    "\"unit\":\"percentage\"",
+    "\"unit\":\"arcdegrees\"",
+    "\"unit\":\"lux\"",
+    "\"unit\":\"seconds\"",
+};
+
+const char HKFragmentServiceFlags[4][HKFRAGMENT_FLAGS_SIZE] PROGMEM = {
+    "\"hidden\":false,\"primary\":false",
+    "\"hidden\":true,\"primary\":false",
+    "\"hidden\":false,\"primary\":true",
+    "\"hidden\":true,\"primary\":true",
+};
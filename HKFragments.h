@@ -0,0 +1,32 @@
+/**
+ * @file HKFragments.h
+ * @brief Pre-rendered JSON fragments for service and characteristic metadata
+ * @version 0.1
+ * @date 2026-10-18
+ * 
+ * @copyright Copyright (c) 2020
+ * 
+ * The tables live in flash and are written with JSON::setFragment_P(), so serializing metadata needs
+ * no String, no switch and no heap. Indices are the enum values or permission bits.
+ */
+
+#ifndef HAP_SERVER_HKFRAGMENTS_H
+#define HAP_SERVER_HKFRAGMENTS_H
+
+#include <Arduino.h>
+
+#define HKFRAGMENT_PERMS_SIZE 40
+#define HKFRAGMENT_FORMAT_SIZE 18
+#define HKFRAGMENT_UNIT_SIZE 20
+#define HKFRAGMENT_FLAGS_SIZE 31
+
+// "perms":[...] for every combination of HKPermission bits
+extern const char HKFragmentPerms[64][HKFRAGMENT_PERMS_SIZE] PROGMEM;
+// "format":"..." by HKFormat
+extern const char HKFragmentFormat[10][HKFRAGMENT_FORMAT_SIZE] PROGMEM;
+// "unit":"..." by HKUnit, empty for HKUnitNone
+extern const char HKFragmentUnit[6][HKFRAGMENT_UNIT_SIZE] PROGMEM;
+// "hidden":...,"primary":... by hidden | primary << 1
+extern const char HKFragmentServiceFlags[4][HKFRAGMENT_FLAGS_SIZE] PROGMEM;
+
+#endif //HAP_SERVER_HKFRAGMENTS_H
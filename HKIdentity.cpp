@@ -0,0 +1,174 @@
+/**
+ * @file HKIdentity.cpp
+ * @brief Long-term accessory identity held in RAM
+ * @version 0.1
+ * @date 2026-10-18
+ * 
+ * @copyright Copyright (c) 2020
+ * 
+ */
+
+#include "HKIdentity.h"
+
+static HKIdentity::Identity identity{};
+
+/**
+ * @brief Load the accessory key pair and id from storage, expand the signing key and derive the setup hash
+ * 
+ * Has to be called again whenever the storage is reset, because key pair and id are regenerated.
+ */
+void HKIdentity::load() {
+    KeyPair keyPair = HKStorage::getAccessoryKey();
+    crypto_sign_ed25519_expand(identity.expandedKey, keyPair.privateKey);
+    memcpy(identity.publicKey, keyPair.publicKey, sizeof(identity.publicKey));
+    memset(&keyPair, 0, sizeof(keyPair));
+
+    String accessoryId = HKStorage::getAccessoryId();
+    identity.accessoryIdLength = accessoryId.length() < sizeof(identity.accessoryId) ? accessoryId.length() : sizeof(identity.accessoryId) - 1;
+    memcpy(identity.accessoryId, accessoryId.c_str(), identity.accessoryIdLength);
+    identity.accessoryId[identity.accessoryIdLength] = '\0';
+
+    identity.setupHash[0] = '\0';
+    #ifdef HKSETUPID
+    if (strlen(HKSETUPID) == 4) {
+        // setup id followed by the accessory id without the trailing colon
+        unsigned char data[4 + ACCESSORY_ID_SIZE];
+        memcpy(data, HKSETUPID, 4);
+        memcpy(data + 4, identity.accessoryId, ACCESSORY_ID_SIZE);
+
+        unsigned char shaHash[64];
+        crypto_hash_sha512(shaHash, data, sizeof(data));
+        String encoded = base64::encode(shaHash, 4, false);
+        strncpy(identity.setupHash, encoded.c_str(), sizeof(identity.setupHash) - 1);
+    }
+    #endif
+
+    identity.loaded = true;
+    HKLOGDEBUG("[HKIdentity::load] Loaded accessory identity\r\n");
+}
+
+/**
+ * @brief Derive the mDNS name and the constant TXT records from the accessory information
+ * 
+ * Call after load(), the id and setup hash are taken from the loaded identity.
+ * 
+ * @param name Name of the accessory
+ * @param model Model name of the accessory
+ * @param category Accessory category
+ */
+void HKIdentity::describe(const String &name, const String &model, HKAccessoryCategory category) {
+    if (!identity.loaded) {
+        load();
+    }
+
+    identity.name = name;
+    #ifndef HK_UNIQUE_NAME
+    identity.name += "-" + String(identity.accessoryId).substring(0, 2) + String(identity.accessoryId).substring(3, 5);
+    #endif
+
+    uint8_t i = 0;
+    identity.txt[i++] = {"md", model};
+    identity.txt[i++] = {"pv", "1.0"};
+    identity.txt[i++] = {"id", identity.accessoryId};
+    identity.txt[i++] = {"ff", "0"};    // feature flags, bit 0 - supports HAP pairing, bits 1-7 - reserved
+    identity.txt[i++] = {"ci", String(category)};
+    if (identity.setupHash[0] != '\0') {
+        identity.txt[i++] = {"sh", identity.setupHash};
+    }
+    identity.txtCount = i;
+}
+
+/**
+ * @brief Is the identity loaded
+ * 
+ * @return true Identity is in RAM
+ * @return false load() was not called yet
+ */
+bool HKIdentity::isLoaded() {
+    return identity.loaded;
+}
+
+/**
+ * @brief Ed25519 public key of the accessory (LTPK)
+ * 
+ * @return const byte* 32 byte public key
+ */
+const byte *HKIdentity::getPublicKey() {
+    if (!identity.loaded) {
+        load();
+    }
+    return identity.publicKey;
+}
+
+/**
+ * @brief Sign a message with the accessory key (LTSK) without touching storage
+ * 
+ * @param signature Target for the 64 byte signature
+ * @param message Message to sign
+ * @param messageSize Size of message
+ */
+void HKIdentity::sign(byte *signature, const byte *message, size_t messageSize) {
+    if (!identity.loaded) {
+        load();
+    }
+    if (crypto_sign_ed25519_detached(signature, message, messageSize, identity.expandedKey, identity.publicKey) != 0) {
+        HKLOGERROR("[HKIdentity::sign] Could not sign message\r\n");
+        memset(signature, 0, 64);
+    }
+}
+
+/**
+ * @brief Accessory id, formatted as used in pair-setup and pair-verify
+ * 
+ * @return const char* Null terminated accessory id
+ */
+const char *HKIdentity::getAccessoryId() {
+    if (!identity.loaded) {
+        load();
+    }
+    return identity.accessoryId;
+}
+
+/**
+ * @brief Length of the accessory id
+ * 
+ * @return size_t Length without null terminator
+ */
+size_t HKIdentity::getAccessoryIdLength() {
+    if (!identity.loaded) {
+        load();
+    }
+    return identity.accessoryIdLength;
+}
+
+/**
+ * @brief Setup hash for the sh TXT record
+ * 
+ * @return const char* Base64 encoded hash, empty if no setup id is defined
+ */
+const char *HKIdentity::getSetupHash() {
+    if (!identity.loaded) {
+        load();
+    }
+    return identity.setupHash;
+}
+
+/**
+ * @brief mDNS instance name set by describe()
+ * 
+ * @return const String& Name
+ */
+const String &HKIdentity::getName() {
+    return identity.name;
+}
+
+/**
+ * @brief TXT records that stay the same while running
+ * 
+ * @param count Target for the number of records
+ * @return const HKIdentity::TXTRecord* Records set by describe()
+ */
+const HKIdentity::TXTRecord *HKIdentity::getTXTRecords(size_t &count) {
+    count = identity.txtCount;
+    return identity.txt;
+}
@@ -0,0 +1,55 @@
+/**
+ * @file HKIdentity.h
+ * @brief Long-term accessory identity held in RAM
+ * @version 0.1
+ * @date 2026-10-18
+ * 
+ * @copyright Copyright (c) 2020
+ * 
+ */
+
+#ifndef HAP_SERVER_HKIDENTITY_H
+#define HAP_SERVER_HKIDENTITY_H
+
+#include <Arduino.h>
+#include <base64.h>
+
+#include "HKDebug.h"
+#include "HKStorage.h"
+#include "crypto/tweetnacl.h"
+
+#define HK_TXT_RECORDS 6
+
+namespace HKIdentity {
+    void load();
+    void describe(const String &name, const String &model, HKAccessoryCategory category);
+    bool isLoaded();
+    const byte *getPublicKey();
+    void sign(byte *signature, const byte *message, size_t messageSize);
+
+    const char *getAccessoryId();
+    size_t getAccessoryIdLength();
+    const char *getSetupHash();
+    const String &getName();
+
+    struct TXTRecord {
+        const char *key;
+        String value;
+    };
+    const TXTRecord *getTXTRecords(size_t &count);
+
+    struct Identity {
+        bool loaded;
+        byte expandedKey[64]; // clamped secret scalar followed by the nonce prefix
+        byte publicKey[32];
+        char accessoryId[ACCESSORY_ID_SIZE + 2];    // "XX:XX:XX:XX:XX:XX:" as used in the pairing protocol
+        uint8_t accessoryIdLength;
+        char setupHash[9];  // base64 of the first 4 bytes of SHA-512(setup id + accessory id), empty without HKSETUPID
+        String name;        // mDNS instance name
+        TXTRecord txt[HK_TXT_RECORDS];  // TXT records that do not change while running
+        uint8_t txtCount;
+    };
+};
+
+
+#endif //HAP_SERVER_HKIDENTITY_H
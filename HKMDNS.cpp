@@ -0,0 +1,153 @@
+/**
+ * @file HKMDNS.cpp
+ * @brief Bonjour advertisement of the HAP service
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+
+#include "HKMDNS.h"
+
+/**
+ * @brief Construct a new HKMDNS object
+ *
+ */
+HKMDNS::HKMDNS() : service(nullptr), configNumber(0), stateNumber(0), statusFlags(0), announcements(0), announceInterval(HKMDNS_ANNOUNCE_INTERVAL), nextAnnouncement(0) {
+}
+
+/**
+ * @brief Start the responder and add the HAP service with all TXT records
+ *
+ * The constant records are taken from HKIdentity, so HKIdentity::describe() has to be called before.
+ *
+ * @param port Port of the HAP server
+ * @param configNumber Initial c#
+ * @param paired Initial pairing state for sf
+ * @return true Service is advertised
+ * @return false Failed to start responder or to add a record
+ */
+bool HKMDNS::begin(uint16_t port, uint32_t configNumber, bool paired) {
+    HKLOGINFO("[HKMDNS::begin] Setup mDNS\r\n");
+    const String &uniqueName = HKIdentity::getName();
+    if (!service && !MDNS.begin(uniqueName)) {
+        HKLOGERROR("[HKMDNS::begin] Failed to begin mDNS\r\n");
+        return false;
+    }
+
+    MDNS.setInstanceName(uniqueName);
+    if (!service) {
+        service = MDNS.addService(nullptr, "hap", "tcp", port);
+        if (!service) {
+            HKLOGERROR("[HKMDNS::begin] Failed to add service\r\n");
+            return false;
+        }
+    }
+
+    size_t txtCount;
+    const HKIdentity::TXTRecord *txt = HKIdentity::getTXTRecords(txtCount);
+    if (txtCount == 0) {
+        return false;
+    }
+    for (size_t i = 0; i < txtCount; i++) {
+        if (!MDNS.addServiceTxt(service, txt[i].key, txt[i].value.c_str())) {
+            HKLOGERROR("[HKMDNS::begin] Failed to add %s\r\n", txt[i].key);
+            return false;
+        }
+    }
+
+    // Start from values that can not be current, so every record is written once
+    this->configNumber = 0;
+    stateNumber = 0;
+    statusFlags = 0xFF;
+    bool success = updateTxt("c#", this->configNumber, configNumber) &&
+                   updateTxt("s#", stateNumber, 1) &&
+                   updateTxt("sf", statusFlags, paired ? 0 : 1);
+    // The responder probes and announces a new service by itself
+    announcements = 0;
+    return success;
+}
+
+/**
+ * @brief Call in the update routine, runs the responder and sends pending announcements
+ *
+ */
+void HKMDNS::update() {
+    MDNS.update();
+    if (announcements > 0 && (long) (millis() - nextAnnouncement) >= 0) {
+        HKLOGDEBUG("[HKMDNS::update] Announce, %u left\r\n", announcements - 1);
+        MDNS.announce();
+        announcements--;
+        nextAnnouncement += announceInterval;
+        announceInterval *= 2;
+    }
+}
+
+/**
+ * @brief Set configuration number (c#), announced if it changed
+ *
+ * @param configNumber New configuration number
+ */
+void HKMDNS::setConfigNumber(uint32_t configNumber) {
+    updateTxt("c#", this->configNumber, configNumber);
+}
+
+/**
+ * @brief Set pairing state in the status flags (sf), announced if it changed
+ *
+ * @param paired Accessory has a pairing
+ */
+void HKMDNS::setPaired(bool paired) {
+    updateTxt("sf", statusFlags, paired ? (statusFlags & ~1u) : (statusFlags | 1u));
+}
+
+/**
+ * @brief Current configuration number
+ *
+ * @return uint32_t c#
+ */
+uint32_t HKMDNS::getConfigNumber() const {
+    return configNumber;
+}
+
+/**
+ * @brief Replace a numeric TXT record in place if its value changed
+ *
+ * @param key TXT key
+ * @param current Cached value of the record, updated on success
+ * @param value New value
+ * @return true Record is up to date
+ * @return false Failed to update record
+ */
+bool HKMDNS::updateTxt(const char *key, uint32_t &current, uint32_t value) {
+    if (current == value) {
+        return true;
+    }
+    if (!service) {
+        // Not advertised yet, begin() writes the value
+        current = value;
+        return true;
+    }
+
+    char buffer[11];
+    utoa(value, buffer, 10);
+    if (!MDNS.addServiceTxt(service, key, buffer)) {
+        HKLOGERROR("[HKMDNS::updateTxt] Failed to set %s\r\n", key);
+        return false;
+    }
+    HKLOGINFO("[HKMDNS::updateTxt] %s=%s\r\n", key, buffer);
+    current = value;
+    scheduleAnnouncements();
+    return true;
+}
+
+/**
+ * @brief Start a new announcement burst, the first one is sent on the next update()
+ *
+ */
+void HKMDNS::scheduleAnnouncements() {
+    announcements = HKMDNS_ANNOUNCEMENTS;
+    announceInterval = HKMDNS_ANNOUNCE_INTERVAL;
+    nextAnnouncement = millis();
+}
@@ -0,0 +1,53 @@
+/**
+ * @file HKMDNS.h
+ * @brief Bonjour advertisement of the HAP service
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+
+#ifndef HAP_SERVER_HKMDNS_H
+#define HAP_SERVER_HKMDNS_H
+
+#include <Arduino.h>
+#include <ESP8266mDNS.h>
+
+#include "HKDebug.h"
+#include "HKIdentity.h"
+
+// Announcements sent after a TXT record changed, RFC 6762 8.3 asks for at least two
+#ifndef HKMDNS_ANNOUNCEMENTS
+#define HKMDNS_ANNOUNCEMENTS 3
+#endif
+// Delay between the first two announcements, doubled for every further one
+#define HKMDNS_ANNOUNCE_INTERVAL 1000
+
+class HKMDNS {
+public:
+    HKMDNS();
+
+    bool begin(uint16_t port, uint32_t configNumber, bool paired);
+    void update();
+
+    void setConfigNumber(uint32_t configNumber);
+    void setPaired(bool paired);
+    uint32_t getConfigNumber() const;
+private:
+    bool updateTxt(const char *key, uint32_t &current, uint32_t value);
+    void scheduleAnnouncements();
+
+    esp8266::MDNSImplementation::MDNSResponder::hMDNSService service;
+
+    uint32_t configNumber;      // c#, changes with the accessory layout
+    uint32_t stateNumber;       // s#, always 1 for IP accessories
+    uint32_t statusFlags;       // sf, bit 0 - not paired, bit 1 - not configured to join WiFi, bit 2 - problem detected
+
+    uint8_t announcements;      // announcements left in the current burst
+    uint32_t announceInterval;
+    unsigned long nextAnnouncement;
+};
+
+
+#endif //HAP_SERVER_HKMDNS_H
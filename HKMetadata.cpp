@@ -0,0 +1,219 @@
+/**
+ * @file HKMetadata.cpp
+ * @brief Shared characteristic metadata
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+
+#include "HKMetadata.h"
+
+#define HKMETADATA_DESCRIPTION_SIZE 32
+
+#define PR HKPermissionPairedRead
+#define PW HKPermissionPairedWrite
+#define EV HKPermissionNotify
+#define RANGE (HKMetadataMinValue | HKMetadataMaxValue | HKMetadataMinStep)
+
+struct CatalogEntry {
+    uint8_t type;
+    uint8_t format;
+    uint8_t unit;
+    uint8_t permissions;
+    float minValue;
+    float maxValue;
+    float minStep;
+    uint8_t flags;
+    char description[HKMETADATA_DESCRIPTION_SIZE - 1];
+};
+
+// Defaults from the HAP specification, by type
+static const CatalogEntry catalog[] PROGMEM = {
+    {HKCharacteristicBrightness, HKFormatInt, HKUnitPercentage, PR | PW | EV, 0, 100, 1, RANGE, "Brightness"},
+    {HKCharacteristicCoolingThreshold, HKFormatFloat, HKUnitCelsius, PR | PW | EV, 10, 35, 0.1, RANGE, "Cooling Threshold Temperature"},
+    {HKCharacteristicCurrentDoorState, HKFormatUInt8, HKUnitNone, PR | EV, 0, 4, 1, RANGE, "Current Door State"},
+    {HKCharacteristicCurrentHeatCoolMode, HKFormatUInt8, HKUnitNone, PR | EV, 0, 2, 1, RANGE, "Current Heating Cooling State"},
+    {HKCharacteristicCurrentHumidity, HKFormatFloat, HKUnitPercentage, PR | EV, 0, 100, 1, RANGE, "Current Relative Humidity"},
+    {HKCharacteristicCurrentTemperature, HKFormatFloat, HKUnitCelsius, PR | EV, 0, 100, 0.1, RANGE, "Current Temperature"},
+    {HKCharacteristicHeatingThreshold, HKFormatFloat, HKUnitCelsius, PR | PW | EV, 0, 25, 0.1, RANGE, "Heating Threshold Temperature"},
+    {HKCharacteristicHue, HKFormatFloat, HKUnitArcdegrees, PR | PW | EV, 0, 360, 1, RANGE, "Hue"},
+    {HKCharacteristicIdentify, HKFormatBool, HKUnitNone, PW, 0, 0, 0, 0, "Identify"},
+    {HKCharacteristicLockCurrentState, HKFormatUInt8, HKUnitNone, PR | EV, 0, 3, 1, RANGE, "Lock Current State"},
+    {HKCharacteristicLockTargetState, HKFormatUInt8, HKUnitNone, PR | PW | EV, 0, 1, 1, RANGE, "Lock Target State"},
+    {HKCharacteristicManufactuer, HKFormatString, HKUnitNone, PR, 0, 0, 0, 0, "Manufacturer"},
+    {HKCharacteristicModelName, HKFormatString, HKUnitNone, PR, 0, 0, 0, 0, "Model"},
+    {HKCharacteristicMotionDetect, HKFormatBool, HKUnitNone, PR | EV, 0, 0, 0, 0, "Motion Detected"},
+    {HKCharacteristicName, HKFormatString, HKUnitNone, PR, 0, 0, 0, 0, "Name"},
+    {HKCharacteristicObstruction, HKFormatBool, HKUnitNone, PR | EV, 0, 0, 0, 0, "Obstruction Detected"},
+    {HKCharacteristicOn, HKFormatBool, HKUnitNone, PR | PW | EV, 0, 0, 0, 0, "On"},
+    {HKCharacteristicOutletInUse, HKFormatBool, HKUnitNone, PR | EV, 0, 0, 0, 0, "Outlet In Use"},
+    {HKCharacteristicRotationDirection, HKFormatInt, HKUnitNone, PR | PW | EV, 0, 1, 1, RANGE, "Rotation Direction"},
+    {HKCharacteristicRotationSpeed, HKFormatFloat, HKUnitPercentage, PR | PW | EV, 0, 100, 1, RANGE, "Rotation Speed"},
+    {HKCharacteristicSaturation, HKFormatFloat, HKUnitPercentage, PR | PW | EV, 0, 100, 1, RANGE, "Saturation"},
+    {HKCharacteristicSerialNumber, HKFormatString, HKUnitNone, PR, 0, 0, 0, 0, "Serial Number"},
+    {HKCharacteristicTargetDoorState, HKFormatUInt8, HKUnitNone, PR | PW | EV, 0, 1, 1, RANGE, "Target Door State"},
+    {HKCharacteristicTargetHeatCoolMode, HKFormatUInt8, HKUnitNone, PR | PW | EV, 0, 3, 1, RANGE, "Target Heating Cooling State"},
+    {HKCharacteristicTargetHumidity, HKFormatFloat, HKUnitPercentage, PR | PW | EV, 0, 100, 1, RANGE, "Target Relative Humidity"},
+    {HKCharacteristicTargetTemperature, HKFormatFloat, HKUnitCelsius, PR | PW | EV, 10, 38, 0.1, RANGE, "Target Temperature"},
+    {HKCharacteristicTemperatureUnit, HKFormatUInt8, HKUnitNone, PR | PW | EV, 0, 1, 1, RANGE, "Temperature Display Units"},
+    {HKCharacteristicFirmwareRevision, HKFormatString, HKUnitNone, PR, 0, 0, 0, 0, "Firmware Revision"},
+    {HKCharacteristicHardwareRevision, HKFormatString, HKUnitNone, PR, 0, 0, 0, 0, "Hardware Revision"},
+    {HKCharacteristicAlarmCurrentState, HKFormatUInt8, HKUnitNone, PR | EV, 0, 4, 1, RANGE, "Security System Current State"},
+    {HKCharacteristicAlarmTargetState, HKFormatUInt8, HKUnitNone, PR | PW | EV, 0, 3, 1, RANGE, "Security System Target State"},
+    {HKCharacteristicBatteryLevel, HKFormatUInt8, HKUnitPercentage, PR | EV, 0, 100, 1, RANGE, "Battery Level"},
+    {HKCharacteristicCarbonMonoxideDetected, HKFormatUInt8, HKUnitNone, PR | EV, 0, 1, 1, RANGE, "Carbon Monoxide Detected"},
+    {HKCharacteristicContactSensorState, HKFormatUInt8, HKUnitNone, PR | EV, 0, 1, 1, RANGE, "Contact Sensor State"},
+    {HKCharacteristicCurrentAmbientLightLevel, HKFormatFloat, HKUnitLux, PR | EV, 0.0001, 100000, 0, HKMetadataMinValue | HKMetadataMaxValue, "Current Ambient Light Level"},
+    {HKCharacteristicCurrentHorizontalTiltAngle, HKFormatInt, HKUnitArcdegrees, PR | EV, -90, 90, 1, RANGE, "Current Horizontal Tilt Angle"},
+    {HKCharacteristicCurrentPosition, HKFormatUInt8, HKUnitPercentage, PR | EV, 0, 100, 1, RANGE, "Current Position"},
+    {HKCharacteristicCurrentVerticalTiltAngle, HKFormatInt, HKUnitArcdegrees, PR | EV, -90, 90, 1, RANGE, "Current Vertical Tilt Angle"},
+    {HKCharacteristicHoldPosition, HKFormatBool, HKUnitNone, PW, 0, 0, 0, 0, "Hold Position"},
+    {HKCharacteristicLeakDetected, HKFormatUInt8, HKUnitNone, PR | EV, 0, 1, 1, RANGE, "Leak Detected"},
+    {HKCharacteristicOccupancyDetected, HKFormatUInt8, HKUnitNone, PR | EV, 0, 1, 1, RANGE, "Occupancy Detected"},
+    {HKCharacteristicPositionState, HKFormatUInt8, HKUnitNone, PR | EV, 0, 2, 1, RANGE, "Position State"},
+    {HKCharacteristicProgrammableSwitchEvent, HKFormatUInt8, HKUnitNone, PR | EV, 0, 2, 1, RANGE, "Programmable Switch Event"},
+    {HKCharacteristicSensorActive, HKFormatBool, HKUnitNone, PR | EV, 0, 0, 0, 0, "Status Active"},
+    {HKCharacteristicSmokeDetected, HKFormatUInt8, HKUnitNone, PR | EV, 0, 1, 1, RANGE, "Smoke Detected"},
+    {HKCharacteristicSensorFault, HKFormatUInt8, HKUnitNone, PR | EV, 0, 1, 1, RANGE, "Status Fault"},
+    {HKCharacteristicSensorLowBattery, HKFormatUInt8, HKUnitNone, PR | EV, 0, 1, 1, RANGE, "Status Low Battery"},
+    {HKCharacteristicSensorTampered, HKFormatUInt8, HKUnitNone, PR | EV, 0, 1, 1, RANGE, "Status Tampered"},
+    {HKCharacteristicTargetHorizontalTiltAngle, HKFormatInt, HKUnitArcdegrees, PR | PW | EV, -90, 90, 1, RANGE, "Target Horizontal Tilt Angle"},
+    {HKCharacteristicTargetPosition, HKFormatUInt8, HKUnitPercentage, PR | PW | EV, 0, 100, 1, RANGE, "Target Position"},
+    {HKCharacteristicTargetVerticalTiltAngle, HKFormatInt, HKUnitArcdegrees, PR | PW | EV, -90, 90, 1, RANGE, "Target Vertical Tilt Angle"},
+    {HKCharacteristicSensorChargingState, HKFormatUInt8, HKUnitNone, PR | EV, 0, 2, 1, RANGE, "Charging State"},
+    {HKCharacteristicCarbonDioxideDetected, HKFormatUInt8, HKUnitNone, PR | EV, 0, 1, 1, RANGE, "Carbon Dioxide Detected"},
+    {HKCharacteristicAirQuality, HKFormatUInt8, HKUnitNone, PR | EV, 0, 5, 1, RANGE, "Air Quality"},
+};
+
+#undef PR
+#undef PW
+#undef EV
+#undef RANGE
+
+struct Record {
+    HKCharacteristicMetadata metadata;
+    uint16_t references;
+    Record *next;
+};
+
+static Record *records = nullptr;
+static char lookupDescription[HKMETADATA_DESCRIPTION_SIZE];
+
+/**
+ * @brief Compare two metadata records, fields that are not set are ignored
+ *
+ * @param a First record
+ * @param b Second record
+ * @return true Records describe the same characteristic
+ * @return false Records differ
+ */
+static bool equals(const HKCharacteristicMetadata &a, const HKCharacteristicMetadata &b) {
+    if (a.format != b.format || a.unit != b.unit || a.flags != b.flags) {
+        return false;
+    }
+    if ((a.has(HKMetadataMinValue) && a.minValue != b.minValue) ||
+        (a.has(HKMetadataMaxValue) && a.maxValue != b.maxValue) ||
+        (a.has(HKMetadataMinStep) && a.minStep != b.minStep) ||
+        (a.has(HKMetadataMaxLen) && a.maxLen != b.maxLen) ||
+        (a.has(HKMetadataMaxDataLen) && a.maxDataLen != b.maxDataLen)) {
+        return false;
+    }
+    if (strcmp(a.description ? a.description : "", b.description ? b.description : "") != 0) {
+        return false;
+    }
+
+    int validValuesCount = a.validValues.count > 0 ? a.validValues.count : 0;
+    if (validValuesCount != (b.validValues.count > 0 ? b.validValues.count : 0) ||
+        (validValuesCount && memcmp(a.validValues.values, b.validValues.values, validValuesCount) != 0)) {
+        return false;
+    }
+    int rangesCount = a.validValuesRanges.count > 0 ? a.validValuesRanges.count : 0;
+    return rangesCount == (b.validValuesRanges.count > 0 ? b.validValuesRanges.count : 0) &&
+           (!rangesCount || memcmp(a.validValuesRanges.ranges, b.validValuesRanges.ranges, rangesCount * sizeof(HKValidValuesRange)) == 0);
+}
+
+/**
+ * @brief Look up the default metadata of a characteristic type in the catalog
+ *
+ * The description points to a buffer that is overwritten by the next lookup, pass the
+ * record to acquire() before that.
+ *
+ * @param type Characteristic type
+ * @param metadata Filled with the defaults
+ * @param permissions Filled with the default permissions
+ * @return true Type is in the catalog
+ * @return false Unknown type, metadata and permissions are unchanged
+ */
+bool HKMetadata::lookup(HKCharacteristicType type, HKCharacteristicMetadata &metadata, uint8_t &permissions) {
+    for (size_t i = 0; i < sizeof(catalog) / sizeof(catalog[0]); i++) {
+        if (pgm_read_byte(&catalog[i].type) != type) {
+            continue;
+        }
+
+        CatalogEntry entry;
+        memcpy_P(&entry, &catalog[i], sizeof(entry));
+        memcpy(lookupDescription, entry.description, sizeof(entry.description));
+        lookupDescription[sizeof(entry.description)] = '\0';
+
+        metadata = HKCharacteristicMetadata();
+        metadata.format = (HKFormat) entry.format;
+        metadata.unit = (HKUnit) entry.unit;
+        metadata.flags = entry.flags;
+        metadata.minValue = entry.minValue;
+        metadata.maxValue = entry.maxValue;
+        metadata.minStep = entry.minStep;
+        metadata.description = lookupDescription;
+        permissions = entry.permissions;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Get the shared record for the given metadata, a new one is only allocated if no identical record is in use
+ *
+ * Every acquire() has to be paired with a release().
+ *
+ * @param metadata Metadata to intern, the description is copied
+ * @return const HKCharacteristicMetadata* Shared record
+ */
+const HKCharacteristicMetadata *HKMetadata::acquire(const HKCharacteristicMetadata &metadata) {
+    for (Record *record = records; record; record = record->next) {
+        if (equals(record->metadata, metadata)) {
+            record->references++;
+            return &record->metadata;
+        }
+    }
+
+    Record *record = new Record();
+    record->metadata = metadata;
+    record->metadata.description = strdup(metadata.description ? metadata.description : "");
+    record->references = 1;
+    record->next = records;
+    records = record;
+    HKLOGDEBUG("[HKMetadata::acquire] New metadata record (description=%s)\r\n", record->metadata.description);
+    return &record->metadata;
+}
+
+/**
+ * @brief Drop a reference to a shared record, the record is freed with its last reference
+ *
+ * @param metadata Record returned by acquire()
+ */
+void HKMetadata::release(const HKCharacteristicMetadata *metadata) {
+    for (Record **link = &records; *link; link = &(*link)->next) {
+        Record *record = *link;
+        if (&record->metadata != metadata) {
+            continue;
+        }
+
+        if (--record->references == 0) {
+            *link = record->next;
+            free((void *) record->metadata.description);
+            delete record;
+        }
+        return;
+    }
+}
@@ -0,0 +1,68 @@
+/**
+ * @file HKMetadata.h
+ * @brief Shared characteristic metadata
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2020
+ *
+ * Characteristics of the same type nearly always describe themselves the same way, so format, unit,
+ * ranges and description are not stored per characteristic. The catalog holds the HAP defaults of
+ * the common types in flash, HKMetadata::acquire() interns every record in use. Identical records
+ * are shared and reference counted, a characteristic only gets a record of its own if it overrides
+ * something.
+ */
+
+#ifndef HAP_SERVER_HKMETADATA_H
+#define HAP_SERVER_HKMETADATA_H
+
+#include <Arduino.h>
+#include "HKDefinitions.h"
+#include "HKDebug.h"
+
+struct HKValidValues {
+    int count;
+    uint8_t *values;
+};
+
+struct HKValidValuesRange {
+    uint8_t start;
+    uint8_t end;
+};
+
+struct HKValidValuesRanges {
+    int count;
+    HKValidValuesRange *ranges;
+};
+
+enum HKMetadataFlag {
+    HKMetadataMinValue = 1,
+    HKMetadataMaxValue = 2,
+    HKMetadataMinStep = 4,
+    HKMetadataMaxLen = 8,
+    HKMetadataMaxDataLen = 16
+};
+
+struct HKCharacteristicMetadata {
+    HKFormat format;
+    HKUnit unit;
+    uint8_t flags;          // HKMetadataFlag, which of the optional fields are set
+    float minValue;
+    float maxValue;
+    float minStep;
+    uint maxLen;
+    uint maxDataLen;
+    const char *description;
+    HKValidValues validValues;          // arrays are owned by the caller and have to outlive the characteristic
+    HKValidValuesRanges validValuesRanges;
+
+    inline bool has(HKMetadataFlag flag) const { return flags & flag; };
+};
+
+namespace HKMetadata {
+    bool lookup(HKCharacteristicType type, HKCharacteristicMetadata &metadata, uint8_t &permissions);
+    const HKCharacteristicMetadata *acquire(const HKCharacteristicMetadata &metadata);
+    void release(const HKCharacteristicMetadata *metadata);
+}
+
+#endif //HAP_SERVER_HKMETADATA_H
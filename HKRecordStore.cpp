@@ -0,0 +1,577 @@
+/**
+ * @file HKRecordStore.cpp
+ * @brief Append-only key/value record store on raw flash sectors
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+
+#include "HKRecordStore.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#endif
+
+#define HKSTORE_MAGIC       0x31534B48      // "HKS1"
+#define HKSTORE_NO_LOCATION 0xFFFFFFFF
+#define HKSTORE_CHUNK       64              // multiple of 4, keeps flash writes aligned
+
+static uint32_t recordLength(uint32_t size) {
+    return (8 + size + 3) & ~3u;
+}
+
+static uint32_t crc32Update(uint32_t crc, const uint8_t *data, size_t size) {
+    crc = ~crc;
+    while (size--) {
+        crc ^= *data++;
+        for (uint8_t k = 0; k < 8; k++) {
+            crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+        }
+    }
+    return ~crc;
+}
+
+#ifdef ARDUINO
+
+/**
+ * @brief SPI flash backend
+ *
+ * @param firstSector Absolute number of the first of the HKSTORE_SECTORS flash sectors. 0 disables the
+ * backend, every access fails instead of touching the boot loader.
+ */
+HKSPIFlash::HKSPIFlash(uint32_t firstSector) : firstSector(firstSector) {
+}
+
+/**
+ * @brief Read from flash. The SDK only reads to aligned buffers, so everything goes through a bounce buffer.
+ *
+ * @param sector Sector relative to the first store sector
+ * @param offset Offset in sector
+ * @param data Target
+ * @param size Bytes to read
+ * @return true Read
+ * @return false Flash error
+ */
+bool HKSPIFlash::read(uint8_t sector, uint16_t offset, void *data, size_t size) {
+    if (!firstSector) {
+        return false;
+    }
+    uint32_t buffer[HKSTORE_CHUNK / 4];
+    uint32_t address = (firstSector + sector) * HKSTORE_SECTOR_SIZE + offset;
+    uint8_t *target = (uint8_t *) data;
+    while (size > 0) {
+        uint8_t skip = address & 3;
+        size_t chunk = size < sizeof(buffer) - skip ? size : sizeof(buffer) - skip;
+        if (!ESP.flashRead(address - skip, buffer, (skip + chunk + 3) & ~3u)) {
+            return false;
+        }
+        memcpy(target, (uint8_t *) buffer + skip, chunk);
+        target += chunk;
+        address += chunk;
+        size -= chunk;
+    }
+    return true;
+}
+
+/**
+ * @brief Write to flash at a 4 byte aligned offset. A trailing partial word is padded with 0xFF.
+ *
+ * @param sector Sector relative to the first store sector
+ * @param offset Offset in sector, multiple of 4
+ * @param data Source
+ * @param size Bytes to write
+ * @return true Written
+ * @return false Flash error or unaligned offset
+ */
+bool HKSPIFlash::write(uint8_t sector, uint16_t offset, const void *data, size_t size) {
+    if (!firstSector) {
+        return false;
+    }
+    if (offset & 3) {
+        return false;
+    }
+    uint32_t buffer[HKSTORE_CHUNK / 4];
+    uint32_t address = (firstSector + sector) * HKSTORE_SECTOR_SIZE + offset;
+    const uint8_t *source = (const uint8_t *) data;
+    while (size > 0) {
+        size_t chunk = size < sizeof(buffer) ? size : sizeof(buffer);
+        size_t length = (chunk + 3) & ~3u;
+        memset((uint8_t *) buffer + length - 4, 0xFF, 4);
+        memcpy(buffer, source, chunk);
+        if (!ESP.flashWrite(address, buffer, length)) {
+            return false;
+        }
+        source += chunk;
+        address += length;
+        size -= chunk;
+    }
+    return true;
+}
+
+/**
+ * @brief Erase a sector
+ *
+ * @param sector Sector relative to the first store sector
+ * @return true Erased
+ * @return false Flash error
+ */
+bool HKSPIFlash::erase(uint8_t sector) {
+    return firstSector && ESP.flashEraseSector(firstSector + sector);
+}
+
+#else
+
+/**
+ * @brief File backend emulating NOR flash for host builds. Writes can only clear bits, like the real flash.
+ *
+ * @param path File to use, created and erased if it does not exist
+ */
+HKFileFlash::HKFileFlash(const char *path) {
+    file = fopen(path, "r+b");
+    if (!file) {
+        file = fopen(path, "w+b");
+        for (uint8_t i = 0; file && i < HKSTORE_SECTORS; i++) {
+            erase(i);
+        }
+    }
+}
+
+HKFileFlash::~HKFileFlash() {
+    if (file) {
+        fclose(file);
+    }
+}
+
+bool HKFileFlash::read(uint8_t sector, uint16_t offset, void *data, size_t size) {
+    if (!file || fseek(file, (long) sector * HKSTORE_SECTOR_SIZE + offset, SEEK_SET) != 0) {
+        return false;
+    }
+    return fread(data, 1, size, file) == size;
+}
+
+bool HKFileFlash::write(uint8_t sector, uint16_t offset, const void *data, size_t size) {
+    uint8_t buffer[HKSTORE_CHUNK];
+    const uint8_t *source = (const uint8_t *) data;
+    while (size > 0) {
+        size_t chunk = size < sizeof(buffer) ? size : sizeof(buffer);
+        if (!read(sector, offset, buffer, chunk)) {
+            return false;
+        }
+        for (size_t i = 0; i < chunk; i++) {
+            buffer[i] &= source[i];
+        }
+        if (fseek(file, (long) sector * HKSTORE_SECTOR_SIZE + offset, SEEK_SET) != 0 || fwrite(buffer, 1, chunk, file) != chunk) {
+            return false;
+        }
+        source += chunk;
+        offset += chunk;
+        size -= chunk;
+    }
+    return fflush(file) == 0;
+}
+
+bool HKFileFlash::erase(uint8_t sector) {
+    uint8_t buffer[HKSTORE_CHUNK];
+    memset(buffer, 0xFF, sizeof(buffer));
+    if (!file || fseek(file, (long) sector * HKSTORE_SECTOR_SIZE, SEEK_SET) != 0) {
+        return false;
+    }
+    for (size_t i = 0; i < HKSTORE_SECTOR_SIZE; i += sizeof(buffer)) {
+        if (fwrite(buffer, 1, sizeof(buffer), file) != sizeof(buffer)) {
+            return false;
+        }
+    }
+    return fflush(file) == 0;
+}
+
+#endif
+
+/**
+ * @brief Construct a new HKRecordStore. Call begin() before use.
+ *
+ * @param flash Flash backend with HKSTORE_SECTORS sectors
+ */
+HKRecordStore::HKRecordStore(HKFlash *flash) : flash(flash), sequence{}, erased(0), head(0), headOffset(HKSTORE_SECTOR_SIZE), location{}, stats{} {
+    memset(location, 0xFF, sizeof(location));
+}
+
+/**
+ * @brief Find the log in flash and rebuild the key index. Formats the sectors if no log exists.
+ *
+ * @return true Store ready
+ * @return false Flash error
+ */
+bool HKRecordStore::begin() {
+    memset(location, 0xFF, sizeof(location));
+    stats.replayedRecords = 0;
+    erased = 0;
+
+    bool found = false;
+    for (uint8_t i = 0; i < HKSTORE_SECTORS; i++) {
+        SectorHeader header{};
+        if (!flash->read(i, 0, &header, sizeof(header))) {
+            return false;
+        }
+        bool valid = header.magic == HKSTORE_MAGIC && header.check == ~header.sequence && header.sequence != 0 && header.retired == 0xFFFFFFFF;
+        sequence[i] = valid ? header.sequence : 0;
+        if (sequence[i] && (!found || sequence[i] > sequence[head])) {
+            head = i;
+            found = true;
+        }
+    }
+    if (!found) {
+        return format();
+    }
+
+    // Replay oldest to newest so later records win
+    uint32_t last = 0;
+    for (uint8_t n = 0; n < HKSTORE_SECTORS; n++) {
+        int next = -1;
+        for (uint8_t i = 0; i < HKSTORE_SECTORS; i++) {
+            if (sequence[i] > last && (next == -1 || sequence[i] < sequence[next])) {
+                next = i;
+            }
+        }
+        if (next == -1) {
+            break;
+        }
+        replay(next);
+        last = sequence[next];
+    }
+
+    // The sector after the head is only in use if a compaction was interrupted. Until the
+    // compaction erases it the head holds nothing but copies of its records, so if the copies
+    // were torn the head is dropped and the compaction starts over.
+    uint8_t tail = (head + 1) % HKSTORE_SECTORS;
+    if (HKSTORE_SECTORS > 1 && sequence[tail] && !reclaim(tail)) {
+        if (!retireSector(head)) {
+            return false;
+        }
+        return begin();
+    }
+    return true;
+}
+
+/**
+ * @brief Erase all sectors and start an empty log
+ *
+ * @return true Formatted
+ * @return false Flash error
+ */
+bool HKRecordStore::format() {
+    memset(location, 0xFF, sizeof(location));
+    for (uint8_t i = 0; i < HKSTORE_SECTORS; i++) {
+        if (!eraseSector(i)) {
+            return false;
+        }
+    }
+
+    SectorHeader header = { HKSTORE_MAGIC, 1, ~1u, 0xFFFFFFFF };
+    if (!flash->write(0, 0, &header, sizeof(header))) {
+        return false;
+    }
+    stats.flashBytes += sizeof(header);
+    sequence[0] = header.sequence;
+    erased &= ~1;
+    head = 0;
+    headOffset = sizeof(header);
+    return true;
+}
+
+/**
+ * @brief Read the current value of a key
+ *
+ * @param key Key
+ * @param data Target, may be nullptr to query the size
+ * @param size Size of target, larger values are truncated
+ * @return int Size of the stored value, -1 if the key is not set
+ */
+int HKRecordStore::get(uint16_t key, void *data, size_t size) {
+    if (key >= HKSTORE_MAX_KEYS || location[key] == HKSTORE_NO_LOCATION) {
+        return -1;
+    }
+
+    uint8_t sector = location[key] >> 16;
+    uint16_t offset = location[key] & 0xFFFF;
+    RecordHeader header{};
+    if (!flash->read(sector, offset, &header, sizeof(header))) {
+        return -1;
+    }
+    if (data && size > 0 && !flash->read(sector, offset + sizeof(header), data, size < header.size ? size : header.size)) {
+        return -1;
+    }
+    return header.size;
+}
+
+/**
+ * @brief Atomically replace the value of a key
+ *
+ * @param key Key, below HKSTORE_MAX_KEYS
+ * @param data Value
+ * @param size Size of value, at least 1 byte
+ * @return true Stored
+ * @return false Store full or flash error
+ */
+bool HKRecordStore::put(uint16_t key, const void *data, size_t size) {
+    if (key >= HKSTORE_MAX_KEYS || size == 0 || size > 0xFFFF) {
+        return false;
+    }
+    stats.payloadBytes += size;
+    return append(key, data, size);
+}
+
+/**
+ * @brief Remove a key
+ *
+ * @param key Key
+ * @return true Removed or not set
+ * @return false Store full or flash error
+ */
+bool HKRecordStore::remove(uint16_t key) {
+    if (key >= HKSTORE_MAX_KEYS) {
+        return false;
+    }
+    if (location[key] == HKSTORE_NO_LOCATION) {
+        return true;
+    }
+    return append(key, nullptr, 0);
+}
+
+/**
+ * @brief Is the key set
+ *
+ * @param key Key
+ * @return true Key has a value
+ * @return false Key not set
+ */
+bool HKRecordStore::contains(uint16_t key) const {
+    return key < HKSTORE_MAX_KEYS && location[key] != HKSTORE_NO_LOCATION;
+}
+
+/**
+ * @brief Counters for measuring write amplification and replay
+ *
+ * @return const HKRecordStore::Stats& Statistics since construction
+ */
+const HKRecordStore::Stats &HKRecordStore::getStats() const {
+    return stats;
+}
+
+bool HKRecordStore::replay(uint8_t sector) {
+    uint32_t offset = sizeof(SectorHeader);
+    while (offset + sizeof(RecordHeader) <= HKSTORE_SECTOR_SIZE) {
+        RecordHeader header{};
+        if (!flash->read(sector, offset, &header, sizeof(header))) {
+            return false;
+        }
+        if (header.key == 0xFFFF && header.size == 0xFFFF && header.crc == 0xFFFFFFFF) {
+            break;
+        }
+
+        uint32_t length = recordLength(header.size);
+        if (header.key >= HKSTORE_MAX_KEYS || offset + length > HKSTORE_SECTOR_SIZE) {
+            // Torn header: the record length is unknown, so nothing may be appended to this sector
+            offset = HKSTORE_SECTOR_SIZE;
+            break;
+        }
+
+        // Torn payload: skip the record and keep the previous value of the key
+        if (recordCRC(header, nullptr, sector, offset + sizeof(header)) == header.crc) {
+            location[header.key] = header.size ? ((uint32_t) sector << 16 | offset) : HKSTORE_NO_LOCATION;
+            stats.replayedRecords++;
+        }
+        offset += length;
+    }
+
+    if (sector == head) {
+        headOffset = offset;
+    }
+    return true;
+}
+
+bool HKRecordStore::append(uint16_t key, const void *data, size_t size) {
+    uint32_t length = recordLength(size);
+    if (length > HKSTORE_SECTOR_SIZE - sizeof(SectorHeader)) {
+        return false;
+    }
+    for (uint8_t tries = 0; headOffset + length > HKSTORE_SECTOR_SIZE; tries++) {
+        if (tries == HKSTORE_SECTORS || !advance()) {
+            return false;
+        }
+    }
+    return writeRecord(key, data, 0, 0, size);
+}
+
+bool HKRecordStore::advance() {
+    if (HKSTORE_SECTORS == 1) {
+        return compact();
+    }
+
+    uint8_t next = (head + 1) % HKSTORE_SECTORS;
+    if (sequence[next] && !reclaim(next)) {
+        return false;
+    }
+    if (!(erased & (1 << next)) && !eraseSector(next)) {
+        return false;
+    }
+
+    SectorHeader header = { HKSTORE_MAGIC, sequence[head] + 1, ~(sequence[head] + 1), 0xFFFFFFFF };
+    if (!flash->write(next, 0, &header, sizeof(header))) {
+        return false;
+    }
+    stats.flashBytes += sizeof(header);
+    sequence[next] = header.sequence;
+    erased &= ~(1 << next);
+    head = next;
+    headOffset = sizeof(header);
+
+    // Keep the sector after the head erased by compacting the oldest one
+    uint8_t tail = (head + 1) % HKSTORE_SECTORS;
+    if (sequence[tail]) {
+        return reclaim(tail);
+    }
+    return true;
+}
+
+/**
+ * Single sector mode: copies the newest record of every key to RAM, erases the
+ * sector and writes them back behind a new sector header.
+ */
+bool HKRecordStore::compact() {
+    auto buffer = (uint8_t *) malloc(HKSTORE_SECTOR_SIZE - sizeof(SectorHeader));
+    if (!buffer) {
+        return false;
+    }
+
+    uint32_t size = 0;
+    uint32_t newLocation[HKSTORE_MAX_KEYS];
+    for (uint16_t key = 0; key < HKSTORE_MAX_KEYS; key++) {
+        newLocation[key] = HKSTORE_NO_LOCATION;
+        if (location[key] == HKSTORE_NO_LOCATION) {
+            continue;
+        }
+        uint16_t offset = location[key] & 0xFFFF;
+        RecordHeader header{};
+        if (!flash->read(head, offset, &header, sizeof(header)) ||
+            !flash->read(head, offset, buffer + size, recordLength(header.size))) {
+            free(buffer);
+            return false;
+        }
+        newLocation[key] = (uint32_t) head << 16 | (sizeof(SectorHeader) + size);
+        size += recordLength(header.size);
+    }
+
+    uint32_t next = sequence[head] + 1;
+    SectorHeader header = { HKSTORE_MAGIC, next, ~next, 0xFFFFFFFF };
+    bool success = eraseSector(head) &&
+                   flash->write(head, sizeof(header), buffer, size) &&
+                   flash->write(head, 0, &header, sizeof(header));
+    free(buffer);
+    if (!success) {
+        return false;
+    }
+
+    memcpy(location, newLocation, sizeof(location));
+    stats.flashBytes += sizeof(header) + size;
+    sequence[head] = next;
+    erased &= ~(1 << head);
+    headOffset = sizeof(header) + size;
+    return true;
+}
+
+bool HKRecordStore::reclaim(uint8_t sector) {
+    if (sector == head) {
+        return false;
+    }
+    for (uint16_t key = 0; key < HKSTORE_MAX_KEYS; key++) {
+        if (location[key] == HKSTORE_NO_LOCATION || (location[key] >> 16) != sector) {
+            continue;
+        }
+        uint16_t offset = location[key] & 0xFFFF;
+        RecordHeader header{};
+        if (!flash->read(sector, offset, &header, sizeof(header))) {
+            return false;
+        }
+        if (headOffset + recordLength(header.size) > HKSTORE_SECTOR_SIZE) {
+            return false;
+        }
+        if (!writeRecord(key, nullptr, sector, offset + sizeof(header), header.size)) {
+            return false;
+        }
+    }
+    return retireSector(sector);
+}
+
+bool HKRecordStore::retireSector(uint8_t sector) {
+    uint32_t retired = 0;
+    if (!flash->write(sector, offsetof(SectorHeader, retired), &retired, sizeof(retired))) {
+        return false;
+    }
+    return eraseSector(sector);
+}
+
+bool HKRecordStore::eraseSector(uint8_t sector) {
+    if (!flash->erase(sector)) {
+        return false;
+    }
+    stats.sectorErases++;
+    sequence[sector] = 0;
+    erased |= 1 << sector;
+    return true;
+}
+
+/**
+ * Writes one record at the head. The payload comes from data, or is copied from
+ * another sector if data is nullptr. Only the CRC makes the record valid, so a
+ * torn write never replaces the previous value.
+ */
+bool HKRecordStore::writeRecord(uint16_t key, const void *data, uint8_t fromSector, uint16_t fromOffset, size_t size) {
+    RecordHeader header = { key, (uint16_t) size, 0 };
+    header.crc = recordCRC(header, data, fromSector, fromOffset);
+    if (!flash->write(head, headOffset, &header, sizeof(header))) {
+        return false;
+    }
+
+    uint16_t offset = headOffset + sizeof(header);
+    if (data) {
+        if (size > 0 && !flash->write(head, offset, data, size)) {
+            return false;
+        }
+    } else {
+        uint8_t buffer[HKSTORE_CHUNK];
+        for (size_t done = 0; done < size; done += sizeof(buffer)) {
+            size_t chunk = size - done < sizeof(buffer) ? size - done : sizeof(buffer);
+            if (!flash->read(fromSector, fromOffset + done, buffer, chunk) || !flash->write(head, offset + done, buffer, chunk)) {
+                return false;
+            }
+        }
+    }
+
+    location[key] = size ? ((uint32_t) head << 16 | headOffset) : HKSTORE_NO_LOCATION;
+    headOffset += recordLength(size);
+    stats.flashBytes += recordLength(size);
+    return true;
+}
+
+uint32_t HKRecordStore::recordCRC(const RecordHeader &header, const void *data, uint8_t fromSector, uint16_t fromOffset) {
+    uint8_t prefix[4] = { (uint8_t) header.key, (uint8_t) (header.key >> 8), (uint8_t) header.size, (uint8_t) (header.size >> 8) };
+    uint32_t crc = crc32Update(0, prefix, sizeof(prefix));
+    if (data) {
+        return crc32Update(crc, (const uint8_t *) data, header.size);
+    }
+
+    uint8_t buffer[HKSTORE_CHUNK];
+    for (size_t done = 0; done < header.size; done += sizeof(buffer)) {
+        size_t chunk = header.size - done < sizeof(buffer) ? header.size - done : sizeof(buffer);
+        if (!flash->read(fromSector, fromOffset + done, buffer, chunk)) {
+            return ~header.crc;
+        }
+        crc = crc32Update(crc, buffer, chunk);
+    }
+    return crc;
+}
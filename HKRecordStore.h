@@ -0,0 +1,141 @@
+/**
+ * @file HKRecordStore.h
+ * @brief Append-only key/value record store on raw flash sectors
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2020
+ *
+ * The store is a log spread over HKSTORE_SECTORS flash sectors used as a ring.
+ * Every put() appends a CRC protected record to the head sector, so a value is
+ * replaced atomically: a torn write fails its CRC on the next boot and the
+ * previous record stays valid. When the head is full the log moves on to the
+ * next sector, which is always kept erased, and the oldest sector is compacted
+ * by copying its still current records to the new head before erasing it.
+ *
+ * Sector:  [SectorHeader][RecordHeader|data|pad][RecordHeader|data|pad]...[0xFF...]
+ *
+ * Before a compacted sector is erased its header is marked retired, so an
+ * interrupted erase cannot bring back records that were removed meanwhile.
+ *
+ * With a single sector there is no sector to compact into. The current records
+ * are collected in RAM and written back after the erase, so a power cut during
+ * that compaction loses the store, like a commit of the EEPROM library did.
+ *
+ * A record with size 0 removes its key. The location of the newest record of
+ * every key is kept in RAM and rebuilt on begin() by replaying the sectors in
+ * sequence order.
+ *
+ * The store only depends on the HKFlash interface. On the ESP8266 HKSPIFlash
+ * talks to the SPI flash, on Linux HKFileFlash emulates NOR flash in a file
+ * and the Stats can be used to measure write amplification and replay time.
+ */
+
+#ifndef HAP_SERVER_HKRECORDSTORE_H
+#define HAP_SERVER_HKRECORDSTORE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#ifndef HKSTORE_SECTORS
+#ifdef HKSTORE_FLASH_SECTOR
+#define HKSTORE_SECTORS     2
+#else
+// Only the EEPROM sector is reserved for the store by default
+#define HKSTORE_SECTORS     1
+#endif
+#endif
+
+#define HKSTORE_SECTOR_SIZE 4096
+#define HKSTORE_MAX_KEYS    32
+
+#if HKSTORE_SECTORS < 1 || HKSTORE_SECTORS > 8
+#error "HKSTORE_SECTORS must be between 1 and 8"
+#endif
+
+class HKFlash {
+public:
+    virtual ~HKFlash() = default;
+    virtual bool read(uint8_t sector, uint16_t offset, void *data, size_t size) = 0;
+    virtual bool write(uint8_t sector, uint16_t offset, const void *data, size_t size) = 0;
+    virtual bool erase(uint8_t sector) = 0;
+};
+
+#ifdef ARDUINO
+class HKSPIFlash : public HKFlash {
+public:
+    explicit HKSPIFlash(uint32_t firstSector);
+    bool read(uint8_t sector, uint16_t offset, void *data, size_t size) override;
+    bool write(uint8_t sector, uint16_t offset, const void *data, size_t size) override;
+    bool erase(uint8_t sector) override;
+private:
+    uint32_t firstSector;
+};
+#else
+class HKFileFlash : public HKFlash {
+public:
+    explicit HKFileFlash(const char *path);
+    ~HKFileFlash() override;
+    bool read(uint8_t sector, uint16_t offset, void *data, size_t size) override;
+    bool write(uint8_t sector, uint16_t offset, const void *data, size_t size) override;
+    bool erase(uint8_t sector) override;
+private:
+    FILE *file;
+};
+#endif
+
+class HKRecordStore {
+public:
+    struct Stats {
+        uint32_t payloadBytes;      // bytes passed to put()
+        uint32_t flashBytes;        // bytes written to flash, including headers, padding and compaction
+        uint32_t sectorErases;
+        uint16_t replayedRecords;   // valid records read by the last begin()
+    };
+
+    explicit HKRecordStore(HKFlash *flash);
+
+    bool begin();
+    bool format();
+
+    int get(uint16_t key, void *data, size_t size);
+    bool put(uint16_t key, const void *data, size_t size);
+    bool remove(uint16_t key);
+    bool contains(uint16_t key) const;
+
+    const Stats &getStats() const;
+private:
+    struct SectorHeader {
+        uint32_t magic;
+        uint32_t sequence;
+        uint32_t check;     // ~sequence, catches half erased headers
+        uint32_t retired;   // cleared before the sector is erased
+    };
+
+    struct RecordHeader {
+        uint16_t key;
+        uint16_t size;
+        uint32_t crc;
+    };
+
+    HKFlash *flash;
+    uint32_t sequence[HKSTORE_SECTORS];     // 0 if the sector holds no log data
+    uint8_t erased;                         // bit n set if sector n is known to be erased
+    uint8_t head;
+    uint16_t headOffset;
+    uint32_t location[HKSTORE_MAX_KEYS];    // sector << 16 | offset of the newest record
+    Stats stats;
+
+    bool replay(uint8_t sector);
+    bool append(uint16_t key, const void *data, size_t size);
+    bool advance();
+    bool compact();
+    bool reclaim(uint8_t sector);
+    bool retireSector(uint8_t sector);
+    bool eraseSector(uint8_t sector);
+    bool writeRecord(uint16_t key, const void *data, uint8_t fromSector, uint16_t fromOffset, size_t size);
+    uint32_t recordCRC(const RecordHeader &header, const void *data, uint8_t fromSector, uint16_t fromOffset);
+};
+
+#endif //HAP_SERVER_HKRECORDSTORE_H
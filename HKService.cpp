@@ -10,6 +10,7 @@
  */
 
 #include "HKService.h"
+#include "HKFragments.h"
 
 /**
  * @brief Construct a new HKService::HKService object
@@ -33,7 +34,7 @@ HKService::HKService(HKServiceType type, bool hidden, bool primary, String name)
 void HKService::setName(String name) {
     HKCharacteristic *nameChar = getCharacteristic(HKCharacteristicName);
     if (nameChar == nullptr) {
-        nameChar = new HKCharacteristic(HKCharacteristicName, HKValue(HKFormatString, name), HKPermissionPairedRead, "Name", HKFormatString);
+        nameChar = new HKCharacteristic(HKCharacteristicName, HKValue(HKFormatString, name));
         addCharacteristic(nameChar);
     } else {
         nameChar->notify(HKValue(HKFormatString, name));
@@ -88,6 +89,16 @@ std::vector<HKCharacteristic *> HKService::getCharacteristics() {
     return characteristics;
 }
 
+/**
+ * @brief Set function to call once after a write request changed characteristics of this service
+ * The setters of the characteristics are called first, so e.g. a light can apply hue, saturation and brightness at once
+ * 
+ * @param commitCallback Function, gets the changed characteristics of this service
+ */
+void HKService::setCommitCallback(const std::function<void(const std::vector<HKCharacteristic *> &)> &commitCallback) {
+    HKService::commitCallback = commitCallback;
+}
+
 /**
  * @brief Get the service type
  * 
@@ -105,22 +116,16 @@ HKServiceType HKService::getServiceType() const {
  * @param client 
  */
 void HKService::serializeToJSON(JSON &json, HKValue *value, HKClient *client) {
-    json.setString("iid");
+    json.setKey("iid");
     json.setInt(id);
 
-    json.setString("type");
-    String typeConv = String(serviceType, HEX);
-    typeConv.toUpperCase();
-    json.setString(typeConv.c_str());
-
-    json.setString("hidden");
-    json.setBool(hidden);
+    json.setKey("type");
+    json.setHexString(serviceType);
 
-    json.setString("primary");
-    json.setBool(primary);
+    json.setFragment_P(HKFragmentServiceFlags[hidden | primary << 1]);
 
     if (!linkedServices.empty()) {
-        json.setString("linkedServices");
+        json.setKey("linkedServices");
         json.startArray();
 
         for (auto link : linkedServices) {
@@ -130,7 +135,7 @@ void HKService::serializeToJSON(JSON &json, HKValue *value, HKClient *client) {
         json.endArray();
     }
 
-    json.setString("characteristics");
+    json.setKey("characteristics");
     json.startArray();
 
     for (auto characteristic : characteristics) {
@@ -40,6 +40,7 @@ public:
     HKAccessory *getAccessory();
     HKCharacteristic *getCharacteristic(HKCharacteristicType characteristicType);
     std::vector<HKCharacteristic *> getCharacteristics();
+    void setCommitCallback(const std::function<void(const std::vector<HKCharacteristic *> &)> &commitCallback);
 private:
     HKCharacteristic *findCharacteristic(uint iid);
     void serializeToJSON(JSON &json, HKValue *value, HKClient *client);
@@ -54,6 +55,7 @@ private:
     bool primary;
     std::vector<HKService *> linkedServices;
     std::vector<HKCharacteristic *> characteristics;
+    std::function<void(const std::vector<HKCharacteristic *> &)> commitCallback;
 };
 
 
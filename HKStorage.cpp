@@ -4,46 +4,171 @@
 
 #include "HKStorage.h"
 
+#include <EEPROM.h>
+
+#ifndef HKSTORE_FLASH_SECTOR
+#if HKSTORE_SECTORS > 1
+#error "Only the EEPROM sector is reserved for the store, define HKSTORE_FLASH_SECTOR to use more than one sector"
+#endif
+extern "C" uint32_t _EEPROM_start;
+#endif
+
+static HKStorage::PairingTable pairingTable{};
+static bool legacyEEPROM = false;   // EEPROM holds a copy of the old layout in RAM
+
 // Helper Functions
-int findEmptyBlock() {
-    unsigned char pairingData[3];
+/**
+ * @brief First flash sector of the store
+ *
+ * Without HKSTORE_FLASH_SECTOR the store takes over the EEPROM sector, which the old EEPROM layout used and
+ * no file system or sketch update touches.
+ *
+ * @return uint32_t Absolute sector number
+ */
+uint32_t storeSector() {
+#ifdef HKSTORE_FLASH_SECTOR
+    return HKSTORE_FLASH_SECTOR;
+#else
+    return ((uint32_t) &_EEPROM_start - 0x40200000) / HKSTORE_SECTOR_SIZE;
+#endif
+}
+
+/**
+ * @brief Keep a copy of the old EEPROM layout in RAM if the EEPROM sector holds one
+ *
+ * Runs before the store is opened, with the default location the store formats the same sector.
+ */
+void readLegacyEEPROM() {
     EEPROM.begin(4096);
+    char check[STORAGE_CHECK_LEN];
+    for (uint8_t i = 0; i < STORAGE_CHECK_LEN; i++) {
+        check[i] = EEPROM.read(STORAGE_CHECK_ADDR + i);
+    }
+    legacyEEPROM = strncmp(check, STORAGE_CHECK, STORAGE_CHECK_LEN) == 0;
+    if (!legacyEEPROM) {
+        EEPROM.end();
+    }
+}
+
+void endLegacyEEPROM() {
+    if (legacyEEPROM) {
+        EEPROM.end();
+        legacyEEPROM = false;
+    }
+}
+
+/**
+ * @brief Construct the store and replay it, called once on first use
+ *
+ * Flash and store are only constructed here, so HKStorage can be used from constructors of other globals.
+ *
+ * @return HKRecordStore& Store
+ */
+HKRecordStore &openStore() {
+    static HKSPIFlash flash(storeSector());
+    static HKRecordStore store(&flash);
+    readLegacyEEPROM();
+    if (!store.begin()) {
+        HKLOGERROR("[HKStorage::openStore] Could not read record store\r\n");
+    }
+    HKLOGDEBUG("[HKStorage::openStore] Replayed %u records\r\n", store.getStats().replayedRecords);
+    return store;
+}
+
+HKRecordStore &getStore() {
+    static HKRecordStore &store = openStore();
+    return store;
+}
+
+uint32_t hashDeviceId(const char *deviceId) {
+    // FNV-1a over the id, which is not necessarily null terminated
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < sizeof(Pairing::deviceId) && deviceId[i] != '\0'; i++) {
+        hash = (hash ^ (uint8_t) deviceId[i]) * 16777619u;
+    }
+    return hash;
+}
+
+void indexPairing(int slot) {
+    uint32_t i = pairingTable.hashes[slot];
+    while (pairingTable.index[i & (PAIRING_INDEX_SIZE - 1)] != -1) {
+        i++;
+    }
+    pairingTable.index[i & (PAIRING_INDEX_SIZE - 1)] = slot;
+}
+
+void rebuildPairingIndex() {
+    memset(pairingTable.index, -1, sizeof(pairingTable.index));
+    pairingTable.count = 0;
     for (int i = 0; i < MAX_PAIRINGS; i++) {
-        EEPROM.get(PAIRINGS_ADDR + sizeof(HKStorage::PairingData)*i, pairingData);
-
-        bool empty = true;
-        for (unsigned char j : pairingData) {
-            if (j != 0x0) {
-                empty = false;
-                break;
-            }
+        if (pairingTable.entries[i].id != -1) {
+            indexPairing(i);
+            pairingTable.count++;
         }
+    }
+}
+
+void clearPairingTable() {
+    for (int i = 0; i < MAX_PAIRINGS; i++) {
+        memset(&pairingTable.entries[i], 0, sizeof(Pairing));
+        pairingTable.entries[i].id = -1;
+    }
+    rebuildPairingIndex();
+    pairingTable.loaded = true;
+}
 
-        if (empty) {
-            EEPROM.end();
-            return i;
+int findPairingSlot(const char *deviceId) {
+    if (!pairingTable.loaded) {
+        HKStorage::loadPairings();
+    }
+    uint32_t hash = hashDeviceId(deviceId);
+    for (uint32_t i = hash; ; i++) {
+        int8_t slot = pairingTable.index[i & (PAIRING_INDEX_SIZE - 1)];
+        if (slot == -1) {
+            return -1;
+        }
+        if (pairingTable.hashes[slot] == hash && strncmp(pairingTable.entries[slot].deviceId, deviceId, sizeof(Pairing::deviceId)) == 0) {
+            return slot;
         }
     }
+}
 
-    EEPROM.end();
-    return -1;
+void writePairing(int slot) {
+    const Pairing &pairing = pairingTable.entries[slot];
+    if (pairing.id == -1) {
+        getStore().remove(HKStorage::StorageKeyPairings + slot);
+        return;
+    }
+
+    HKStorage::PairingData pairingData{};
+    pairingData.permissions = pairing.permissions;
+    memcpy(pairingData.deviceId, pairing.deviceId, sizeof(pairingData.deviceId));
+    memcpy(pairingData.devicePublicKey, pairing.deviceKey, sizeof(pairingData.devicePublicKey));
+    if (!getStore().put(HKStorage::StorageKeyPairings + slot, &pairingData, sizeof(pairingData))) {
+        HKLOGERROR("[HKStorage::writePairing] Could not store pairing %i\r\n", slot);
+    }
 }
 
-String generateAccessoryId() {
-    EEPROM.begin(4096);
+String formatAccessoryId(const uint8_t *id) {
     String result = String();
     for (uint8_t i = 0; i < 6; i++) {
-        uint8_t number = (uint8_t) random(0xFF);
-        EEPROM.write(ACCESSORY_ID_ADDR + i, number);
-        if (number < 0x10) {
-            result += "0" + String(number, HEX) + ":";
+        if (id[i] < 0x10) {
+            result += "0" + String(id[i], HEX) + ":";
         } else {
-            result += String(number, HEX) + ":";
+            result += String(id[i], HEX) + ":";
         }
     }
     result.toUpperCase();
-    EEPROM.commit();
-    EEPROM.end();
+    return result;
+}
+
+String generateAccessoryId() {
+    uint8_t id[6];
+    for (uint8_t i = 0; i < 6; i++) {
+        id[i] = (uint8_t) random(0xFF);
+    }
+    getStore().put(HKStorage::StorageKeyAccessoryId, id, sizeof(id));
+    String result = formatAccessoryId(id);
 
     HKLOGINFO("[HKStorage::generateAccessoryId] Accessory ID: %s\r\n", result.c_str());
 
@@ -51,67 +176,157 @@ String generateAccessoryId() {
 }
 
 KeyPair generateAccessoryKey() {
-    EEPROM.begin(4096);
     HKLOGINFO("[HKStorage::generateAccessoryKey] Generating Accessory Key\r\n");
     KeyPair result{};
     os_get_random(result.privateKey, sizeof(result.privateKey));
     Ed25519::derivePublicKey(result.publicKey, result.privateKey);
-    
-    EEPROM.put(ACCESSORY_KEY_ADDR, result);
-    EEPROM.commit();
-    EEPROM.end();
+
+    getStore().put(HKStorage::StorageKeyAccessoryKey, &result, sizeof(result));
 
     return result;
 }
 
-void writeString(uint16_t address, String data, uint16_t maxLength) {
-    EEPROM.begin(4096);
-    for (uint16_t i = 0; i < data.length() && (maxLength == 0 || i < maxLength); i++) {
-        EEPROM.write(address + i, data[i]);
+void writeString(uint16_t key, const String &data, uint16_t maxLength) {
+    size_t length = maxLength == 0 || data.length() < maxLength ? data.length() : maxLength;
+    if (length == 0) {
+        getStore().remove(key);
+    } else {
+        getStore().put(key, data.c_str(), length);
     }
-    if (maxLength == 0 || data.length() < maxLength) {
-        EEPROM.write(address + data.length(), '\0');
+}
+
+String readString(uint16_t key, uint16_t maxLength) {
+    char buffer[65] = {0};
+    size_t size = maxLength == 0 || maxLength >= sizeof(buffer) ? sizeof(buffer) - 1 : maxLength;
+    int length = getStore().get(key, buffer, size);
+    if (length < 0) {
+        return String();
     }
-    EEPROM.commit();
-    EEPROM.end();
+    buffer[(size_t) length < size ? length : size] = '\0';
+    return String(buffer);
 }
 
-String readString(uint16_t address, uint16_t maxLength) {
+bool writeHeader() {
+    HKStorage::Header header{};
+    memcpy(header.check, STORAGE_CHECK, STORAGE_CHECK_LEN);
+    header.version = STORAGE_VERSION;
+    header.maxPairings = MAX_PAIRINGS;
+    header.pairingSize = sizeof(HKStorage::PairingData);
+    return getStore().put(HKStorage::StorageKeyHeader, &header, sizeof(header));
+}
+
+bool putLegacyPairing(int slot, const HKStorage::LegacyPairingData &legacy) {
+    if (strncmp(legacy.comparing, COMPARING, COMPARE_SIZE) != 0) {
+        return getStore().remove(HKStorage::StorageKeyPairings + slot);
+    }
+    HKStorage::PairingData pairingData{};
+    pairingData.permissions = legacy.permissions;
+    memcpy(pairingData.deviceId, legacy.deviceId, sizeof(pairingData.deviceId));
+    memcpy(pairingData.devicePublicKey, legacy.devicePublicKey, sizeof(pairingData.devicePublicKey));
+    return getStore().put(HKStorage::StorageKeyPairings + slot, &pairingData, sizeof(pairingData));
+}
+
+String readLegacyString(uint16_t address, uint16_t maxLength) {
     String data = String();
-    char k;
-    EEPROM.begin(4096);
-    k = EEPROM.read(address);
-    while (k != '\0' && (maxLength == 0 || data.length() < maxLength)) {
+    char k = EEPROM.read(address);
+    while (k != '\0' && data.length() < maxLength) {
         data += k;
         k = EEPROM.read(address + data.length());
     }
-    EEPROM.end();
     return data;
 }
 
+/**
+ * @brief Copy the fixed EEPROM layout into the record store
+ * 
+ * Works on the copy taken by readLegacyEEPROM(). The header is written last, so with a separate
+ * store sector an interrupted migration starts over on the next boot. Afterwards the old check
+ * string is cleared there, so stale pairings can not come back if the record store is lost later.
+ * With the default location the store has already replaced the EEPROM data.
+ * 
+ * @return true Migrated
+ * @return false No valid EEPROM data
+ */
+bool migrateEEPROM() {
+    if (!legacyEEPROM) {
+        return false;
+    }
+    HKLOGINFO("[HKStorage::migrateEEPROM] Migrating EEPROM to version %d\r\n", STORAGE_VERSION);
+
+    bool success = getStore().format();
+    writeString(HKStorage::StorageKeySSID, readLegacyString(SSID_ADDR, 32), 32);
+    writeString(HKStorage::StorageKeyWiFiPassword, readLegacyString(WIFI_PASSWORD_ADDR, 64), 64);
+
+    uint8_t id[6];
+    bool hasId = false;
+    for (uint8_t i = 0; i < 6; i++) {
+        id[i] = EEPROM.read(ACCESSORY_ID_ADDR + i);
+        hasId |= id[i] != 0;
+    }
+    if (hasId) {
+        success &= getStore().put(HKStorage::StorageKeyAccessoryId, id, sizeof(id));
+    }
+
+    KeyPair zero{};
+    KeyPair keyPair{};
+    EEPROM.get(ACCESSORY_KEY_ADDR, keyPair);
+    if (memcmp(keyPair.privateKey, zero.privateKey, sizeof(keyPair.privateKey)) != 0 && memcmp(keyPair.publicKey, zero.publicKey, sizeof(keyPair.publicKey)) != 0) {
+        success &= getStore().put(HKStorage::StorageKeyAccessoryKey, &keyPair, sizeof(keyPair));
+    }
+
+    HKStorage::LegacyPairingData legacy{};
+    for (int i = 0; i < MAX_PAIRINGS; i++) {
+        EEPROM.get(PAIRINGS_ADDR + sizeof(legacy)*i, legacy);
+        success &= putLegacyPairing(i, legacy);
+    }
+
+    success = success && writeHeader();
+#ifdef HKSTORE_FLASH_SECTOR
+    if (success) {
+        for (uint8_t i = 0; i < STORAGE_CHECK_LEN; i++) {
+            EEPROM.write(STORAGE_CHECK_ADDR + i, 0);
+        }
+    }
+#endif
+    endLegacyEEPROM();
+    return success;
+}
+
 /**
  * @brief Check if storage is still valid
  * 
+ * Reads the header once. The old EEPROM layout is migrated, anything else is reset.
  */
 void HKStorage::checkStorage() {
-    String comparing = readString(STORAGE_CHECK_ADDR, STORAGE_CHECK_LEN);
-    if (comparing != STORAGE_CHECK) {
+    Header header{};
+    int size = getStore().get(StorageKeyHeader, &header, sizeof(header));
+    if (size == sizeof(header) && strncmp(header.check, STORAGE_CHECK, STORAGE_CHECK_LEN) == 0 &&
+        header.version == STORAGE_VERSION && header.maxPairings == MAX_PAIRINGS && header.pairingSize == sizeof(PairingData)) {
+        endLegacyEEPROM();
+        return;
+    }
+
+    bool migrated = false;
+    if (size == -1) {
+        migrated = migrateEEPROM();
+    }
+    if (!migrated) {
         reset();
     }
+    endLegacyEEPROM();
 }
 
 /**
- * @brief Reset complete EEPROM
+ * @brief Reset the complete record store
  * 
  */
 void HKStorage::reset() {
     HKLOGINFO("[HKStorage::reset] Reset\r\n");
-    writeString(STORAGE_CHECK_ADDR, STORAGE_CHECK, STORAGE_CHECK_LEN);
-    EEPROM.begin(4096);
-    for (uint i = STORAGE_CHECK_ADDR + STORAGE_CHECK_LEN; i < 4096; i++) {
-        EEPROM.write(i, 0);
+    if (!getStore().format()) {
+        HKLOGERROR("[HKStorage::reset] Could not format record store\r\n");
     }
-    EEPROM.end();
+    writeHeader();
+    clearPairingTable();
 }
 
 /**
@@ -119,11 +334,10 @@ void HKStorage::reset() {
  * 
  */
 void HKStorage::resetPairings() {
-    EEPROM.begin(4096);
-    for (uint i = PAIRINGS_ADDR; i < 4096; i++) {
-        EEPROM.write(i, 0);
+    for (int i = 0; i < MAX_PAIRINGS; i++) {
+        getStore().remove(StorageKeyPairings + i);
     }
-    EEPROM.end();
+    clearPairingTable();
     HKLOGINFO("[HKStorage::resetPairings] Reset Pairings\r\n");
 }
 
@@ -133,26 +347,11 @@ void HKStorage::resetPairings() {
  * @return String Accessory Id
  */
 String HKStorage::getAccessoryId() {
-    EEPROM.begin(4096);
-    String result = String();
-    bool generate = true;
-    for (uint8_t i = 0; i < 6; i++) {
-        uint8_t number = EEPROM.read(ACCESSORY_ID_ADDR + i);
-        if (number != 0) {
-            generate = false;
-        }
-        if (number < 0x10) {
-            result += "0" + String(number, HEX) + ":";
-        } else {
-            result += String(number, HEX) + ":";
-        }
-    }
-    EEPROM.end();
-    if (generate) {
-        result = generateAccessoryId();
+    uint8_t id[6];
+    if (getStore().get(StorageKeyAccessoryId, id, sizeof(id)) != sizeof(id)) {
+        return generateAccessoryId();
     }
-    result.toUpperCase();
-    return result;
+    return formatAccessoryId(id);
 }
 
 /**
@@ -161,13 +360,8 @@ String HKStorage::getAccessoryId() {
  * @return KeyPair Key pair (public/private)
  */
 KeyPair HKStorage::getAccessoryKey() {
-    KeyPair zero{};
     KeyPair result{};
-    EEPROM.begin(4096);
-    EEPROM.get(ACCESSORY_KEY_ADDR, result);
-    EEPROM.end();
-
-    if (memcmp(result.privateKey, zero.privateKey, sizeof(result.privateKey)) == 0 || memcmp(result.publicKey, zero.publicKey, sizeof(result.publicKey)) == 0) {
+    if (getStore().get(StorageKeyAccessoryKey, &result, sizeof(result)) != sizeof(result)) {
         result = generateAccessoryKey();
     }
 
@@ -175,23 +369,51 @@ KeyPair HKStorage::getAccessoryKey() {
 }
 
 /**
- * @brief Store SSID in EEPROM
+ * @brief Configuration number for the accessory layout
+ * 
+ * The number is only incremented when the layout hash differs from the stored one, so controllers keep their
+ * cached accessory database across restarts and firmware updates that do not change the layout.
+ * 
+ * @param layoutHash Hash over the accessory layout
+ * @return uint16_t Configuration number (c#)
+ */
+uint16_t HKStorage::updateConfigNumber(uint32_t layoutHash) {
+    ConfigState state{};
+    if (getStore().get(StorageKeyConfig, &state, sizeof(state)) != sizeof(state) || state.configNumber == 0) {
+        state.layoutHash = layoutHash;
+        state.configNumber = 1;
+    } else if (state.layoutHash != layoutHash) {
+        state.layoutHash = layoutHash;
+        state.configNumber = state.configNumber == UINT16_MAX ? 1 : state.configNumber + 1;
+        HKLOGINFO("[HKStorage::updateConfigNumber] Accessory layout changed\r\n");
+    } else {
+        return state.configNumber;
+    }
+
+    if (!getStore().put(StorageKeyConfig, &state, sizeof(state))) {
+        HKLOGERROR("[HKStorage::updateConfigNumber] Could not store configuration number\r\n");
+    }
+    return state.configNumber;
+}
+
+/**
+ * @brief Store SSID
  * 
  * @param ssid SSID to save
  */
 void HKStorage::saveSSID(const String &ssid) {
-    writeString(SSID_ADDR, ssid, 32);
-    HKLOGINFO("[HKStorage::resetPairings] Set ssid %s\r\n", readString(SSID_ADDR, 32).c_str());
+    writeString(StorageKeySSID, ssid, 32);
+    HKLOGINFO("[HKStorage::resetPairings] Set ssid %s\r\n", readString(StorageKeySSID, 32).c_str());
 }
 
 /**
- * @brief Store WiFi Password in EEPROM
+ * @brief Store WiFi Password
  * 
  * @param password Password to save
  */
 void HKStorage::saveWiFiPassword(const String &password) {
-    writeString(WIFI_PASSWORD_ADDR, password, 64);
-    HKLOGINFO("[HKStorage::resetPairings] Set password %s\r\n", readString(WIFI_PASSWORD_ADDR, 64).c_str());
+    writeString(StorageKeyWiFiPassword, password, 64);
+    HKLOGINFO("[HKStorage::resetPairings] Set password %s\r\n", readString(StorageKeyWiFiPassword, 64).c_str());
 }
 
 /**
@@ -200,7 +422,7 @@ void HKStorage::saveWiFiPassword(const String &password) {
  * @return String SSID
  */
 String HKStorage::getSSID() {
-    return readString(SSID_ADDR, 32);
+    return readString(StorageKeySSID, 32);
 }
 
 /**
@@ -209,28 +431,46 @@ String HKStorage::getSSID() {
  * @return String Password
  */
 String HKStorage::getWiFiPassword() {
-    return readString(WIFI_PASSWORD_ADDR, 64);
+    return readString(StorageKeyWiFiPassword, 64);
 }
 
 /**
- * @brief Is there a paired client
+ * @brief Copy all pairings from the record store into the RAM table
  * 
- * @return true Contains paired client
- * @return false No paired clients
+ * Called once at boot, all later lookups are served from RAM and changes are written through.
  */
-bool HKStorage::isPaired() {
+void HKStorage::loadPairings() {
+    clearPairingTable();
+
     PairingData pairingData{};
-    EEPROM.begin(4096);
     for (int i = 0; i < MAX_PAIRINGS; i++) {
-        EEPROM.get(PAIRINGS_ADDR +  + sizeof(pairingData)*i, pairingData);
-        if (strncmp(pairingData.comparing, COMPARING, COMPARE_SIZE) != 0) {
+        if (getStore().get(StorageKeyPairings + i, &pairingData, sizeof(pairingData)) != sizeof(pairingData)) {
             continue;
         }
-        EEPROM.end();
-        return true;
+
+        Pairing &pairing = pairingTable.entries[i];
+        pairing.id = i;
+        memcpy(pairing.deviceId, pairingData.deviceId, sizeof(pairing.deviceId));
+        memcpy(pairing.deviceKey, pairingData.devicePublicKey, sizeof(pairing.deviceKey));
+        pairing.permissions = pairingData.permissions;
+        pairingTable.hashes[i] = hashDeviceId(pairing.deviceId);
     }
-    EEPROM.end();
-    return false;
+
+    rebuildPairingIndex();
+    HKLOGDEBUG("[HKStorage::loadPairings] Loaded %u pairings\r\n", pairingTable.count);
+}
+
+/**
+ * @brief Is there a paired client
+ * 
+ * @return true Contains paired client
+ * @return false No paired clients
+ */
+bool HKStorage::isPaired() {
+    if (!pairingTable.loaded) {
+        loadPairings();
+    }
+    return pairingTable.count > 0;
 }
 
 /**
@@ -242,23 +482,33 @@ bool HKStorage::isPaired() {
  * @return int Successfully saved = 0
  */
 int HKStorage::addPairing(const char *deviceId, const byte *deviceKey, byte permission) {
-    int nextBlockIdx = findEmptyBlock();
+    if (!pairingTable.loaded) {
+        loadPairings();
+    }
+
+    int slot = -1;
+    for (int i = 0; i < MAX_PAIRINGS; i++) {
+        if (pairingTable.entries[i].id == -1) {
+            slot = i;
+            break;
+        }
+    }
 
-    if (nextBlockIdx == -1) {
+    if (slot == -1) {
         //Failed to write pairing info to flash: max number of pairings
         return -2;
     }
 
-    PairingData pairingData{};
-    strncpy(pairingData.comparing, COMPARING, COMPARE_SIZE);
-    pairingData.permissions = permission;
-    strncpy(pairingData.deviceId, deviceId, sizeof(pairingData.deviceId));
-    memcpy(pairingData.devicePublicKey, deviceKey, sizeof(pairingData.devicePublicKey));
-
-    EEPROM.begin(4096);
-    EEPROM.put(PAIRINGS_ADDR + sizeof(pairingData)*nextBlockIdx, pairingData);
-    EEPROM.end();
+    Pairing &pairing = pairingTable.entries[slot];
+    pairing.id = slot;
+    strncpy(pairing.deviceId, deviceId, sizeof(pairing.deviceId));
+    memcpy(pairing.deviceKey, deviceKey, sizeof(pairing.deviceKey));
+    pairing.permissions = permission;
+    pairingTable.hashes[slot] = hashDeviceId(pairing.deviceId);
+    indexPairing(slot);
+    pairingTable.count++;
 
+    writePairing(slot);
     return 0;
 }
 
@@ -270,53 +520,25 @@ int HKStorage::addPairing(const char *deviceId, const byte *deviceKey, byte perm
  * @return int Successfully changed (0)
  */
 int HKStorage::updatePairing(const String &deviceId, byte permission) {
-    PairingData pairingData{};
-    EEPROM.begin(4096);
-    for (int i = 0; i < MAX_PAIRINGS; i++) {
-        EEPROM.get(PAIRINGS_ADDR + sizeof(pairingData)*i, pairingData);
-        if (strncmp(pairingData.comparing, COMPARING, COMPARE_SIZE) != 0) {
-            continue;
-        }
-
-        if (strncmp(pairingData.deviceId, deviceId.c_str(), sizeof(pairingData.deviceId)) == 0) {
-            pairingData.permissions = permission;
-            EEPROM.put(PAIRINGS_ADDR + sizeof(pairingData)*i, pairingData);
-            EEPROM.end();
-            return 0;
-        }
+    int slot = findPairingSlot(deviceId.c_str());
+    if (slot == -1) {
+        return -1;
     }
-    EEPROM.end();
-    return -1;
+
+    pairingTable.entries[slot].permissions = permission;
+    writePairing(slot);
+    return 0;
 }
 
 /**
  * @brief Find paired device with Id
  * 
  * @param deviceId Devie to find
- * @return Pairing* Stored data for device
+ * @return const Pairing* Stored data for device, owned by the pairing table and only valid until the pairing is removed
  */
-Pairing *HKStorage::findPairing(const char *deviceId) {
-    PairingData pairingData{};
-    EEPROM.begin(4096);
-    for (int i = 0; i < MAX_PAIRINGS; i++) {
-        EEPROM.get(PAIRINGS_ADDR + sizeof(pairingData)*i, pairingData);
-        if (strncmp(pairingData.comparing, COMPARING, COMPARE_SIZE) != 0) {
-            continue;
-        }
-
-        if (memcmp(pairingData.deviceId, deviceId, sizeof(pairingData.deviceId)) == 0) {
-            auto pairing = new Pairing();
-            pairing->id = i;
-            strncpy(pairing->deviceId, pairingData.deviceId, sizeof(pairingData.deviceId));
-            memcpy(pairing->deviceKey, pairingData.devicePublicKey, sizeof(pairingData.devicePublicKey));
-            pairing->permissions = pairingData.permissions;
-
-            EEPROM.end();
-            return pairing;
-        }
-    }
-    EEPROM.end();
-    return nullptr;
+const Pairing *HKStorage::findPairing(const char *deviceId) {
+    int slot = findPairingSlot(deviceId);
+    return slot == -1 ? nullptr : &pairingTable.entries[slot];
 }
 
 /**
@@ -326,23 +548,17 @@ Pairing *HKStorage::findPairing(const char *deviceId) {
  * @return int Successful (0)
  */
 int HKStorage::removePairing(const String &deviceId) {
-    PairingData pairingData{};
-    EEPROM.begin(4096);
-    for (int i = 0; i < MAX_PAIRINGS; i++) {
-        EEPROM.get(PAIRINGS_ADDR + sizeof(pairingData)*i, pairingData);
-        if (strncmp(pairingData.comparing, COMPARING, COMPARE_SIZE) != 0) {
-            continue;
-        }
-
-        if (strncmp(pairingData.deviceId, deviceId.c_str(), sizeof(pairingData.deviceId)) == 0) {
-            PairingData empty{};
-            EEPROM.put(PAIRINGS_ADDR + sizeof(pairingData)*i, empty);
-            EEPROM.end();
-            return 0;
-        }
+    int slot = findPairingSlot(deviceId.c_str());
+    if (slot == -1) {
+        return -1;
     }
-    EEPROM.end();
-    return -1;
+
+    memset(&pairingTable.entries[slot], 0, sizeof(Pairing));
+    pairingTable.entries[slot].id = -1;
+    rebuildPairingIndex();
+
+    writePairing(slot);
+    return 0;
 }
 
 /**
@@ -352,45 +568,31 @@ int HKStorage::removePairing(const String &deviceId) {
  * @return false No device with Admin rights
  */
 bool HKStorage::hasPairedAdmin() {
-    PairingData pairingData{};
-    EEPROM.begin(4096);
-    for (int i = 0; i < MAX_PAIRINGS; i++) {
-        EEPROM.get(PAIRINGS_ADDR + sizeof(pairingData)*i, pairingData);
-        if (strncmp(pairingData.comparing, COMPARING, COMPARE_SIZE) != 0) {
-            continue;
-        }
-
-        if (pairingData.permissions & PairingPermissionAdmin) {
-            EEPROM.end();
+    if (!pairingTable.loaded) {
+        loadPairings();
+    }
+    for (const Pairing &pairing : pairingTable.entries) {
+        if (pairing.id != -1 && (pairing.permissions & PairingPermissionAdmin)) {
             return true;
         }
     }
-    EEPROM.end();
     return false;
 }
 
 /**
  * @brief Get all connected devices
  * 
- * @return std::vector<Pairing *> List of connected devices
+ * @return std::vector<const Pairing *> List of connected devices, owned by the pairing table
  */
-std::vector<Pairing *> HKStorage::getPairings() {
-    std::vector<Pairing *> pairings;
-    PairingData pairingData{};
-    EEPROM.begin(4096);
-    for (int i = 0; i < MAX_PAIRINGS; i++) {
-        EEPROM.get(PAIRINGS_ADDR + sizeof(pairingData)*i, pairingData);
-        if (strncmp(pairingData.comparing, COMPARING, COMPARE_SIZE) != 0) {
-            continue;
+std::vector<const Pairing *> HKStorage::getPairings() {
+    if (!pairingTable.loaded) {
+        loadPairings();
+    }
+    std::vector<const Pairing *> pairings;
+    for (const Pairing &pairing : pairingTable.entries) {
+        if (pairing.id != -1) {
+            pairings.push_back(&pairing);
         }
-
-        auto pairing = new Pairing();
-        pairing->id = i;
-        strncpy(pairing->deviceId, pairingData.deviceId, sizeof(pairingData.deviceId));
-        memcpy(pairing->deviceKey, pairingData.devicePublicKey, sizeof(pairingData.devicePublicKey));
-        pairing->permissions = pairingData.permissions;
-        pairings.push_back(pairing);
     }
-    EEPROM.end();
     return pairings;
 }
@@ -6,17 +6,18 @@
 #define HAP_SERVER_HKSTORAGE_H
 
 #include <Arduino.h>
-#include <EEPROM.h>
 #include <Ed25519.h>
 
 #include "HKDebug.h"
 #include "HKDefinitions.h"
+#include "HKRecordStore.h"
 
 #ifndef STORAGE_BASE_ADDR
 #define STORAGE_BASE_ADDR   0x0
 #endif
 
 #define MAX_PAIRINGS 16
+#define PAIRING_INDEX_SIZE  (2 * MAX_PAIRINGS)    // open addressing slots, power of two
 
 #define ACCESSORY_ID_SIZE   17
 
@@ -31,6 +32,8 @@
 #endif
 #define STORAGE_CHECK_LEN 4
 
+#define STORAGE_VERSION 1
+
 struct Pairing {
     int id;
     char deviceId[36];
@@ -43,6 +46,7 @@ struct KeyPair {
     byte publicKey[32];
 };
 
+// Layout of the old EEPROM storage, only needed to migrate existing data
 #define STORAGE_CHECK_ADDR  STORAGE_BASE_ADDR
 #define SSID_ADDR           (STORAGE_CHECK_ADDR + STORAGE_CHECK_LEN)
 #define WIFI_PASSWORD_ADDR  (SSID_ADDR + 32)
@@ -51,6 +55,16 @@ struct KeyPair {
 #define PAIRINGS_ADDR       (ACCESSORY_KEY_ADDR + sizeof(KeyPair))
 
 namespace HKStorage {
+    enum StorageKey : uint16_t {
+        StorageKeyHeader = 0,
+        StorageKeySSID,
+        StorageKeyWiFiPassword,
+        StorageKeyAccessoryId,
+        StorageKeyAccessoryKey,
+        StorageKeyConfig,
+        StorageKeyPairings = 8,     // MAX_PAIRINGS keys, one per slot
+    };
+
     void checkStorage();
     void reset();
     void resetPairings();
@@ -61,21 +75,50 @@ namespace HKStorage {
     
     String getAccessoryId();
     KeyPair getAccessoryKey();
+    uint16_t updateConfigNumber(uint32_t layoutHash);
 
+    void loadPairings();
     bool isPaired();
     bool hasPairedAdmin();
-    std::vector<Pairing *> getPairings();
+    std::vector<const Pairing *> getPairings();
     int addPairing(const char *deviceId, const byte *deviceKey, byte permission);
-    Pairing *findPairing(const char *deviceId);
+    const Pairing *findPairing(const char *deviceId);
     int updatePairing(const String &deviceId, byte permission);
     int removePairing(const String &deviceId);
     
+    struct Header {
+        char check[STORAGE_CHECK_LEN];
+        uint8_t version;                    // STORAGE_VERSION
+        uint8_t maxPairings;                // MAX_PAIRINGS
+        uint16_t pairingSize;               // sizeof(PairingData)
+    };
+
+    struct ConfigState {
+        uint32_t layoutHash;
+        uint16_t configNumber;              // c#, 1 to 65535
+    };
+
     struct PairingData {
+        unsigned char permissions;
+        char deviceId[36];
+        byte devicePublicKey[32];
+    };
+
+    // Pairing slot as stored in EEPROM
+    struct LegacyPairingData {
         char comparing[COMPARE_SIZE];
         unsigned char permissions;
         char deviceId[36];
         byte devicePublicKey[32];
     };
+
+    struct PairingTable {
+        bool loaded;
+        uint8_t count;
+        Pairing entries[MAX_PAIRINGS];      // entries[i] mirrors StorageKeyPairings + i, id -1 if empty
+        uint32_t hashes[MAX_PAIRINGS];
+        int8_t index[PAIRING_INDEX_SIZE];   // slot numbers by device id hash, -1 if empty
+    };
 };
 
 
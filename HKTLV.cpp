@@ -5,171 +5,296 @@
 #include "HKTLV.h"
 
 /**
- * @brief Construct a new HKTLV::HKTLV object
+ * @brief Index TLV8 data in one pass without copying it
  * 
- * @param type Type of TLV
- * @param value Value of TLV
- * @param size Size for TLV value
+ * Only the first item of every type is indexed. Consecutive items of the same type after a 255 byte item are
+ * fragments of it, they are merged on the first getValue().
+ * 
+ * @param data TLV8 data, has to outlive the reader
+ * @param size Size of data
  */
-HKTLV::HKTLV(uint8_t type, uint8_t *value, size_t size) : type(type), size(size) {
-    this->value = (uint8_t *) malloc(size);
-    memcpy(this->value, value, size);
+HKTLVReader::HKTLVReader(const uint8_t *data, size_t size) : items(), valid(true) {
+    int indexedType = -1;      // type of the previous item if it was indexed
+    uint8_t previousSize = 0;
+    for (size_t i = 0; i < size;) {
+        if (i + 2 > size || i + 2 + data[i + 1] > size) {
+            HKLOGWARNING("[HKTLVReader::HKTLVReader] Item at %u exceeds data\r\n", i);
+            valid = false;
+            break;
+        }
+
+        uint8_t type = data[i];
+        uint8_t itemSize = data[i + 1];
+        bool indexed = false;
+        if (type < HKTLV_READER_TYPES) {
+            Item &item = items[type];
+            if (!item.fragments) {
+                item.value = data + i + 2;
+                item.size = itemSize;
+                item.fragments = 1;
+                indexed = true;
+            } else if (type == indexedType && previousSize == 255 && item.fragments < 255) {
+                item.size += itemSize;
+                item.fragments++;
+                indexed = true;
+            }
+        }
+
+        indexedType = indexed ? type : -1;
+        previousSize = itemSize;
+        i += 2 + itemSize;
+    }
 }
 
 /**
- * @brief Construct a new HKTLV::HKTLV object
+ * @brief Destroy the HKTLVReader::HKTLVReader object, frees merged fragments
  * 
- * @param type Type of TLV
- * @param pValue 8-Bit value
- * @param size Size to reserve for value
  */
-HKTLV::HKTLV(uint8_t type, uint8_t pValue, size_t size) : type(type), size(size) {
-    uint8_t *data = (uint8_t *) malloc(size);
-    for (size_t i = 0; i < size; i++) {
-        data[i] = pValue & 0xff;
-        pValue >>= 8;
+HKTLVReader::~HKTLVReader() {
+    for (Item &item : items) {
+        if (item.merged) {
+            free((void *) item.value);
+        }
     }
-
-    value = data;
 }
 
 /**
- * @brief Destroy the HKTLV::HKTLV object
+ * @brief All items fit into the data
  * 
+ * @return true Data is well formed
+ * @return false An item is truncated, items before it are still indexed
  */
-HKTLV::~HKTLV() {
-    free(value);
+bool HKTLVReader::isValid() const {
+    return valid;
 }
 
 /**
- * @brief Get type
+ * @brief Is an item of type present
  * 
- * @return uint8_t Type
+ * @param type Type to look up
+ * @return true Item is present, it may be empty
+ * @return false No item of type
  */
-uint8_t HKTLV::getType() const {
-    return type;
+bool HKTLVReader::contains(TLVType type) const {
+    return type < HKTLV_READER_TYPES && items[type].fragments;
 }
 
 /**
- * @brief Get size
+ * @brief Get value of the item with type, fragmented values are merged into one allocation
  * 
- * @return size_t Size
+ * @param type Type to look up
+ * @return const uint8_t* Value, valid as long as the reader and its buffer, nullptr if not present
  */
-size_t HKTLV::getSize() const {
-    return size;
+const uint8_t *HKTLVReader::getValue(TLVType type) {
+    if (!contains(type)) {
+        return nullptr;
+    }
+
+    Item &item = items[type];
+    if (item.fragments > 1 && !item.merged) {
+        auto merged = (uint8_t *) malloc(item.size);
+        if (!merged) {
+            return nullptr;
+        }
+        const uint8_t *fragment = item.value;
+        size_t offset = 0;
+        for (uint8_t i = 0; i < item.fragments; i++) {
+            uint8_t fragmentSize = fragment[-1];
+            memcpy(merged + offset, fragment, fragmentSize);
+            offset += fragmentSize;
+            fragment += fragmentSize + 2;
+        }
+        item.value = merged;
+        item.merged = true;
+    }
+    return item.value;
 }
 
 /**
- * @brief Get value
+ * @brief Get size of the item with type
  * 
- * @return uint8_t* value
+ * @param type Type to look up
+ * @return size_t Size of all fragments, 0 if not present
  */
-uint8_t *HKTLV::getValue() {
-    return value;
+size_t HKTLVReader::getSize(TLVType type) const {
+    return contains(type) ? items[type].size : 0;
 }
 
 /**
- * @brief Get total length of bytes to store when formatting TLVs to bytes
+ * @brief Interpret value as little endian integer
  * 
- * @param values TLVs to convert
- * @return size_t Size of formatted TLVs as bytes
+ * @param type Type to look up
+ * @param defaultValue Returned if no item of type is present
+ * @return int Value
  */
-size_t HKTLV::getFormattedTLVSize(const std::vector<HKTLV *> &values) {
-    size_t messageSize = 0;
-    for (HKTLV *tlv : values) {
-        messageSize += 2;
-        if (tlv->getSize() > 0) {
-            messageSize += ((size_t) (tlv->getSize()-1)/255) * 2 + tlv->getSize();
-        }
+int HKTLVReader::getIntValue(TLVType type, int defaultValue) const {
+    if (!contains(type)) {
+        return defaultValue;
     }
-    return messageSize;
-}
-
-/**
- * @brief Convert TLVs to bytes
- * 
- * @param values TLVs to convert
- * @param message Target bytes
- */
-void HKTLV::formatTLV(const std::vector<HKTLV *> &values, uint8_t *message) {
-    size_t messagePos = 0;
-    for (auto tlv : values) {
-        if (tlv->getSize() == 0) {
-            message[messagePos++] = tlv->getType();
-            message[messagePos++] = 0;
-        } else {
-            size_t remainingSize = tlv->getSize();
-            while (remainingSize > 0) {
-                message[messagePos++] = tlv->getType();
-                size_t chunkSize = (remainingSize > 255) ? 255 : remainingSize;
-                message[messagePos++] = chunkSize;
-                memcpy(message + messagePos, tlv->getValue() + (tlv->getSize() - remainingSize), chunkSize);
-                messagePos += chunkSize;
-                remainingSize -= chunkSize;
-            }
-        }
+
+    const Item &item = items[type];
+    size_t size = item.size < sizeof(int) ? item.size : sizeof(int);
+    int result = 0;
+    for (int i = size - 1; i >= 0; i--) {
+        result = (result << 8) + item.value[i];
     }
+    return result;
 }
 
 /**
- * @brief Convert bytes to TLVs
+ * @brief Construct a new HKTLVWriter::HKTLVWriter object
  * 
- * @param body Bytes
- * @param size Size of bytes
- * @return std::vector<HKTLV *> Converted TLVs
+ * @param capacity Expected size of all items, the buffer grows if they do not fit
+ * @param headroom Bytes kept free in front of the items for prepend()
  */
-std::vector<HKTLV *> HKTLV::parseTLV(const uint8_t *body, const size_t &size) {
-    std::vector<HKTLV *> message;
-    for (size_t i = 0; i < size;) {
-        uint8_t type = body[i];
-        size_t tlvSize = 0;
+HKTLVWriter::HKTLVWriter(size_t capacity, size_t headroom) : capacity(capacity), headroom(headroom), size(0), valid(true) {
+    buffer = (uint8_t *) malloc(headroom + capacity);
+    if (!buffer) {
+        HKLOGERROR("[HKTLVWriter::HKTLVWriter] Could not allocate %u bytes\r\n", headroom + capacity);
+        this->capacity = 0;
+        valid = false;
+    }
+}
 
-        size_t j = i+1;
-        for (; j < size && body[j-1] == type; j += body[j] + 2) {
-            tlvSize += body[j];
-        }
+/**
+ * @brief Destroy the HKTLVWriter::HKTLVWriter object
+ * 
+ */
+HKTLVWriter::~HKTLVWriter() {
+    free(buffer);
+}
+
+/**
+ * @brief Append item, values over 255 bytes are split into consecutive fragments of the same type
+ * 
+ * @param type Type of item
+ * @param value Value of item, may be nullptr if size is 0
+ * @param size Size of value
+ */
+void HKTLVWriter::add(TLVType type, const uint8_t *value, size_t size) {
+    size_t fragments = size == 0 ? 1 : (size + 254) / 255;
+    if (!grow(size + fragments * 2)) {
+        return;
+    }
 
-        uint8_t *data = (uint8_t *) malloc(tlvSize);
-        size_t currentPos = 0;
-        while (i < size && currentPos < tlvSize && body[i] == type) {
-            uint8_t chunkSize = body[++i];
-            memcpy(data + currentPos, body + ++i, chunkSize);
-            i += chunkSize;
-            currentPos += chunkSize;
+    uint8_t *target = buffer + headroom + this->size;
+    do {
+        uint8_t fragmentSize = size > 255 ? 255 : size;
+        *target++ = type;
+        *target++ = fragmentSize;
+        if (fragmentSize) {
+            memcpy(target, value, fragmentSize);
+            target += fragmentSize;
+            value += fragmentSize;
         }
+        size -= fragmentSize;
+    } while (size > 0);
+    this->size = target - (buffer + headroom);
+}
 
-        message.push_back(new HKTLV(type, data, tlvSize));
-        free(data);
+/**
+ * @brief Append 8-Bit integer item
+ * 
+ * @param type Type of item
+ * @param value Value of item
+ */
+void HKTLVWriter::add(TLVType type, uint8_t value) {
+    add(type, &value, 1);
+}
+
+/**
+ * @brief Append item and let the caller write its value, e.g. to encrypt in place
+ * 
+ * The value has to be contiguous, so it can not be fragmented. The pointer is only valid until the next item
+ * is appended.
+ * 
+ * @param type Type of item
+ * @param size Size of value, at most 255
+ * @return uint8_t* Value to fill, nullptr if size is too big or out of memory
+ */
+uint8_t *HKTLVWriter::reserve(TLVType type, size_t size) {
+    if (size > 255 || !grow(size + 2)) {
+        return nullptr;
     }
-    return message;
+
+    uint8_t *target = buffer + headroom + this->size;
+    target[0] = type;
+    target[1] = size;
+    this->size += size + 2;
+    return target + 2;
 }
 
 /**
- * @brief Find TLV with type in values
+ * @brief Copy data into the headroom directly in front of the items, so both can be sent at once
  * 
- * @param values TLVs to search for
- * @param type Type to search
- * @return HKTLV* TLV with type or nullptr
+ * @param data Data to put in front, e.g. the HTTP header
+ * @param size Size of data
+ * @return uint8_t* Start of data followed by the items, nullptr if the headroom is too small
  */
-HKTLV *HKTLV::findTLV(const std::vector<HKTLV *> &values, const TLVType &type) {
-    auto findEncryptedData = std::find_if(values.begin(), values.end(), [type](const HKTLV *cmp) {
-        return cmp->getType() == type;
-    });
-    if (findEncryptedData == values.end()) {
+uint8_t *HKTLVWriter::prepend(const uint8_t *data, size_t size) {
+    if (!valid || size > headroom) {
         return nullptr;
     }
-    return *findEncryptedData;
+
+    uint8_t *target = buffer + headroom - size;
+    memcpy(target, data, size);
+    return target;
 }
 
 /**
- * @brief Interpret TLV value as Integer
+ * @brief All items were written
  * 
- * @return int TLV value
+ * @return true Buffer is complete
+ * @return false Ran out of memory, items are missing
  */
-int HKTLV::getIntValue() {
-    int result = 0;
-    for (int i = size-1; i >= 0; i--) {
-        result = (result << 8) + value[i];
+bool HKTLVWriter::isValid() const {
+    return valid;
+}
+
+/**
+ * @brief Get formatted items
+ * 
+ * @return const uint8_t* Items, valid until the next item is appended
+ */
+const uint8_t *HKTLVWriter::getData() const {
+    return buffer ? buffer + headroom : nullptr;
+}
+
+/**
+ * @brief Get size of formatted items, without headroom
+ * 
+ * @return size_t Size
+ */
+size_t HKTLVWriter::getSize() const {
+    return size;
+}
+
+/**
+ * @brief Make sure size more bytes fit behind the items, at least doubles the buffer
+ * 
+ * @param size Bytes to append
+ * @return true Bytes fit
+ * @return false Out of memory, the writer is invalid from now on
+ */
+bool HKTLVWriter::grow(size_t size) {
+    if (!valid) {
+        return false;
     }
-    return result;
+    if (this->size + size <= capacity) {
+        return true;
+    }
+
+    size_t newCapacity = capacity * 2;
+    if (newCapacity < this->size + size) {
+        newCapacity = this->size + size;
+    }
+    auto newBuffer = (uint8_t *) realloc(buffer, headroom + newCapacity);
+    if (!newBuffer) {
+        HKLOGERROR("[HKTLVWriter::grow] Could not grow to %u bytes\r\n", headroom + newCapacity);
+        valid = false;
+        return false;
+    }
+    buffer = newBuffer;
+    capacity = newCapacity;
+    return true;
 }
@@ -44,23 +44,67 @@ enum TLVError {
     TLVErrorBusy = 7
 };
 
-class HKTLV {
+// Types indexed by HKTLVReader, all pairing types are below
+#define HKTLV_READER_TYPES 15
+
+/**
+ * @brief Non-owning view of TLV8 data, the buffer has to outlive the reader
+ * 
+ */
+class HKTLVReader {
 public:
-    HKTLV(uint8_t type, uint8_t *value, size_t size);
-    HKTLV(uint8_t type, uint8_t pValue, size_t size);
-    ~HKTLV();
-    uint8_t getType() const;
+    HKTLVReader(const uint8_t *data, size_t size);
+    ~HKTLVReader();
+    HKTLVReader(const HKTLVReader &) = delete;
+    HKTLVReader &operator=(const HKTLVReader &) = delete;
+
+    bool isValid() const;
+    bool contains(TLVType type) const;
+    const uint8_t *getValue(TLVType type);
+    size_t getSize(TLVType type) const;
+    int getIntValue(TLVType type, int defaultValue = -1) const;
+private:
+    struct Item {
+        const uint8_t *value;   // first fragment in the buffer, or merged copy
+        size_t size;            // size of all fragments
+        uint8_t fragments;
+        bool merged;
+    };
+
+    Item items[HKTLV_READER_TYPES];
+    bool valid;
+};
+
+// Room kept free in front of the items for the HTTP header of the response
+#define HKTLV_WRITER_HEADROOM 112
+
+/**
+ * @brief Encodes TLV8 items straight into one growing buffer, values over 255 bytes are fragmented
+ * 
+ */
+class HKTLVWriter {
+public:
+    HKTLVWriter(size_t capacity = 64, size_t headroom = HKTLV_WRITER_HEADROOM);
+    ~HKTLVWriter();
+    HKTLVWriter(const HKTLVWriter &) = delete;
+    HKTLVWriter &operator=(const HKTLVWriter &) = delete;
+
+    void add(TLVType type, const uint8_t *value, size_t size);
+    void add(TLVType type, uint8_t value);
+    uint8_t *reserve(TLVType type, size_t size);
+    uint8_t *prepend(const uint8_t *data, size_t size);
+
+    bool isValid() const;
+    const uint8_t *getData() const;
     size_t getSize() const;
-    uint8_t *getValue();
-    int getIntValue();
-    static size_t getFormattedTLVSize(const std::vector<HKTLV *> &values);
-    static void formatTLV(const std::vector<HKTLV *> &values, uint8_t *message);
-    static std::vector<HKTLV *> parseTLV(const uint8_t *body, const size_t &size);
-    static HKTLV *findTLV(const std::vector<HKTLV *> &values, const TLVType &type);
 private:
-    uint8_t type;
-    uint8_t *value;
+    bool grow(size_t size);
+private:
+    uint8_t *buffer;
+    size_t capacity;
+    size_t headroom;
     size_t size;
+    bool valid;
 };
 
 
@@ -22,25 +22,183 @@ void JSON::flush() {
     pos = 0;
 }
 
-void JSON::write(const char *format, ...) {
-    va_list arg_ptr;
+void JSON::write(const char *data, size_t length) {
+    while (length > 0) {
+        if (pos == size) {
+            flush();
+        }
+        size_t chunk = length < size - pos ? length : size - pos;
+        memcpy(buffer + pos, data, chunk);
+        pos += chunk;
+        data += chunk;
+        length -= chunk;
+    }
+}
 
-    va_start(arg_ptr, format);
-    size_t len = vsnprintf((char *) buffer + pos, size - pos, format, arg_ptr);
-    va_end(arg_ptr);
+void JSON::write_P(PGM_P data, size_t length) {
+    while (length > 0) {
+        if (pos == size) {
+            flush();
+        }
+        size_t chunk = length < size - pos ? length : size - pos;
+        memcpy_P(buffer + pos, data, chunk);
+        pos += chunk;
+        data += chunk;
+        length -= chunk;
+    }
+}
 
-    if (len + pos > size - 1) {
+void JSON::write(char c) {
+    if (pos == size) {
         flush();
+    }
+    buffer[pos++] = c;
+}
+
+// Non zero if a byte of word is below 0x20, '"' or '\\'. Borrows can flag clean bytes above a match, those take the slow path.
+static inline uint32_t needsEscape(uint32_t word) {
+    uint32_t quote = word ^ 0x22222222u;
+    uint32_t backslash = word ^ 0x5C5C5C5Cu;
+    return (((word - 0x20202020u) & ~word) |
+            ((quote - 0x01010101u) & ~quote) |
+            ((backslash - 0x01010101u) & ~backslash)) & 0x80808080u;
+}
 
-        va_start(arg_ptr, format);
-        len = vsnprintf((char *) buffer + pos, size - pos, format, arg_ptr);
-        va_end(arg_ptr);
+/**
+ * @brief Write a string with RFC 8259 escaping
+ * 
+ * Aligned words without special characters are skipped four bytes at a time, clean runs are copied with a single
+ * write. UTF-8 is passed through.
+ */
+void JSON::writeEscaped(const char *value, size_t length) {
+    const char *end = value + length;
+    const char *run = value;
+    const char *p = value;
+    while (p < end) {
+        if (((uintptr_t) p & 3) == 0) {
+            uint32_t word;
+            while (end - p >= 4) {
+                memcpy(&word, __builtin_assume_aligned(p, 4), sizeof(word));
+                if (needsEscape(word)) {
+                    break;
+                }
+                p += 4;
+            }
+            if (p == end) {
+                break;
+            }
+        }
 
-        if (len < size) {
-            pos += len;
+        uint8_t c = *p;
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            p++;
+            continue;
         }
+
+        write(run, p - run);
+        char escape[6] = {'\\', 0, '0', '0', 0, 0};
+        size_t escapeLength = 2;
+        switch (c) {
+            case '"':
+            case '\\':
+                escape[1] = c;
+                break;
+            case '\b':
+                escape[1] = 'b';
+                break;
+            case '\f':
+                escape[1] = 'f';
+                break;
+            case '\n':
+                escape[1] = 'n';
+                break;
+            case '\r':
+                escape[1] = 'r';
+                break;
+            case '\t':
+                escape[1] = 't';
+                break;
+            default:
+                escape[1] = 'u';
+                escape[4] = '0' + (c >> 4);
+                escape[5] = "0123456789abcdef"[c & 0xF];
+                escapeLength = 6;
+        }
+        write(escape, escapeLength);
+        run = ++p;
+    }
+    write(run, p - run);
+}
+
+static void formatDigits9(char *target, uint32_t value) {
+    for (int i = 8; i >= 0; i--) {
+        target[i] = '0' + value % 10;
+        value /= 10;
+    }
+}
+
+size_t JSON::formatUInt32(char *target, uint32_t value) {
+    char digits[10];
+    size_t length = 0;
+    do {
+        digits[length++] = '0' + value % 10;
+        value /= 10;
+    } while (value);
+
+    for (size_t i = 0; i < length; i++) {
+        target[i] = digits[length - 1 - i];
+    }
+    return length;
+}
+
+size_t JSON::formatInt64(char *target, long long value) {
+    size_t length = 0;
+    unsigned long long magnitude = value;
+    if (value < 0) {
+        target[length++] = '-';
+        magnitude = 0 - magnitude;
+    }
+    if (magnitude <= UINT32_MAX) {
+        return length + formatUInt32(target + length, magnitude);
+    }
+
+    // Split off groups of 9 digits, so only the groups need 64 bit divisions
+    uint32_t low = magnitude % 1000000000;
+    magnitude /= 1000000000;
+    if (magnitude <= UINT32_MAX) {
+        length += formatUInt32(target + length, magnitude);
     } else {
-        pos += len;
+        uint32_t middle = magnitude % 1000000000;
+        length += formatUInt32(target + length, magnitude / 1000000000);
+        formatDigits9(target + length, middle);
+        length += 9;
+    }
+    formatDigits9(target + length, low);
+    return length + 9;
+}
+
+/**
+ * @brief Write the separator for a scalar value and advance the state
+ * 
+ * @return true Value can be written
+ * @return false Value is not allowed here
+ */
+bool JSON::beginValue() {
+    switch (state) {
+        case JSONStateStart:
+            state = JSONStateEnd;
+            return true;
+        case JSONStateArrayItem:
+            write(',');
+        case JSONStateArray:
+            state = JSONStateArrayItem;
+            return true;
+        case JSONStateObjectKey:
+            state = JSONStateObjectValue;
+            return true;
+        default:
+            state = JSONStateError;
+            return false;
     }
 }
 
@@ -51,11 +209,11 @@ void JSON::startObject() {
 
     switch (state) {
         case JSONStateArrayItem:
-            write(",");
+            write(',');
         case JSONStateStart:
         case JSONStateObjectKey:
         case JSONStateArray:
-            write("{");
+            write('{');
 
             state = JSONStateObject;
             nesting[nestingId++] = JSONNestingObject;
@@ -73,7 +231,7 @@ void JSON::endObject() {
     switch (state) {
         case JSONStateObject:
         case JSONStateObjectValue:
-            write("}");
+            write('}');
 
             nestingId--;
             if (!nestingId) {
@@ -101,11 +259,11 @@ void JSON::startArray() {
 
     switch (state) {
         case JSONStateArrayItem:
-            write(",");
+            write(',');
         case JSONStateStart:
         case JSONStateObjectKey:
         case JSONStateArray:
-            write("[");
+            write('[');
 
             state = JSONStateArray;
             nesting[nestingId++] = JSONNestingArray;
@@ -123,7 +281,7 @@ void JSON::endArray() {
     switch (state) {
         case JSONStateArray:
         case JSONStateArrayItem:
-            write("]");
+            write(']');
 
             nestingId--;
             if (!nestingId) {
@@ -145,140 +303,153 @@ void JSON::endArray() {
 }
 
 void JSON::setInt(long long value) {
-    if (state == JSONStateError) {
+    if (!beginValue()) {
         return;
     }
 
-    switch (state) {
-        case JSONStateStart:
-            write("%ld", value);
-            state = JSONStateEnd;
-            break;
-        case JSONStateArrayItem:
-            write(",");
-        case JSONStateArray:
-            write("%ld", value);
-
-            state = JSONStateArrayItem;
-            break;
-        case JSONStateObjectKey:
-            write("%ld", value);
+    char digits[20];
+    write(digits, formatInt64(digits, value));
+}
 
-            state = JSONStateObjectValue;
-            break;
-        default:
-            state = JSONStateError;
+void JSON::setFloat(float value, float step) {
+    if (!beginValue()) {
+        return;
     }
-}
 
-void JSON::setFloat(float value) {
-    if (state == JSONStateError) {
+    char digits[F2S_MAX_LENGTH];
+    size_t length = step > 0 ? f2s_format_step(digits, value, step) : f2s_format(digits, value);
+    if (length == 0) {
+        // NaN and infinity
+        write("null", 4);
         return;
     }
+    write(digits, length);
+}
 
-    switch (state) {
-        case JSONStateStart:
-            write("%1.15g", value);
-            state = JSONStateEnd;
-            break;
-        case JSONStateArrayItem:
-            write(",");
-        case JSONStateArray:
-            write("%1.15g", value);
+void JSON::setString(const char *value) {
+    setString(value, strlen(value));
+}
 
-            state = JSONStateArrayItem;
-            break;
-        case JSONStateObjectKey:
-            write("%1.15g", value);
+void JSON::setString(const char *value, size_t length) {
+    switch (state) {
+        case JSONStateObjectValue:
+            write(',');
+        case JSONStateObject:
+            write('"');
+            writeEscaped(value, length);
+            write("\":", 2);
 
-            state = JSONStateObjectValue;
+            state = JSONStateObjectKey;
             break;
         default:
-            state = JSONStateError;
+            if (beginValue()) {
+                write('"');
+                writeEscaped(value, length);
+                write('"');
+            }
     }
 }
 
-void JSON::setString(const char *value) {
-    if (state == JSONStateError) {
-        return;
-    }
-
+void JSON::setKey(const char *key, size_t length) {
     switch (state) {
-        case JSONStateStart:
-            write("\"%s\"", value);
-            state = JSONStateEnd;
-            break;
-        case JSONStateArrayItem:
-            write(",");
-        case JSONStateArray:
-            write("\"%s\"", value);
-
-            state = JSONStateArrayItem;
-            break;
         case JSONStateObjectValue:
-            write(",");
+            write(',');
         case JSONStateObject:
-            write("\"%s\"", value);
-            write(":");
+            write('"');
+            write(key, length);
+            write("\":", 2);
 
             state = JSONStateObjectKey;
             break;
-        case JSONStateObjectKey:
-            write("\"%s\"", value);
-
-            state = JSONStateObjectValue;
-            break;
         default:
             state = JSONStateError;
     }
 }
 
 void JSON::setBool(bool value) {
-    if (state == JSONStateError) {
+    if (!beginValue()) {
         return;
     }
 
-    switch (state) {
-        case JSONStateStart:
-            write((value) ? "true" : "false");
-            state = JSONStateEnd;
-            break;
-        case JSONStateArrayItem:
-            write(",");
-        case JSONStateArray:
-            write((value) ? "true" : "false");
+    if (value) {
+        write("true", 4);
+    } else {
+        write("false", 5);
+    }
+}
 
-            state = JSONStateArrayItem;
-            break;
-        case JSONStateObjectKey:
-            write((value) ? "true" : "false");
+void JSON::setNull() {
+    if (!beginValue()) {
+        return;
+    }
 
-            state = JSONStateObjectValue;
-            break;
-        default:
-            state = JSONStateError;
+    write("null", 4);
+}
+
+/**
+ * @brief Set a string with the upper case hex digits of value, as used for short HAP type UUIDs
+ * 
+ * @param value Value
+ */
+void JSON::setHexString(uint32_t value) {
+    char digits[8];
+    size_t length = 0;
+    do {
+        digits[sizeof(digits) - 1 - length++] = "0123456789ABCDEF"[value & 0xF];
+        value >>= 4;
+    } while (value);
+    setString(digits + sizeof(digits) - length, length);
+}
+
+/**
+ * @brief Set a base64 string, as used for TLV8 and data values
+ * 
+ * The data is encoded straight into the buffer, so large values are streamed out in buffer sized chunks.
+ */
+void JSON::setBase64(const uint8_t *data, size_t length) {
+    if (!beginValue()) {
+        return;
     }
+
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    write('"');
+    while (length >= 3) {
+        uint32_t group = data[0] << 16 | data[1] << 8 | data[2];
+        char quad[4] = {alphabet[group >> 18], alphabet[(group >> 12) & 0x3F], alphabet[(group >> 6) & 0x3F], alphabet[group & 0x3F]};
+        if (size - pos >= sizeof(quad)) {
+            memcpy(buffer + pos, quad, sizeof(quad));
+            pos += sizeof(quad);
+        } else {
+            // Splits the quad over flushes, also for buffers smaller than 4 bytes
+            write(quad, sizeof(quad));
+        }
+        data += 3;
+        length -= 3;
+    }
+    if (length > 0) {
+        uint32_t group = data[0] << 16 | (length > 1 ? data[1] << 8 : 0);
+        char tail[4] = {alphabet[group >> 18], alphabet[(group >> 12) & 0x3F], length > 1 ? alphabet[(group >> 6) & 0x3F] : '=', '='};
+        write(tail, sizeof(tail));
+    }
+    write('"');
 }
 
-void JSON::setNull() {
-    if (state == JSONStateError) {
+/**
+ * @brief Add a pre-rendered "key":value fragment from flash to the current object
+ * 
+ * @param fragment Null terminated fragment in PROGMEM, nothing is written if it is empty
+ */
+void JSON::setFragment_P(PGM_P fragment) {
+    size_t length = strlen_P(fragment);
+    if (length == 0) {
         return;
     }
 
     switch (state) {
-        case JSONStateStart:
-            write("null");
-            state = JSONStateEnd;
-            break;
-        case JSONStateArrayItem:
-            write(",");
-        case JSONStateArray:
-            write("null");
-
-            state = JSONStateArrayItem;
-            break;
-        case JSONStateObjectKey:
-            write("null");
+        case JSONStateObjectValue:
+            write(',');
+        case JSONStateObject:
+            write_P(fragment, length);
 
             state = JSONStateObjectValue;
             break;
@@ -8,6 +8,8 @@
 #include <Arduino.h>
 #include <ESP8266WebServer.h>
 
+#include "f2s.h"
+
 #define JSON_MAX_DEPTH 30
 #define MAX(a, b) (((a) > (b)) ? (a) : (b))
 
@@ -38,13 +40,31 @@ public:
     void endArray();
 
     void setInt(long long value);
-    void setFloat(float value);
+    void setFloat(float value, float step = 0);
     void setString(const char *value);
+    void setString(const char *value, size_t length);
     void setBool(bool value);
     void setNull();
+    void setHexString(uint32_t value);
+    void setBase64(const uint8_t *data, size_t length);
+    void setFragment_P(PGM_P fragment);
+
+    /**
+     * @brief Set an object key given as string literal, the length is known at compile time and it is written
+     * without escaping
+     */
+    template<size_t N>
+    inline void setKey(const char (&key)[N]) { setKey(key, N - 1); }
+    void setKey(const char *key, size_t length);
 
+    static size_t formatUInt32(char *target, uint32_t value);
+    static size_t formatInt64(char *target, long long value);
 private:
-    void write(const char *format, ...);
+    bool beginValue();
+    void write(const char *data, size_t length);
+    void write_P(PGM_P data, size_t length);
+    void writeEscaped(const char *value, size_t length);
+    void write(char c);
 private:
     uint8_t *buffer;
     size_t size;
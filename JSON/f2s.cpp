@@ -0,0 +1,342 @@
+//
+// Shortest round-trip formatting of 32 bit floats, based on Ryu by Ulf Adams (Apache 2.0 / Boost 1.0)
+//
+// f2s_decimal() finds the shortest decimal that still parses back to the same float, picking the
+// closest one if there are several. Only 32x64 bit multiplications are needed, no floating point
+// math and no 64 bit divisions, which matters on the soft-float ESP8266.
+//
+
+#include "f2s.h"
+
+#define FLOAT_MANTISSA_BITS 23
+#define FLOAT_EXPONENT_BITS 8
+#define FLOAT_BIAS 127
+
+#define FLOAT_POW5_INV_BITCOUNT 59
+#define FLOAT_POW5_BITCOUNT 61
+
+// FLOAT_POW5_INV_SPLIT[i] = floor(2^(pow5bits(i) - 1 + 59) / 5^i) + 1
+// FLOAT_POW5_SPLIT[i] = 5^i with its highest 61 bits
+static const uint64_t FLOAT_POW5_INV_SPLIT[31] PROGMEM = {
+    576460752303423489u, 461168601842738791u, 368934881474191033u,
+    295147905179352826u, 472236648286964522u, 377789318629571618u,
+    302231454903657294u, 483570327845851670u, 386856262276681336u,
+    309485009821345069u, 495176015714152110u, 396140812571321688u,
+    316912650057057351u, 507060240091291761u, 405648192073033409u,
+    324518553658426727u, 519229685853482763u, 415383748682786211u,
+    332306998946228969u, 531691198313966350u, 425352958651173080u,
+    340282366920938464u, 544451787073501542u, 435561429658801234u,
+    348449143727040987u, 557518629963265579u, 446014903970612463u,
+    356811923176489971u, 570899077082383953u, 456719261665907162u,
+    365375409332725730u,
+};
+
+static const uint64_t FLOAT_POW5_SPLIT[48] PROGMEM = {
+    1152921504606846976u, 1441151880758558720u, 1801439850948198400u,
+    2251799813685248000u, 1407374883553280000u, 1759218604441600000u,
+    2199023255552000000u, 1374389534720000000u, 1717986918400000000u,
+    2147483648000000000u, 1342177280000000000u, 1677721600000000000u,
+    2097152000000000000u, 1310720000000000000u, 1638400000000000000u,
+    2048000000000000000u, 1280000000000000000u, 1600000000000000000u,
+    2000000000000000000u, 1250000000000000000u, 1562500000000000000u,
+    1953125000000000000u, 1220703125000000000u, 1525878906250000000u,
+    1907348632812500000u, 1192092895507812500u, 1490116119384765625u,
+    1862645149230957031u, 1164153218269348144u, 1455191522836685180u,
+    1818989403545856475u, 2273736754432320594u, 1421085471520200371u,
+    1776356839400250464u, 2220446049250313080u, 1387778780781445675u,
+    1734723475976807094u, 2168404344971008868u, 1355252715606880542u,
+    1694065894508600678u, 2117582368135750847u, 1323488980084844279u,
+    1654361225106055349u, 2067951531382569187u, 1292469707114105741u,
+    1615587133892632177u, 2019483917365790221u, 1262177448353618888u,
+};
+
+static inline uint32_t pow5bits(int32_t e) {
+    // ceil(log2(5^e)) for e > 0
+    return (uint32_t) (((e * 1217359) >> 19) + 1);
+}
+
+static inline uint32_t log10Pow2(int32_t e) {
+    return (uint32_t) ((e * 78913) >> 18);
+}
+
+static inline uint32_t log10Pow5(int32_t e) {
+    return (uint32_t) ((e * 732923) >> 20);
+}
+
+static inline uint32_t pow5Factor(uint32_t value) {
+    uint32_t count = 0;
+    while (value % 5 == 0) {
+        value /= 5;
+        count++;
+    }
+    return count;
+}
+
+static inline bool multipleOfPowerOf5(uint32_t value, uint32_t p) {
+    return pow5Factor(value) >= p;
+}
+
+static inline bool multipleOfPowerOf2(uint32_t value, uint32_t p) {
+    return (value & ((1u << p) - 1)) == 0;
+}
+
+static inline bool isFinite(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return ((bits >> FLOAT_MANTISSA_BITS) & ((1u << FLOAT_EXPONENT_BITS) - 1)) != (1u << FLOAT_EXPONENT_BITS) - 1;
+}
+
+static inline uint32_t mulShift(uint32_t m, const uint64_t *table, uint32_t index, int32_t shift) {
+    uint64_t factor;
+    memcpy_P(&factor, &table[index], sizeof(factor));
+    uint64_t bits0 = (uint64_t) m * (uint32_t) factor;
+    uint64_t bits1 = (uint64_t) m * (uint32_t) (factor >> 32);
+    uint64_t sum = (bits0 >> 32) + bits1;
+    return (uint32_t) (sum >> (shift - 32));
+}
+
+/**
+ * @brief Shortest decimal representation of a positive, finite, non zero float
+ * 
+ * @param value Float
+ * @return FloatDecimal Digits and decimal exponent
+ */
+FloatDecimal f2s_decimal(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint32_t ieeeMantissa = bits & ((1u << FLOAT_MANTISSA_BITS) - 1);
+    uint32_t ieeeExponent = (bits >> FLOAT_MANTISSA_BITS) & ((1u << FLOAT_EXPONENT_BITS) - 1);
+
+    int32_t e2;
+    uint32_t m2;
+    if (ieeeExponent == 0) {
+        e2 = 1 - FLOAT_BIAS - FLOAT_MANTISSA_BITS - 2;
+        m2 = ieeeMantissa;
+    } else {
+        e2 = (int32_t) ieeeExponent - FLOAT_BIAS - FLOAT_MANTISSA_BITS - 2;
+        m2 = (1u << FLOAT_MANTISSA_BITS) | ieeeMantissa;
+    }
+    bool acceptBounds = (m2 & 1) == 0;
+
+    // Interval of values that round to this float, scaled by 4
+    uint32_t mv = 4 * m2;
+    uint32_t mp = 4 * m2 + 2;
+    uint32_t mmShift = ieeeMantissa != 0 || ieeeExponent <= 1;
+    uint32_t mm = 4 * m2 - 1 - mmShift;
+
+    // Convert the interval to a decimal power base
+    uint32_t vr, vp, vm;
+    int32_t e10;
+    bool vmIsTrailingZeros = false;
+    bool vrIsTrailingZeros = false;
+    uint8_t lastRemovedDigit = 0;
+    if (e2 >= 0) {
+        uint32_t q = log10Pow2(e2);
+        e10 = (int32_t) q;
+        int32_t k = FLOAT_POW5_INV_BITCOUNT + pow5bits(q) - 1;
+        int32_t i = -e2 + (int32_t) q + k;
+        vr = mulShift(mv, FLOAT_POW5_INV_SPLIT, q, i);
+        vp = mulShift(mp, FLOAT_POW5_INV_SPLIT, q, i);
+        vm = mulShift(mm, FLOAT_POW5_INV_SPLIT, q, i);
+        if (q != 0 && (vp - 1) / 10 <= vm / 10) {
+            // One removed digit is needed even if the loop below does not run
+            int32_t l = FLOAT_POW5_INV_BITCOUNT + pow5bits(q - 1) - 1;
+            lastRemovedDigit = (uint8_t) (mulShift(mv, FLOAT_POW5_INV_SPLIT, q - 1, -e2 + (int32_t) q - 1 + l) % 10);
+        }
+        if (q <= 9) {
+            // Only one of mp, mv and mm can be a multiple of 5
+            if (mv % 5 == 0) {
+                vrIsTrailingZeros = multipleOfPowerOf5(mv, q);
+            } else if (acceptBounds) {
+                vmIsTrailingZeros = multipleOfPowerOf5(mm, q);
+            } else {
+                vp -= multipleOfPowerOf5(mp, q);
+            }
+        }
+    } else {
+        uint32_t q = log10Pow5(-e2);
+        e10 = (int32_t) q + e2;
+        int32_t i = -e2 - (int32_t) q;
+        int32_t k = pow5bits(i) - FLOAT_POW5_BITCOUNT;
+        int32_t j = (int32_t) q - k;
+        vr = mulShift(mv, FLOAT_POW5_SPLIT, i, j);
+        vp = mulShift(mp, FLOAT_POW5_SPLIT, i, j);
+        vm = mulShift(mm, FLOAT_POW5_SPLIT, i, j);
+        if (q != 0 && (vp - 1) / 10 <= vm / 10) {
+            j = (int32_t) q - 1 - (pow5bits(i + 1) - FLOAT_POW5_BITCOUNT);
+            lastRemovedDigit = (uint8_t) (mulShift(mv, FLOAT_POW5_SPLIT, i + 1, j) % 10);
+        }
+        if (q <= 1) {
+            // mv = 4 * m2 always has at least two trailing zero bits
+            vrIsTrailingZeros = true;
+            if (acceptBounds) {
+                vmIsTrailingZeros = mmShift == 1;
+            } else {
+                vp--;
+            }
+        } else if (q < 31) {
+            vrIsTrailingZeros = multipleOfPowerOf2(mv, q - 1);
+        }
+    }
+
+    // Remove digits as long as the interval still contains a shorter decimal
+    int32_t removed = 0;
+    uint32_t output;
+    if (vmIsTrailingZeros || vrIsTrailingZeros) {
+        while (vp / 10 > vm / 10) {
+            vmIsTrailingZeros &= vm % 10 == 0;
+            vrIsTrailingZeros &= lastRemovedDigit == 0;
+            lastRemovedDigit = (uint8_t) (vr % 10);
+            vr /= 10;
+            vp /= 10;
+            vm /= 10;
+            removed++;
+        }
+        if (vmIsTrailingZeros) {
+            while (vm % 10 == 0) {
+                vrIsTrailingZeros &= lastRemovedDigit == 0;
+                lastRemovedDigit = (uint8_t) (vr % 10);
+                vr /= 10;
+                vp /= 10;
+                vm /= 10;
+                removed++;
+            }
+        }
+        if (vrIsTrailingZeros && lastRemovedDigit == 5 && vr % 2 == 0) {
+            // Round to even if the exact value is ...50..0
+            lastRemovedDigit = 4;
+        }
+        output = vr + ((vr == vm && (!acceptBounds || !vmIsTrailingZeros)) || lastRemovedDigit >= 5);
+    } else {
+        while (vp / 10 > vm / 10) {
+            lastRemovedDigit = (uint8_t) (vr % 10);
+            vr /= 10;
+            vp /= 10;
+            vm /= 10;
+            removed++;
+        }
+        output = vr + (vr == vm || lastRemovedDigit >= 5);
+    }
+
+    FloatDecimal result;
+    result.mantissa = output;
+    result.exponent = e10 + removed;
+    return result;
+}
+
+/**
+ * @brief Print a decimal like JavaScript numbers: plain up to 21 integer digits and down to 1e-6,
+ * scientific otherwise
+ */
+static size_t formatDecimal(char *target, bool negative, uint32_t mantissa, int32_t exponent) {
+    char digits[10];
+    int32_t length = 0;
+    do {
+        digits[length++] = '0' + mantissa % 10;
+        mantissa /= 10;
+    } while (mantissa);
+
+    size_t pos = 0;
+    if (negative) {
+        target[pos++] = '-';
+    }
+
+    int32_t point = length + exponent;
+    if (point > 0 && point <= 21) {
+        for (int32_t i = 0; i < length; i++) {
+            if (i == point) {
+                target[pos++] = '.';
+            }
+            target[pos++] = digits[length - 1 - i];
+        }
+        for (int32_t i = length; i < point; i++) {
+            target[pos++] = '0';
+        }
+    } else if (point > -6 && point <= 0) {
+        target[pos++] = '0';
+        target[pos++] = '.';
+        for (int32_t i = point; i < 0; i++) {
+            target[pos++] = '0';
+        }
+        for (int32_t i = 0; i < length; i++) {
+            target[pos++] = digits[length - 1 - i];
+        }
+    } else {
+        target[pos++] = digits[length - 1];
+        if (length > 1) {
+            target[pos++] = '.';
+            for (int32_t i = 1; i < length; i++) {
+                target[pos++] = digits[length - 1 - i];
+            }
+        }
+        int32_t scientific = point - 1;
+        target[pos++] = 'e';
+        target[pos++] = scientific < 0 ? '-' : '+';
+        if (scientific < 0) {
+            scientific = -scientific;
+        }
+        if (scientific >= 10) {
+            target[pos++] = '0' + scientific / 10;
+        }
+        target[pos++] = '0' + scientific % 10;
+    }
+    return pos;
+}
+
+/**
+ * @brief Shortest text that parses back to the same float
+ * 
+ * @param target Buffer with at least F2S_MAX_LENGTH bytes, not null terminated
+ * @param value Float
+ * @return size_t Length, 0 for NaN and infinity which have no JSON representation
+ */
+size_t f2s_format(char *target, float value) {
+    if (!isFinite(value)) {
+        return 0;
+    }
+    if (value == 0) {
+        target[0] = '0';
+        return 1;
+    }
+    FloatDecimal decimal = f2s_decimal(fabsf(value));
+    return formatDecimal(target, value < 0, decimal.mantissa, decimal.exponent);
+}
+
+/**
+ * @brief Round to a multiple of step and print it with the decimals of step
+ * 
+ * The multiple is built in decimal, so 21.4999 with step 0.1 prints as 21.5 and not as 21.500000953674316.
+ * Falls back to f2s_format() if step is not positive or the value is too large for the step.
+ * 
+ * @param target Buffer with at least F2S_MAX_LENGTH bytes, not null terminated
+ * @param value Float
+ * @param step Step, e.g. minStep of a characteristic
+ * @return size_t Length, 0 for NaN and infinity
+ */
+size_t f2s_format_step(char *target, float value, float step) {
+    if (!(step > 0) || !isFinite(step) || !isFinite(value)) {
+        return f2s_format(target, value);
+    }
+
+    float steps = roundf(value / step);
+    if (fabsf(steps) > (1 << 24)) {
+        return f2s_format(target, value);
+    }
+
+    FloatDecimal decimal = f2s_decimal(step);
+    uint64_t mantissa = (uint64_t) fabsf(steps) * decimal.mantissa;
+    if (mantissa == 0) {
+        target[0] = '0';
+        return 1;
+    }
+    if (mantissa > UINT32_MAX) {
+        return f2s_format(target, value);
+    }
+
+    int32_t exponent = decimal.exponent;
+    while (mantissa % 10 == 0) {
+        mantissa /= 10;
+        exponent++;
+    }
+    return formatDecimal(target, steps < 0, (uint32_t) mantissa, exponent);
+}
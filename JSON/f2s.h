@@ -0,0 +1,22 @@
+//
+// Shortest round-trip formatting of 32 bit floats, based on Ryu by Ulf Adams (Apache 2.0 / Boost 1.0)
+//
+
+#ifndef HAP_SERVER_F2S_H
+#define HAP_SERVER_F2S_H
+
+#include <Arduino.h>
+
+// Longest output of f2s_format(), e.g. "-123456789000000000000"
+#define F2S_MAX_LENGTH 24
+
+struct FloatDecimal {
+    uint32_t mantissa;
+    int32_t exponent;   // value = mantissa * 10^exponent
+};
+
+FloatDecimal f2s_decimal(float value);
+size_t f2s_format(char *target, float value);
+size_t f2s_format_step(char *target, float value, float step);
+
+#endif //HAP_SERVER_F2S_H
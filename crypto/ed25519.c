@@ -0,0 +1,407 @@
+/*
+ * ed25519.c
+ *
+ * Ed25519 signature verification (RFC 8032) on top of the field backend
+ * selected in fe25519.h.
+ *
+ * R' = s * B - h * A is computed with a single Straus/Shamir double-scalar
+ * multiplication: both scalars are recoded into sliding windows of odd
+ * digits in [-15, 15], so the loop shares one doubling per bit and adds
+ * roughly one point every six bits per scalar. The odd multiples of the
+ * base point live in flash as precomputed (y + x, y - x, 2dxy) triples;
+ * the odd multiples of -A are computed per call on the heap to keep the
+ * stack of the ESP8266 small.
+ *
+ * The formulas and bounds follow the ref10 implementation by Daniel
+ * J. Bernstein, Niels Duif, Tanja Lange, Peter Schwabe and Bo-Yin Yang.
+ */
+
+#include <stdlib.h>
+#include <pgmspace.h>
+
+#include "fe25519.h"
+#include "tweetnacl.h"
+
+typedef struct {
+  fe25519 X;
+  fe25519 Y;
+  fe25519 Z;
+} ge_p2;
+
+typedef struct {
+  fe25519 X;
+  fe25519 Y;
+  fe25519 Z;
+  fe25519 T;
+} ge_p3;
+
+typedef struct {
+  fe25519 X;
+  fe25519 Y;
+  fe25519 Z;
+  fe25519 T;
+} ge_p1p1;
+
+typedef struct {
+  fe25519 YplusX;
+  fe25519 YminusX;
+  fe25519 Z;
+  fe25519 T2d;
+} ge_cached;
+
+typedef struct {
+  fe25519 yplusx;
+  fe25519 yminusx;
+  fe25519 xy2d;
+} ge_precomp;
+
+static const unsigned char ed25519_d[32] = {
+  0xa3, 0x78, 0x59, 0x13, 0xca, 0x4d, 0xeb, 0x75, 0xab, 0xd8, 0x41, 0x41, 0x4d, 0x0a, 0x70, 0x00, 0x98, 0xe8, 0x79, 0x77, 0x79, 0x40, 0xc7, 0x8c, 0x73, 0xfe, 0x6f, 0x2b, 0xee, 0x6c, 0x03, 0x52
+};
+
+static const unsigned char ed25519_d2[32] = {
+  0x59, 0xf1, 0xb2, 0x26, 0x94, 0x9b, 0xd6, 0xeb, 0x56, 0xb1, 0x83, 0x82, 0x9a, 0x14, 0xe0, 0x00, 0x30, 0xd1, 0xf3, 0xee, 0xf2, 0x80, 0x8e, 0x19, 0xe7, 0xfc, 0xdf, 0x56, 0xdc, 0xd9, 0x06, 0x24
+};
+
+static const unsigned char ed25519_sqrtm1[32] = {
+  0xb0, 0xa0, 0x0e, 0x4a, 0x27, 0x1b, 0xee, 0xc4, 0x78, 0xe4, 0x2f, 0xad, 0x06, 0x18, 0x43, 0x2f, 0xa7, 0xd7, 0xfb, 0x3d, 0x99, 0x00, 0x4d, 0x2b, 0x0b, 0xdf, 0xc1, 0x4f, 0x80, 0x24, 0x83, 0x2b
+};
+
+/* Order of the base point, little endian */
+static const unsigned char ed25519_l[32] = {
+  0xed, 0xd3, 0xf5, 0x5c, 0x1a, 0x63, 0x12, 0x58, 0xd6, 0x9c, 0xf7, 0xa2, 0xde, 0xf9, 0xde, 0x14,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10
+};
+
+/* B, 3B, 5B, ..., 15B as canonical encodings of (y + x, y - x, 2dxy) */
+static const unsigned char ed25519_base_odd_multiples[8][3][32] PROGMEM = {
+  {
+    {0x85, 0x3b, 0x8c, 0xf5, 0xc6, 0x93, 0xbc, 0x2f, 0x19, 0x0e, 0x8c, 0xfb, 0xc6, 0x2d, 0x93, 0xcf, 0xc2, 0x42, 0x3d, 0x64, 0x98, 0x48, 0x0b, 0x27, 0x65, 0xba, 0xd4, 0x33, 0x3a, 0x9d, 0xcf, 0x07},
+    {0x3e, 0x91, 0x40, 0xd7, 0x05, 0x39, 0x10, 0x9d, 0xb3, 0xbe, 0x40, 0xd1, 0x05, 0x9f, 0x39, 0xfd, 0x09, 0x8a, 0x8f, 0x68, 0x34, 0x84, 0xc1, 0xa5, 0x67, 0x12, 0xf8, 0x98, 0x92, 0x2f, 0xfd, 0x44},
+    {0x68, 0xaa, 0x7a, 0x87, 0x05, 0x12, 0xc9, 0xab, 0x9e, 0xc4, 0xaa, 0xcc, 0x23, 0xe8, 0xd9, 0x26, 0x8c, 0x59, 0x43, 0xdd, 0xcb, 0x7d, 0x1b, 0x5a, 0xa8, 0x65, 0x0c, 0x9f, 0x68, 0x7b, 0x11, 0x6f},
+  },
+  {
+    {0x30, 0x97, 0xee, 0x4c, 0xa8, 0xb0, 0x25, 0xaf, 0x8a, 0x4b, 0x86, 0xe8, 0x30, 0x84, 0x5a, 0x02, 0x32, 0x67, 0x01, 0x9f, 0x02, 0x50, 0x1b, 0xc1, 0xf4, 0xf8, 0x80, 0x9a, 0x1b, 0x4e, 0x16, 0x7a},
+    {0x65, 0xd2, 0xfc, 0xa4, 0xe8, 0x1f, 0x61, 0x56, 0x7d, 0xba, 0xc1, 0xe5, 0xfd, 0x53, 0xd3, 0x3b, 0xbd, 0xd6, 0x4b, 0x21, 0x1a, 0xf3, 0x31, 0x81, 0x62, 0xda, 0x5b, 0x55, 0x87, 0x15, 0xb9, 0x2a},
+    {0x89, 0xd8, 0xd0, 0x0d, 0x3f, 0x93, 0xae, 0x14, 0x62, 0xda, 0x35, 0x1c, 0x22, 0x23, 0x94, 0x58, 0x4c, 0xdb, 0xf2, 0x8c, 0x45, 0xe5, 0x70, 0xd1, 0xc6, 0xb4, 0xb9, 0x12, 0xaf, 0x26, 0x28, 0x5a},
+  },
+  {
+    {0x33, 0xbb, 0xa5, 0x08, 0x44, 0xbc, 0x12, 0xa2, 0x02, 0xed, 0x5e, 0xc7, 0xc3, 0x48, 0x50, 0x8d, 0x44, 0xec, 0xbf, 0x5a, 0x0c, 0xeb, 0x1b, 0xdd, 0xeb, 0x06, 0xe2, 0x46, 0xf1, 0xcc, 0x45, 0x29},
+    {0xba, 0xd6, 0x47, 0xa4, 0xc3, 0x82, 0x91, 0x7f, 0xb7, 0x29, 0x27, 0x4b, 0xd1, 0x14, 0x00, 0xd5, 0x87, 0xa0, 0x64, 0xb8, 0x1c, 0xf1, 0x3c, 0xe3, 0xf3, 0x55, 0x1b, 0xeb, 0x73, 0x7e, 0x4a, 0x15},
+    {0x85, 0x82, 0x2a, 0x81, 0xf1, 0xdb, 0xbb, 0xbc, 0xfc, 0xd1, 0xbd, 0xd0, 0x07, 0x08, 0x0e, 0x27, 0x2d, 0xa7, 0xbd, 0x1b, 0x0b, 0x67, 0x1b, 0xb4, 0x9a, 0xb6, 0x3b, 0x6b, 0x69, 0xbe, 0xaa, 0x43},
+  },
+  {
+    {0xbf, 0xa3, 0x4e, 0x94, 0xd0, 0x5c, 0x1a, 0x6b, 0xd2, 0xc0, 0x9d, 0xb3, 0x3a, 0x35, 0x70, 0x74, 0x49, 0x2e, 0x54, 0x28, 0x82, 0x52, 0xb2, 0x71, 0x7e, 0x92, 0x3c, 0x28, 0x69, 0xea, 0x1b, 0x46},
+    {0xb1, 0x21, 0x32, 0xaa, 0x9a, 0x2c, 0x6f, 0xba, 0xa7, 0x23, 0xba, 0x3b, 0x53, 0x21, 0xa0, 0x6c, 0x3a, 0x2c, 0x19, 0x92, 0x4f, 0x76, 0xea, 0x9d, 0xe0, 0x17, 0x53, 0x2e, 0x5d, 0xdd, 0x6e, 0x1d},
+    {0xa2, 0xb3, 0xb8, 0x01, 0xc8, 0x6d, 0x83, 0xf1, 0x9a, 0xa4, 0x3e, 0x05, 0x47, 0x5f, 0x03, 0xb3, 0xf3, 0xad, 0x77, 0x58, 0xba, 0x41, 0x9c, 0x52, 0xa7, 0x90, 0x0f, 0x6a, 0x1c, 0xbb, 0x9f, 0x7a},
+  },
+  {
+    {0x2f, 0x63, 0xa8, 0xa6, 0x8a, 0x67, 0x2e, 0x9b, 0xc5, 0x46, 0xbc, 0x51, 0x6f, 0x9e, 0x50, 0xa6, 0xb5, 0xf5, 0x86, 0xc6, 0xc9, 0x33, 0xb2, 0xce, 0x59, 0x7f, 0xdd, 0x8a, 0x33, 0xed, 0xb9, 0x34},
+    {0x64, 0x80, 0x9d, 0x03, 0x7e, 0x21, 0x6e, 0xf3, 0x9b, 0x41, 0x20, 0xf5, 0xb6, 0x81, 0xa0, 0x98, 0x44, 0xb0, 0x5e, 0xe7, 0x08, 0xc6, 0xcb, 0x96, 0x8f, 0x9c, 0xdc, 0xfa, 0x51, 0x5a, 0xc0, 0x49},
+    {0x1b, 0xaf, 0x45, 0x90, 0xbf, 0xe8, 0xb4, 0x06, 0x2f, 0xd2, 0x19, 0xa7, 0xe8, 0x83, 0xff, 0xe2, 0x16, 0xcf, 0xd4, 0x93, 0x29, 0xfc, 0xf6, 0xaa, 0x06, 0x8b, 0x00, 0x1b, 0x02, 0x72, 0xc1, 0x73},
+  },
+  {
+    {0xde, 0x2a, 0x80, 0x8a, 0x84, 0x00, 0xbf, 0x2f, 0x27, 0x2e, 0x30, 0x02, 0xcf, 0xfe, 0xd9, 0xe5, 0x06, 0x34, 0x70, 0x17, 0x71, 0x84, 0x3e, 0x11, 0xaf, 0x8f, 0x6d, 0x54, 0xe2, 0xaa, 0x75, 0x42},
+    {0x48, 0x43, 0x86, 0x49, 0x02, 0x5b, 0x5f, 0x31, 0x81, 0x83, 0x08, 0x77, 0x69, 0xb3, 0xd6, 0x3e, 0x95, 0xeb, 0x8d, 0x6a, 0x55, 0x75, 0xa0, 0xa3, 0x7f, 0xc7, 0xd5, 0x29, 0x80, 0x59, 0xab, 0x18},
+    {0xe9, 0x89, 0x60, 0xfd, 0xc5, 0x2c, 0x2b, 0xd8, 0xa4, 0xe4, 0x82, 0x32, 0xa1, 0xb4, 0x1e, 0x03, 0x22, 0x86, 0x1a, 0xb5, 0x99, 0x11, 0x31, 0x44, 0x48, 0xf9, 0x3d, 0xb5, 0x22, 0x55, 0xc6, 0x3d},
+  },
+  {
+    {0x6d, 0x7f, 0x00, 0xa2, 0x22, 0xc2, 0x70, 0xbf, 0xdb, 0xde, 0xbc, 0xb5, 0x9a, 0xb3, 0x84, 0xbf, 0x07, 0xba, 0x07, 0xfb, 0x12, 0x0e, 0x7a, 0x53, 0x41, 0xf2, 0x46, 0xc3, 0xee, 0xd7, 0x4f, 0x23},
+    {0x93, 0xbf, 0x7f, 0x32, 0x3b, 0x01, 0x6f, 0x50, 0x6b, 0x6f, 0x77, 0x9b, 0xc9, 0xeb, 0xfc, 0xae, 0x68, 0x59, 0xad, 0xaa, 0x32, 0xb2, 0x12, 0x9d, 0xa7, 0x24, 0x60, 0x17, 0x2d, 0x88, 0x67, 0x02},
+    {0x78, 0xa3, 0x2e, 0x73, 0x19, 0xa1, 0x60, 0x53, 0x71, 0xd4, 0x8d, 0xdf, 0xb1, 0xe6, 0x37, 0x24, 0x33, 0xe5, 0xa7, 0x91, 0xf8, 0x37, 0xef, 0xa2, 0x63, 0x78, 0x09, 0xaa, 0xfd, 0xa6, 0x7b, 0x49},
+  },
+  {
+    {0xa0, 0xea, 0xcf, 0x13, 0x03, 0xcc, 0xce, 0x24, 0x6d, 0x24, 0x9c, 0x18, 0x8d, 0xc2, 0x48, 0x86, 0xd0, 0xd4, 0xf2, 0xc1, 0xfa, 0xbd, 0xbd, 0x2d, 0x2b, 0xe7, 0x2d, 0xf1, 0x17, 0x29, 0xe2, 0x61},
+    {0x0b, 0xcf, 0x8c, 0x46, 0x86, 0xcd, 0x0b, 0x04, 0xd6, 0x10, 0x99, 0x2a, 0xa4, 0x9b, 0x82, 0xd3, 0x92, 0x51, 0xb2, 0x07, 0x08, 0x30, 0x08, 0x75, 0xbf, 0x5e, 0xd0, 0x18, 0x42, 0xcd, 0xb5, 0x43},
+    {0x16, 0xb5, 0xd0, 0x9b, 0x2f, 0x76, 0x9a, 0x5d, 0xee, 0xde, 0x3f, 0x37, 0x4e, 0xaf, 0x38, 0xeb, 0x70, 0x42, 0xd6, 0x93, 0x7d, 0x5a, 0x2e, 0x03, 0x42, 0xd8, 0xe4, 0x0a, 0x21, 0x61, 0x1d, 0x51},
+  },
+};
+
+static void ge_p2_0(ge_p2 *h)
+{
+  fe25519_0(h->X);
+  fe25519_1(h->Y);
+  fe25519_1(h->Z);
+}
+
+static void ge_p1p1_to_p2(ge_p2 *r, const ge_p1p1 *p)
+{
+  fe25519_mul(r->X, p->X, p->T);
+  fe25519_mul(r->Y, p->Y, p->Z);
+  fe25519_mul(r->Z, p->Z, p->T);
+}
+
+static void ge_p1p1_to_p3(ge_p3 *r, const ge_p1p1 *p)
+{
+  fe25519_mul(r->X, p->X, p->T);
+  fe25519_mul(r->Y, p->Y, p->Z);
+  fe25519_mul(r->Z, p->Z, p->T);
+  fe25519_mul(r->T, p->X, p->Y);
+}
+
+static void ge_p3_to_cached(ge_cached *r, const ge_p3 *p)
+{
+  fe25519 d2;
+  fe25519_frombytes(d2, ed25519_d2);
+  fe25519_add(r->YplusX, p->Y, p->X);
+  fe25519_sub(r->YminusX, p->Y, p->X);
+  fe25519_copy(r->Z, p->Z);
+  fe25519_mul(r->T2d, p->T, d2);
+}
+
+/* r = 2 * p */
+static void ge_p2_dbl(ge_p1p1 *r, const ge_p2 *p)
+{
+  fe25519 t0;
+  fe25519_sq(r->X, p->X);
+  fe25519_sq(r->Z, p->Y);
+  fe25519_sq2(r->T, p->Z);
+  fe25519_add(r->Y, p->X, p->Y);
+  fe25519_sq(t0, r->Y);
+  fe25519_add(r->Y, r->Z, r->X);
+  fe25519_sub(r->Z, r->Z, r->X);
+  fe25519_sub(r->X, t0, r->Y);
+  fe25519_sub(r->T, r->T, r->Z);
+}
+
+static void ge_p3_dbl(ge_p1p1 *r, const ge_p3 *p)
+{
+  ge_p2 q;
+  fe25519_copy(q.X, p->X);
+  fe25519_copy(q.Y, p->Y);
+  fe25519_copy(q.Z, p->Z);
+  ge_p2_dbl(r, &q);
+}
+
+/* r = p + q, or p - q when negate is set */
+static void ge_add(ge_p1p1 *r, const ge_p3 *p, const ge_cached *q, int negate)
+{
+  fe25519 t0;
+  fe25519_add(r->X, p->Y, p->X);
+  fe25519_sub(r->Y, p->Y, p->X);
+  fe25519_mul(r->Z, r->X, negate ? q->YminusX : q->YplusX);
+  fe25519_mul(r->Y, r->Y, negate ? q->YplusX : q->YminusX);
+  fe25519_mul(r->T, q->T2d, p->T);
+  fe25519_mul(r->X, p->Z, q->Z);
+  fe25519_add(t0, r->X, r->X);
+  fe25519_sub(r->X, r->Z, r->Y);
+  fe25519_add(r->Y, r->Z, r->Y);
+  if (negate) {
+    fe25519_sub(r->Z, t0, r->T);
+    fe25519_add(r->T, t0, r->T);
+  } else {
+    fe25519_add(r->Z, t0, r->T);
+    fe25519_sub(r->T, t0, r->T);
+  }
+}
+
+/* r = p + q, or p - q when negate is set, for an affine precomputed q */
+static void ge_madd(ge_p1p1 *r, const ge_p3 *p, const ge_precomp *q, int negate)
+{
+  fe25519 t0;
+  fe25519_add(r->X, p->Y, p->X);
+  fe25519_sub(r->Y, p->Y, p->X);
+  fe25519_mul(r->Z, r->X, negate ? q->yminusx : q->yplusx);
+  fe25519_mul(r->Y, r->Y, negate ? q->yplusx : q->yminusx);
+  fe25519_mul(r->T, q->xy2d, p->T);
+  fe25519_add(t0, p->Z, p->Z);
+  fe25519_sub(r->X, r->Z, r->Y);
+  fe25519_add(r->Y, r->Z, r->Y);
+  if (negate) {
+    fe25519_sub(r->Z, t0, r->T);
+    fe25519_add(r->T, t0, r->T);
+  } else {
+    fe25519_add(r->Z, t0, r->T);
+    fe25519_sub(r->T, t0, r->T);
+  }
+}
+
+static void ge_load_base(ge_precomp *r, int index)
+{
+  unsigned char buf[3][32];
+  memcpy_P(buf, ed25519_base_odd_multiples[index], sizeof(buf));
+  fe25519_frombytes(r->yplusx, buf[0]);
+  fe25519_frombytes(r->yminusx, buf[1]);
+  fe25519_frombytes(r->xy2d, buf[2]);
+}
+
+static void ge_tobytes(unsigned char *s, const ge_p2 *h)
+{
+  fe25519 recip, x, y;
+  fe25519_invert(recip, h->Z);
+  fe25519_mul(x, h->X, recip);
+  fe25519_mul(y, h->Y, recip);
+  fe25519_tobytes(s, y);
+  s[31] ^= fe25519_isnegative(x) << 7;
+}
+
+/* Decodes s into -A, returns -1 if s is not a point on the curve */
+static int ge_frombytes_negate_vartime(ge_p3 *h, const unsigned char *s)
+{
+  fe25519 u, v, v3, vxx, check, d;
+
+  fe25519_frombytes(d, ed25519_d);
+  fe25519_1(h->Z);
+  fe25519_frombytes(h->Y, s);
+  fe25519_sq(u, h->Y);
+  fe25519_mul(v, u, d);
+  fe25519_sub(u, u, h->Z);       /* u = y^2 - 1 */
+  fe25519_add(v, v, h->Z);       /* v = dy^2 + 1 */
+
+  fe25519_sq(v3, v);
+  fe25519_mul(v3, v3, v);        /* v3 = v^3 */
+  fe25519_sq(h->X, v3);
+  fe25519_mul(h->X, h->X, v);
+  fe25519_mul(h->X, h->X, u);    /* x = uv^7 */
+
+  fe25519_pow22523(h->X, h->X);  /* x = (uv^7)^((q - 5) / 8) */
+  fe25519_mul(h->X, h->X, v3);
+  fe25519_mul(h->X, h->X, u);    /* x = uv^3 (uv^7)^((q - 5) / 8) */
+
+  fe25519_sq(vxx, h->X);
+  fe25519_mul(vxx, vxx, v);
+  fe25519_sub(check, vxx, u);    /* vx^2 - u */
+  if (!fe25519_iszero(check)) {
+    fe25519_add(check, vxx, u);  /* vx^2 + u */
+    if (!fe25519_iszero(check)) return -1;
+    fe25519_frombytes(d, ed25519_sqrtm1);
+    fe25519_mul(h->X, h->X, d);
+  }
+
+  if (fe25519_isnegative(h->X) == (s[31] >> 7)) {
+    fe25519_neg(h->X, h->X);
+  }
+
+  fe25519_mul(h->T, h->X, h->Y);
+  return 0;
+}
+
+/* Recodes a into 256 odd signed digits in [-15, 15] with runs of zeros in between */
+static void slide(signed char *r, const unsigned char *a)
+{
+  int i, b, k;
+
+  for (i = 0; i < 256; ++i) {
+    r[i] = 1 & (a[i >> 3] >> (i & 7));
+  }
+
+  for (i = 0; i < 256; ++i) {
+    if (!r[i]) continue;
+    for (b = 1; b <= 6 && i + b < 256; ++b) {
+      if (!r[i + b]) continue;
+      if (r[i] + (r[i + b] << b) <= 15) {
+        r[i] += r[i + b] << b;
+        r[i + b] = 0;
+      } else if (r[i] - (r[i + b] << b) >= -15) {
+        r[i] -= r[i + b] << b;
+        for (k = i + b; k < 256; ++k) {
+          if (!r[k]) {
+            r[k] = 1;
+            break;
+          }
+          r[k] = 0;
+        }
+      } else {
+        break;
+      }
+    }
+  }
+}
+
+/* Scratch space of one verification, allocated on the heap */
+struct ed25519_verify_context {
+  ge_cached Ai[8];  /* -A, -3A, ..., -15A */
+  signed char aslide[256];
+  signed char bslide[256];
+};
+
+/* r = a * A + b * B, variable time */
+static void ge_double_scalarmult_vartime(ge_p2 *r, struct ed25519_verify_context *ctx, const unsigned char *a, const ge_p3 *A, const unsigned char *b)
+{
+  ge_p1p1 t;
+  ge_p3 u, A2;
+  ge_precomp Bi;
+  int i;
+
+  slide(ctx->aslide, a);
+  slide(ctx->bslide, b);
+
+  ge_p3_to_cached(&ctx->Ai[0], A);
+  ge_p3_dbl(&t, A);
+  ge_p1p1_to_p3(&A2, &t);
+  for (i = 0; i < 7; i++) {
+    ge_add(&t, &A2, &ctx->Ai[i], 0);
+    ge_p1p1_to_p3(&u, &t);
+    ge_p3_to_cached(&ctx->Ai[i + 1], &u);
+  }
+
+  ge_p2_0(r);
+
+  for (i = 255; i >= 0; --i) {
+    if (ctx->aslide[i] || ctx->bslide[i]) break;
+  }
+
+  for (; i >= 0; --i) {
+    ge_p2_dbl(&t, r);
+
+    if (ctx->aslide[i]) {
+      ge_p1p1_to_p3(&u, &t);
+      if (ctx->aslide[i] > 0) {
+        ge_add(&t, &u, &ctx->Ai[ctx->aslide[i] / 2], 0);
+      } else {
+        ge_add(&t, &u, &ctx->Ai[(-ctx->aslide[i]) / 2], 1);
+      }
+    }
+
+    if (ctx->bslide[i]) {
+      ge_p1p1_to_p3(&u, &t);
+      if (ctx->bslide[i] > 0) {
+        ge_load_base(&Bi, ctx->bslide[i] / 2);
+        ge_madd(&t, &u, &Bi, 0);
+      } else {
+        ge_load_base(&Bi, (-ctx->bslide[i]) / 2);
+        ge_madd(&t, &u, &Bi, 1);
+      }
+    }
+
+    ge_p1p1_to_p2(r, &t);
+  }
+}
+
+/* Is the little endian scalar s below the group order */
+static int sc_is_canonical(const unsigned char *s)
+{
+  int i;
+  for (i = 31; i >= 0; i--) {
+    if (s[i] < ed25519_l[i]) return 1;
+    if (s[i] > ed25519_l[i]) return 0;
+  }
+  return 0;
+}
+
+int crypto_sign_ed25519_verify_detached(const unsigned char *sig, const unsigned char *m, unsigned long long n, const unsigned char *pk)
+{
+  struct ed25519_verify_context *ctx;
+  crypto_hash_sha512_state hs;
+  unsigned char h[64], rcheck[32];
+  ge_p3 A;
+  ge_p2 R;
+
+  if (!sc_is_canonical(sig + 32)) return -1;
+  if (ge_frombytes_negate_vartime(&A, pk) != 0) return -1;
+
+  crypto_hash_sha512_init(&hs);
+  crypto_hash_sha512_update(&hs, sig, 32);
+  crypto_hash_sha512_update(&hs, pk, 32);
+  crypto_hash_sha512_update(&hs, m, n);
+  crypto_hash_sha512_final(&hs, h);
+  crypto_sign_ed25519_sc_reduce(h);
+
+  ctx = (struct ed25519_verify_context *) malloc(sizeof(struct ed25519_verify_context));
+  if (!ctx) return -1;
+  ge_double_scalarmult_vartime(&R, ctx, h, &A, sig + 32);
+  free(ctx);
+
+  ge_tobytes(rcheck, &R);
+  return memcmp(rcheck, sig, 32) == 0 ? 0 : -1;
+}
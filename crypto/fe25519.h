@@ -0,0 +1,139 @@
+/*
+ * fe25519.h
+ *
+ * Field arithmetic modulo 2^255 - 19 used by X25519 and Ed25519.
+ *
+ * The limb representation is chosen at compile time with FE25519_BACKEND:
+ *
+ *   FE25519_BACKEND_REF   16 x 16 bit limbs, the original tweetnacl code
+ *   FE25519_BACKEND_32    10 x 25.5 bit limbs in int32_t with 64 bit products (ESP8266)
+ *   FE25519_BACKEND_64    5 x 51 bit limbs in uint64_t with 128 bit products (host builds)
+ *
+ * Without an explicit choice the 64 bit backend is used whenever the compiler
+ * provides unsigned __int128, otherwise the 32 bit backend.
+ *
+ * Every backend provides the same static inline interface:
+ *
+ *   fe25519_0, fe25519_1, fe25519_copy, fe25519_add, fe25519_sub, fe25519_neg,
+ *   fe25519_mul, fe25519_sq, fe25519_sq2, fe25519_mul121665, fe25519_cswap,
+ *   fe25519_frombytes, fe25519_tobytes
+ *
+ * and this header builds inversion and the square root helper on top of it.
+ */
+
+#ifndef HOMEKIT_CRYPTO_FE25519_H_
+#define HOMEKIT_CRYPTO_FE25519_H_
+
+#include <stdint.h>
+#include <string.h>
+
+#define FE25519_BACKEND_REF 0
+#define FE25519_BACKEND_32  1
+#define FE25519_BACKEND_64  2
+
+#ifndef FE25519_BACKEND
+#if defined(__SIZEOF_INT128__)
+#define FE25519_BACKEND FE25519_BACKEND_64
+#else
+#define FE25519_BACKEND FE25519_BACKEND_32
+#endif
+#endif
+
+#if FE25519_BACKEND == FE25519_BACKEND_REF
+#include "fe25519_ref.h"
+#define FE25519_BACKEND_NAME "ref16"
+#elif FE25519_BACKEND == FE25519_BACKEND_32
+#include "fe25519_25_5.h"
+#define FE25519_BACKEND_NAME "radix25.5"
+#elif FE25519_BACKEND == FE25519_BACKEND_64
+#if !defined(__SIZEOF_INT128__)
+#error "FE25519_BACKEND_64 needs a compiler with unsigned __int128"
+#endif
+#include "fe25519_51.h"
+#define FE25519_BACKEND_NAME "radix51"
+#else
+#error "Unknown FE25519_BACKEND"
+#endif
+
+static inline void fe25519_sqn(fe25519 h, const fe25519 f, int n)
+{
+  fe25519_sq(h, f);
+  while (--n > 0) fe25519_sq(h, h);
+}
+
+/* h = z^(p - 2) = 1 / z */
+static inline void fe25519_invert(fe25519 h, const fe25519 z)
+{
+  fe25519 z2, z9, z11, z2_5_0, z2_10_0, z2_20_0, z2_50_0, z2_100_0, t;
+
+  fe25519_sq(z2, z);
+  fe25519_sqn(t, z2, 2);
+  fe25519_mul(z9, t, z);
+  fe25519_mul(z11, z9, z2);
+  fe25519_sq(t, z11);
+  fe25519_mul(z2_5_0, t, z9);
+  fe25519_sqn(t, z2_5_0, 5);
+  fe25519_mul(z2_10_0, t, z2_5_0);
+  fe25519_sqn(t, z2_10_0, 10);
+  fe25519_mul(z2_20_0, t, z2_10_0);
+  fe25519_sqn(t, z2_20_0, 20);
+  fe25519_mul(t, t, z2_20_0);
+  fe25519_sqn(t, t, 10);
+  fe25519_mul(z2_50_0, t, z2_10_0);
+  fe25519_sqn(t, z2_50_0, 50);
+  fe25519_mul(z2_100_0, t, z2_50_0);
+  fe25519_sqn(t, z2_100_0, 100);
+  fe25519_mul(t, t, z2_100_0);
+  fe25519_sqn(t, t, 50);
+  fe25519_mul(t, t, z2_50_0);
+  fe25519_sqn(t, t, 5);
+  fe25519_mul(h, t, z11);
+}
+
+/* h = z^((p - 5) / 8), used to compute square roots when decoding points */
+static inline void fe25519_pow22523(fe25519 h, const fe25519 z)
+{
+  fe25519 z2, z9, z2_5_0, z2_10_0, z2_20_0, z2_50_0, z2_100_0, t;
+
+  fe25519_sq(z2, z);
+  fe25519_sqn(t, z2, 2);
+  fe25519_mul(z9, t, z);
+  fe25519_mul(t, z9, z2);
+  fe25519_sq(t, t);
+  fe25519_mul(z2_5_0, t, z9);
+  fe25519_sqn(t, z2_5_0, 5);
+  fe25519_mul(z2_10_0, t, z2_5_0);
+  fe25519_sqn(t, z2_10_0, 10);
+  fe25519_mul(z2_20_0, t, z2_10_0);
+  fe25519_sqn(t, z2_20_0, 20);
+  fe25519_mul(t, t, z2_20_0);
+  fe25519_sqn(t, t, 10);
+  fe25519_mul(z2_50_0, t, z2_10_0);
+  fe25519_sqn(t, z2_50_0, 50);
+  fe25519_mul(z2_100_0, t, z2_50_0);
+  fe25519_sqn(t, z2_100_0, 100);
+  fe25519_mul(t, t, z2_100_0);
+  fe25519_sqn(t, t, 50);
+  fe25519_mul(t, t, z2_50_0);
+  fe25519_sqn(t, t, 2);
+  fe25519_mul(h, t, z);
+}
+
+/* Lowest bit of the canonical encoding ("sign" of x in Ed25519) */
+static inline int fe25519_isnegative(const fe25519 f)
+{
+  unsigned char s[32];
+  fe25519_tobytes(s, f);
+  return s[0] & 1;
+}
+
+static inline int fe25519_iszero(const fe25519 f)
+{
+  unsigned char s[32], d = 0;
+  int i;
+  fe25519_tobytes(s, f);
+  for (i = 0; i < 32; i++) d |= s[i];
+  return d == 0;
+}
+
+#endif /* HOMEKIT_CRYPTO_FE25519_H_ */
@@ -0,0 +1,215 @@
+/*
+ * fe25519_25_5.h
+ *
+ * 32 bit field backend: ten signed limbs alternating 26 and 25 bits
+ * (radix 2^25.5) as in the ref10 implementation. Products are accumulated
+ * in 64 bits, which maps onto the 32x32->64 multiply of the ESP8266 and
+ * needs four times fewer partial products than the 16 bit reference.
+ *
+ * Bounds follow ref10: after a carry every limb is within +-2^25 (+-2^24
+ * for the odd 25 bit limbs); add and sub do not carry, mul and sq accept
+ * the sum or difference of two carried elements.
+ *
+ * Do not include directly, use fe25519.h.
+ */
+
+#ifndef HOMEKIT_CRYPTO_FE25519_25_5_H_
+#define HOMEKIT_CRYPTO_FE25519_25_5_H_
+
+#include <stdint.h>
+#include <string.h>
+
+typedef int32_t fe25519[10];
+
+#define FE25519_CARRY(t, i, bits) \
+  c = (t[i] + ((int64_t) 1 << ((bits) - 1))) >> (bits); t[(i) + 1] += c; t[i] -= c * ((int64_t) 1 << (bits))
+
+/* Carry the 64 bit accumulators t into the limbs of h */
+static inline void fe25519_carry(fe25519 h, int64_t t[10])
+{
+  int64_t c;
+  int i;
+
+  FE25519_CARRY(t, 0, 26);
+  FE25519_CARRY(t, 4, 26);
+  FE25519_CARRY(t, 1, 25);
+  FE25519_CARRY(t, 5, 25);
+  FE25519_CARRY(t, 2, 26);
+  FE25519_CARRY(t, 6, 26);
+  FE25519_CARRY(t, 3, 25);
+  FE25519_CARRY(t, 7, 25);
+  FE25519_CARRY(t, 4, 26);
+  FE25519_CARRY(t, 8, 26);
+  c = (t[9] + ((int64_t) 1 << 24)) >> 25; t[0] += c * 19; t[9] -= c * ((int64_t) 1 << 25);
+  FE25519_CARRY(t, 0, 26);
+
+  for (i = 0; i < 10; i++) h[i] = (int32_t) t[i];
+}
+
+static inline void fe25519_0(fe25519 h) { memset(h, 0, sizeof(fe25519)); }
+static inline void fe25519_1(fe25519 h) { memset(h, 0, sizeof(fe25519)); h[0] = 1; }
+static inline void fe25519_copy(fe25519 h, const fe25519 f) { memcpy(h, f, sizeof(fe25519)); }
+
+static inline void fe25519_add(fe25519 h, const fe25519 f, const fe25519 g)
+{
+  int i;
+  for (i = 0; i < 10; i++) h[i] = f[i] + g[i];
+}
+
+static inline void fe25519_sub(fe25519 h, const fe25519 f, const fe25519 g)
+{
+  int i;
+  for (i = 0; i < 10; i++) h[i] = f[i] - g[i];
+}
+
+static inline void fe25519_neg(fe25519 h, const fe25519 f)
+{
+  int i;
+  for (i = 0; i < 10; i++) h[i] = -f[i];
+}
+
+static inline void fe25519_cswap(fe25519 f, fe25519 g, unsigned int b)
+{
+  int32_t x, mask = -(int32_t) b;
+  int i;
+  for (i = 0; i < 10; i++) {
+    x = mask & (f[i] ^ g[i]);
+    f[i] ^= x;
+    g[i] ^= x;
+  }
+}
+
+static inline void fe25519_mul(fe25519 h, const fe25519 f, const fe25519 g)
+{
+  int32_t f0 = f[0], f1 = f[1], f2 = f[2], f3 = f[3], f4 = f[4];
+  int32_t f5 = f[5], f6 = f[6], f7 = f[7], f8 = f[8], f9 = f[9];
+  int32_t g0 = g[0], g1 = g[1], g2 = g[2], g3 = g[3], g4 = g[4];
+  int32_t g5 = g[5], g6 = g[6], g7 = g[7], g8 = g[8], g9 = g[9];
+  int32_t f1_2 = 2 * f1, f3_2 = 2 * f3, f5_2 = 2 * f5, f7_2 = 2 * f7, f9_2 = 2 * f9;
+  int32_t g1_19 = 19 * g1, g2_19 = 19 * g2, g3_19 = 19 * g3, g4_19 = 19 * g4, g5_19 = 19 * g5;
+  int32_t g6_19 = 19 * g6, g7_19 = 19 * g7, g8_19 = 19 * g8, g9_19 = 19 * g9;
+  int64_t t[10];
+
+  t[0] = (int64_t) f0 * g0 + (int64_t) f1_2 * g9_19 + (int64_t) f2 * g8_19 + (int64_t) f3_2 * g7_19 + (int64_t) f4 * g6_19 + (int64_t) f5_2 * g5_19 + (int64_t) f6 * g4_19 + (int64_t) f7_2 * g3_19 + (int64_t) f8 * g2_19 + (int64_t) f9_2 * g1_19;
+  t[1] = (int64_t) f0 * g1 + (int64_t) f1 * g0 + (int64_t) f2 * g9_19 + (int64_t) f3 * g8_19 + (int64_t) f4 * g7_19 + (int64_t) f5 * g6_19 + (int64_t) f6 * g5_19 + (int64_t) f7 * g4_19 + (int64_t) f8 * g3_19 + (int64_t) f9 * g2_19;
+  t[2] = (int64_t) f0 * g2 + (int64_t) f1_2 * g1 + (int64_t) f2 * g0 + (int64_t) f3_2 * g9_19 + (int64_t) f4 * g8_19 + (int64_t) f5_2 * g7_19 + (int64_t) f6 * g6_19 + (int64_t) f7_2 * g5_19 + (int64_t) f8 * g4_19 + (int64_t) f9_2 * g3_19;
+  t[3] = (int64_t) f0 * g3 + (int64_t) f1 * g2 + (int64_t) f2 * g1 + (int64_t) f3 * g0 + (int64_t) f4 * g9_19 + (int64_t) f5 * g8_19 + (int64_t) f6 * g7_19 + (int64_t) f7 * g6_19 + (int64_t) f8 * g5_19 + (int64_t) f9 * g4_19;
+  t[4] = (int64_t) f0 * g4 + (int64_t) f1_2 * g3 + (int64_t) f2 * g2 + (int64_t) f3_2 * g1 + (int64_t) f4 * g0 + (int64_t) f5_2 * g9_19 + (int64_t) f6 * g8_19 + (int64_t) f7_2 * g7_19 + (int64_t) f8 * g6_19 + (int64_t) f9_2 * g5_19;
+  t[5] = (int64_t) f0 * g5 + (int64_t) f1 * g4 + (int64_t) f2 * g3 + (int64_t) f3 * g2 + (int64_t) f4 * g1 + (int64_t) f5 * g0 + (int64_t) f6 * g9_19 + (int64_t) f7 * g8_19 + (int64_t) f8 * g7_19 + (int64_t) f9 * g6_19;
+  t[6] = (int64_t) f0 * g6 + (int64_t) f1_2 * g5 + (int64_t) f2 * g4 + (int64_t) f3_2 * g3 + (int64_t) f4 * g2 + (int64_t) f5_2 * g1 + (int64_t) f6 * g0 + (int64_t) f7_2 * g9_19 + (int64_t) f8 * g8_19 + (int64_t) f9_2 * g7_19;
+  t[7] = (int64_t) f0 * g7 + (int64_t) f1 * g6 + (int64_t) f2 * g5 + (int64_t) f3 * g4 + (int64_t) f4 * g3 + (int64_t) f5 * g2 + (int64_t) f6 * g1 + (int64_t) f7 * g0 + (int64_t) f8 * g9_19 + (int64_t) f9 * g8_19;
+  t[8] = (int64_t) f0 * g8 + (int64_t) f1_2 * g7 + (int64_t) f2 * g6 + (int64_t) f3_2 * g5 + (int64_t) f4 * g4 + (int64_t) f5_2 * g3 + (int64_t) f6 * g2 + (int64_t) f7_2 * g1 + (int64_t) f8 * g0 + (int64_t) f9_2 * g9_19;
+  t[9] = (int64_t) f0 * g9 + (int64_t) f1 * g8 + (int64_t) f2 * g7 + (int64_t) f3 * g6 + (int64_t) f4 * g5 + (int64_t) f5 * g4 + (int64_t) f6 * g3 + (int64_t) f7 * g2 + (int64_t) f8 * g1 + (int64_t) f9 * g0;
+
+  fe25519_carry(h, t);
+}
+
+/* Unreduced products of f^2, shared by fe25519_sq and fe25519_sq2 */
+static inline void fe25519_sq_wide(int64_t t[10], const fe25519 f)
+{
+  int32_t f0 = f[0], f1 = f[1], f2 = f[2], f3 = f[3], f4 = f[4];
+  int32_t f5 = f[5], f6 = f[6], f7 = f[7], f8 = f[8], f9 = f[9];
+  int32_t f0_2 = 2 * f0, f1_2 = 2 * f1, f2_2 = 2 * f2, f3_2 = 2 * f3, f4_2 = 2 * f4;
+  int32_t f5_2 = 2 * f5, f6_2 = 2 * f6, f7_2 = 2 * f7;
+  int32_t f5_38 = 38 * f5, f6_19 = 19 * f6, f7_38 = 38 * f7, f8_19 = 19 * f8, f9_38 = 38 * f9;
+
+  t[0] = (int64_t) f0 * f0 + (int64_t) f1_2 * f9_38 + (int64_t) f2_2 * f8_19 + (int64_t) f3_2 * f7_38 + (int64_t) f4_2 * f6_19 + (int64_t) f5 * f5_38;
+  t[1] = (int64_t) f0_2 * f1 + (int64_t) f2 * f9_38 + (int64_t) f3_2 * f8_19 + (int64_t) f4 * f7_38 + (int64_t) f5_2 * f6_19;
+  t[2] = (int64_t) f0_2 * f2 + (int64_t) f1_2 * f1 + (int64_t) f3_2 * f9_38 + (int64_t) f4_2 * f8_19 + (int64_t) f5_2 * f7_38 + (int64_t) f6 * f6_19;
+  t[3] = (int64_t) f0_2 * f3 + (int64_t) f1_2 * f2 + (int64_t) f4 * f9_38 + (int64_t) f5_2 * f8_19 + (int64_t) f6 * f7_38;
+  t[4] = (int64_t) f0_2 * f4 + (int64_t) f1_2 * f3_2 + (int64_t) f2 * f2 + (int64_t) f5_2 * f9_38 + (int64_t) f6_2 * f8_19 + (int64_t) f7 * f7_38;
+  t[5] = (int64_t) f0_2 * f5 + (int64_t) f1_2 * f4 + (int64_t) f2_2 * f3 + (int64_t) f6 * f9_38 + (int64_t) f7_2 * f8_19;
+  t[6] = (int64_t) f0_2 * f6 + (int64_t) f1_2 * f5_2 + (int64_t) f2_2 * f4 + (int64_t) f3_2 * f3 + (int64_t) f7_2 * f9_38 + (int64_t) f8 * f8_19;
+  t[7] = (int64_t) f0_2 * f7 + (int64_t) f1_2 * f6 + (int64_t) f2_2 * f5 + (int64_t) f3_2 * f4 + (int64_t) f8 * f9_38;
+  t[8] = (int64_t) f0_2 * f8 + (int64_t) f1_2 * f7_2 + (int64_t) f2_2 * f6 + (int64_t) f3_2 * f5_2 + (int64_t) f4 * f4 + (int64_t) f9 * f9_38;
+  t[9] = (int64_t) f0_2 * f9 + (int64_t) f1_2 * f8 + (int64_t) f2_2 * f7 + (int64_t) f3_2 * f6 + (int64_t) f4_2 * f5;
+}
+
+static inline void fe25519_sq(fe25519 h, const fe25519 f)
+{
+  int64_t t[10];
+  fe25519_sq_wide(t, f);
+  fe25519_carry(h, t);
+}
+
+/* h = 2 * f^2 */
+static inline void fe25519_sq2(fe25519 h, const fe25519 f)
+{
+  int64_t t[10];
+  int i;
+  fe25519_sq_wide(t, f);
+  for (i = 0; i < 10; i++) t[i] += t[i];
+  fe25519_carry(h, t);
+}
+
+static inline void fe25519_mul121665(fe25519 h, const fe25519 f)
+{
+  int64_t t[10];
+  int i;
+  for (i = 0; i < 10; i++) t[i] = (int64_t) f[i] * 121665;
+  fe25519_carry(h, t);
+}
+
+static inline uint32_t fe25519_load32(const unsigned char *s)
+{
+  return (uint32_t) s[0] | ((uint32_t) s[1] << 8) | ((uint32_t) s[2] << 16) | ((uint32_t) s[3] << 24);
+}
+
+/* Ignores the top bit, as required by RFC 7748 */
+static inline void fe25519_frombytes(fe25519 h, const unsigned char *s)
+{
+  int64_t t[10];
+
+  t[0] = fe25519_load32(s) & 0x3ffffff;
+  t[1] = (fe25519_load32(s + 3) >> 2) & 0x1ffffff;
+  t[2] = (fe25519_load32(s + 6) >> 3) & 0x3ffffff;
+  t[3] = (fe25519_load32(s + 9) >> 5) & 0x1ffffff;
+  t[4] = (fe25519_load32(s + 12) >> 6) & 0x3ffffff;
+  t[5] = fe25519_load32(s + 16) & 0x1ffffff;
+  t[6] = (fe25519_load32(s + 19) >> 1) & 0x3ffffff;
+  t[7] = (fe25519_load32(s + 22) >> 3) & 0x1ffffff;
+  t[8] = (fe25519_load32(s + 25) >> 4) & 0x3ffffff;
+  t[9] = (fe25519_load32(s + 28) >> 6) & 0x1ffffff;
+  fe25519_carry(h, t);
+}
+
+/* Writes the canonical encoding (fully reduced modulo p) */
+static inline void fe25519_tobytes(unsigned char *s, const fe25519 f)
+{
+  int64_t t[10];
+  int32_t h[10], q, c;
+  uint64_t acc = 0;
+  int i, bits = 0, n = 0;
+
+  for (i = 0; i < 10; i++) t[i] = f[i];
+  fe25519_carry(h, t);
+
+  /* q = floor(h / p), which is 0 or 1 for a carried element */
+  q = (19 * h[9] + ((int32_t) 1 << 24)) >> 25;
+  for (i = 0; i < 10; i++) q = (h[i] + q) >> ((i & 1) ? 25 : 26);
+
+  /* h - q * p, with all limbs carried into their positive range */
+  h[0] += 19 * q;
+  for (i = 0; i < 9; i++) {
+    int b = (i & 1) ? 25 : 26;
+    c = h[i] >> b;
+    h[i + 1] += c;
+    h[i] -= c * ((int32_t) 1 << b);
+  }
+  h[9] &= 0x1ffffff;
+
+  for (i = 0; i < 10; i++) {
+    acc |= (uint64_t) (uint32_t) h[i] << bits;
+    bits += (i & 1) ? 25 : 26;
+    while (bits >= 8) {
+      s[n++] = (unsigned char) acc;
+      acc >>= 8;
+      bits -= 8;
+    }
+  }
+  s[31] = (unsigned char) acc;
+}
+
+#undef FE25519_CARRY
+
+#endif /* HOMEKIT_CRYPTO_FE25519_25_5_H_ */
@@ -0,0 +1,186 @@
+/*
+ * fe25519_51.h
+ *
+ * 64 bit field backend: five unsigned 51 bit limbs (radix 2^51) with
+ * unsigned __int128 products, for host builds on 64 bit machines.
+ *
+ * Limbs are kept below 2^52 at all times: add and sub do a single carry
+ * pass so their results can be fed into mul and sq without further checks.
+ *
+ * Do not include directly, use fe25519.h.
+ */
+
+#ifndef HOMEKIT_CRYPTO_FE25519_51_H_
+#define HOMEKIT_CRYPTO_FE25519_51_H_
+
+#include <stdint.h>
+#include <string.h>
+
+typedef uint64_t fe25519[5];
+typedef unsigned __int128 fe25519_u128;
+
+#define FE25519_MASK51 (((uint64_t) 1 << 51) - 1)
+
+static inline void fe25519_weak_reduce(fe25519 h)
+{
+  uint64_t c;
+  c = h[0] >> 51; h[0] &= FE25519_MASK51; h[1] += c;
+  c = h[1] >> 51; h[1] &= FE25519_MASK51; h[2] += c;
+  c = h[2] >> 51; h[2] &= FE25519_MASK51; h[3] += c;
+  c = h[3] >> 51; h[3] &= FE25519_MASK51; h[4] += c;
+  c = h[4] >> 51; h[4] &= FE25519_MASK51; h[0] += c * 19;
+}
+
+static inline void fe25519_0(fe25519 h) { memset(h, 0, sizeof(fe25519)); }
+static inline void fe25519_1(fe25519 h) { memset(h, 0, sizeof(fe25519)); h[0] = 1; }
+static inline void fe25519_copy(fe25519 h, const fe25519 f) { memcpy(h, f, sizeof(fe25519)); }
+
+static inline void fe25519_add(fe25519 h, const fe25519 f, const fe25519 g)
+{
+  int i;
+  for (i = 0; i < 5; i++) h[i] = f[i] + g[i];
+  fe25519_weak_reduce(h);
+}
+
+/* h = f + 4p - g, so the limbs never underflow */
+static inline void fe25519_sub(fe25519 h, const fe25519 f, const fe25519 g)
+{
+  h[0] = f[0] + 0x1fffffffffffb4ULL - g[0];
+  h[1] = f[1] + 0x1ffffffffffffcULL - g[1];
+  h[2] = f[2] + 0x1ffffffffffffcULL - g[2];
+  h[3] = f[3] + 0x1ffffffffffffcULL - g[3];
+  h[4] = f[4] + 0x1ffffffffffffcULL - g[4];
+  fe25519_weak_reduce(h);
+}
+
+static inline void fe25519_neg(fe25519 h, const fe25519 f)
+{
+  fe25519 zero;
+  fe25519_0(zero);
+  fe25519_sub(h, zero, f);
+}
+
+static inline void fe25519_cswap(fe25519 f, fe25519 g, unsigned int b)
+{
+  uint64_t x, mask = (uint64_t) 0 - b;
+  int i;
+  for (i = 0; i < 5; i++) {
+    x = mask & (f[i] ^ g[i]);
+    f[i] ^= x;
+    g[i] ^= x;
+  }
+}
+
+static inline void fe25519_carry128(fe25519 h, fe25519_u128 t[5])
+{
+  uint64_t c;
+  t[1] += (uint64_t) (t[0] >> 51); h[0] = (uint64_t) t[0] & FE25519_MASK51;
+  t[2] += (uint64_t) (t[1] >> 51); h[1] = (uint64_t) t[1] & FE25519_MASK51;
+  t[3] += (uint64_t) (t[2] >> 51); h[2] = (uint64_t) t[2] & FE25519_MASK51;
+  t[4] += (uint64_t) (t[3] >> 51); h[3] = (uint64_t) t[3] & FE25519_MASK51;
+  c = (uint64_t) (t[4] >> 51); h[4] = (uint64_t) t[4] & FE25519_MASK51;
+  h[0] += c * 19;
+  c = h[0] >> 51; h[0] &= FE25519_MASK51; h[1] += c;
+}
+
+static inline void fe25519_mul(fe25519 h, const fe25519 f, const fe25519 g)
+{
+  uint64_t g1_19 = 19 * g[1], g2_19 = 19 * g[2], g3_19 = 19 * g[3], g4_19 = 19 * g[4];
+  fe25519_u128 t[5];
+
+  t[0] = (fe25519_u128) f[0] * g[0] + (fe25519_u128) f[1] * g4_19 + (fe25519_u128) f[2] * g3_19 + (fe25519_u128) f[3] * g2_19 + (fe25519_u128) f[4] * g1_19;
+  t[1] = (fe25519_u128) f[0] * g[1] + (fe25519_u128) f[1] * g[0] + (fe25519_u128) f[2] * g4_19 + (fe25519_u128) f[3] * g3_19 + (fe25519_u128) f[4] * g2_19;
+  t[2] = (fe25519_u128) f[0] * g[2] + (fe25519_u128) f[1] * g[1] + (fe25519_u128) f[2] * g[0] + (fe25519_u128) f[3] * g4_19 + (fe25519_u128) f[4] * g3_19;
+  t[3] = (fe25519_u128) f[0] * g[3] + (fe25519_u128) f[1] * g[2] + (fe25519_u128) f[2] * g[1] + (fe25519_u128) f[3] * g[0] + (fe25519_u128) f[4] * g4_19;
+  t[4] = (fe25519_u128) f[0] * g[4] + (fe25519_u128) f[1] * g[3] + (fe25519_u128) f[2] * g[2] + (fe25519_u128) f[3] * g[1] + (fe25519_u128) f[4] * g[0];
+
+  fe25519_carry128(h, t);
+}
+
+static inline void fe25519_sq(fe25519 h, const fe25519 f)
+{
+  uint64_t f0_2 = 2 * f[0], f1_2 = 2 * f[1];
+  uint64_t f1_38 = 38 * f[1], f2_38 = 38 * f[2], f3_38 = 38 * f[3], f3_19 = 19 * f[3], f4_19 = 19 * f[4];
+  fe25519_u128 t[5];
+
+  t[0] = (fe25519_u128) f[0] * f[0] + (fe25519_u128) f1_38 * f[4] + (fe25519_u128) f2_38 * f[3];
+  t[1] = (fe25519_u128) f0_2 * f[1] + (fe25519_u128) f2_38 * f[4] + (fe25519_u128) f3_19 * f[3];
+  t[2] = (fe25519_u128) f0_2 * f[2] + (fe25519_u128) f[1] * f[1] + (fe25519_u128) f3_38 * f[4];
+  t[3] = (fe25519_u128) f0_2 * f[3] + (fe25519_u128) f1_2 * f[2] + (fe25519_u128) f4_19 * f[4];
+  t[4] = (fe25519_u128) f0_2 * f[4] + (fe25519_u128) f1_2 * f[3] + (fe25519_u128) f[2] * f[2];
+
+  fe25519_carry128(h, t);
+}
+
+/* h = 2 * f^2 */
+static inline void fe25519_sq2(fe25519 h, const fe25519 f)
+{
+  fe25519_sq(h, f);
+  fe25519_add(h, h, h);
+}
+
+static inline void fe25519_mul121665(fe25519 h, const fe25519 f)
+{
+  fe25519_u128 t[5];
+  int i;
+  for (i = 0; i < 5; i++) t[i] = (fe25519_u128) f[i] * 121665;
+  fe25519_carry128(h, t);
+}
+
+static inline uint64_t fe25519_load64(const unsigned char *s)
+{
+  uint64_t r = 0;
+  int i;
+  for (i = 7; i >= 0; i--) r = (r << 8) | s[i];
+  return r;
+}
+
+/* Ignores the top bit, as required by RFC 7748 */
+static inline void fe25519_frombytes(fe25519 h, const unsigned char *s)
+{
+  h[0] = fe25519_load64(s) & FE25519_MASK51;
+  h[1] = (fe25519_load64(s + 6) >> 3) & FE25519_MASK51;
+  h[2] = (fe25519_load64(s + 12) >> 6) & FE25519_MASK51;
+  h[3] = (fe25519_load64(s + 19) >> 1) & FE25519_MASK51;
+  h[4] = (fe25519_load64(s + 24) >> 12) & FE25519_MASK51;
+}
+
+/* Writes the canonical encoding (fully reduced modulo p) */
+static inline void fe25519_tobytes(unsigned char *s, const fe25519 f)
+{
+  fe25519 h;
+  uint64_t q, c, w1, w2, w3, w4;
+  int i;
+
+  fe25519_copy(h, f);
+  fe25519_weak_reduce(h);
+
+  /* q = floor(h / p), which is 0 or 1 once h < 2^255 + 2^51 */
+  q = (h[0] + 19) >> 51;
+  q = (h[1] + q) >> 51;
+  q = (h[2] + q) >> 51;
+  q = (h[3] + q) >> 51;
+  q = (h[4] + q) >> 51;
+
+  h[0] += 19 * q;
+  c = h[0] >> 51; h[0] &= FE25519_MASK51; h[1] += c;
+  c = h[1] >> 51; h[1] &= FE25519_MASK51; h[2] += c;
+  c = h[2] >> 51; h[2] &= FE25519_MASK51; h[3] += c;
+  c = h[3] >> 51; h[3] &= FE25519_MASK51; h[4] += c;
+  h[4] &= FE25519_MASK51;
+
+  w1 = h[0] | (h[1] << 51);
+  w2 = (h[1] >> 13) | (h[2] << 38);
+  w3 = (h[2] >> 26) | (h[3] << 25);
+  w4 = (h[3] >> 39) | (h[4] << 12);
+  for (i = 0; i < 8; i++) {
+    s[i] = (unsigned char) (w1 >> (8 * i));
+    s[8 + i] = (unsigned char) (w2 >> (8 * i));
+    s[16 + i] = (unsigned char) (w3 >> (8 * i));
+    s[24 + i] = (unsigned char) (w4 >> (8 * i));
+  }
+}
+
+#undef FE25519_MASK51
+
+#endif /* HOMEKIT_CRYPTO_FE25519_51_H_ */
@@ -0,0 +1,239 @@
+/*
+ * fe25519_ref.h
+ *
+ * Reference field backend: the 16 x 16 bit limb arithmetic of tweetnacl.
+ * It is the slowest backend but also the one the Ed25519 code in
+ * tweetnacl.c is written against, so tweetnacl.c includes it next to
+ * fe25519.h to get gf. The fe25519_* interface is only defined when this is
+ * the selected backend.
+ */
+
+#ifndef HOMEKIT_CRYPTO_FE25519_REF_H_
+#define HOMEKIT_CRYPTO_FE25519_REF_H_
+
+#include <stdint.h>
+#include <string.h>
+
+typedef long long gf[16];
+
+static inline void set25519(gf r, const gf a)
+{
+  int i;
+  for (i = 0; i < 16; ++i) r[i]=a[i];
+}
+
+//#define MUL38(V) ((v)*38)
+#define MUL38(V) ((((((V) << 3) + (V)) << 1) + (V)) << 1)
+
+static inline void car25519(gf o)
+{
+  long long c=0;
+  unsigned i;
+  for (i = 0; i < 16; ++i) {
+    long long v=o[i]+c;
+    o[i]=v&0xFFFF;
+    c=v>>16;
+  }
+  while (c) {
+    c=MUL38(c);
+    for(i = 0; c && i < 16; i++) {
+      long long v=o[i]+c;
+      o[i]=v&0xFFFF;
+      c=v>>16;
+    }
+  }
+}
+
+static inline void sel25519(gf p,gf q)
+{
+   gf t;
+   memcpy(t,p,sizeof(t));
+   memcpy(p,q,sizeof(t));
+   memcpy(q,t,sizeof(t));
+}
+
+static inline void pack25519(unsigned char *o,const gf n)
+{
+  int i,j,b;
+  gf m,t;
+  for (i = 0; i < 16; ++i) t[i]=n[i];
+  car25519(t);
+  for (j = 0; j < 2; ++j) {
+    m[0]=t[0]-0xffed;
+    for(i=1;i<15;i++) {
+      m[i]=t[i]-0xffff-((m[i-1]>>16)&1);
+      m[i-1]&=0xffff;
+    }
+    m[15]=t[15]-0x7fff-((m[14]>>16)&1);
+    b=(m[15]>>16)&1;
+    m[14]&=0xffff;
+    if (!b) sel25519(t,m);
+  }
+  for (i = 0; i < 16; ++i) {
+    o[2*i]=t[i]&0xff;
+    o[2*i+1]=t[i]>>8;
+  }
+}
+
+static inline void unpack25519(gf o, const unsigned char *n)
+{
+  unsigned i;
+  for (i = 0; i < 16; ++i) o[i]=(long long)(n[2*i]|((uint32_t)n[2*i+1]<<8));
+  o[15]&=0x7fff;
+}
+
+static inline void A(gf o,const gf a,const gf b)
+{
+  unsigned i;
+  for (i = 0; i < 16; ++i) o[i]=a[i]+b[i];
+}
+
+static inline void Z(gf o,const gf a,const gf b)
+{
+  unsigned i;
+  for (i = 0; i < 16; ++i) o[i]=a[i]-b[i];
+}
+
+static inline void CS(uint16_t s[16], const gf o)
+{
+  long long c=0;
+  unsigned i;
+  for (i = 0; i < 16; ++i) {
+    long long v=o[i]+c;
+    s[i]=(uint16_t)v;
+    c=v>>16;
+  }
+  while (c) {
+    c=MUL38(c);
+    for(i = 0; c && i < 16; i++) {
+      long long v=s[i]+c;
+      s[i]=(uint16_t)v;
+      c=v>>16;
+    }
+  }
+}
+
+static inline void M(gf o,const gf a,const gf b)
+{
+  unsigned i;
+  uint16_t as[16];
+  uint16_t bs[16];
+
+  CS(as, a);
+  CS(bs, b);
+
+  long long t[31],v;
+  for (i = 0; i < 31; ++i) t[i]=0;
+  long long* pt = &t[15];
+  for (uint16_t* asp = &as[15]; asp >= as; asp--, pt--) {
+    uint32_t asi = *asp;
+    long long* ppt = pt + 15;
+    for (uint16_t* bsp = &bs[15]; bsp >= bs; bsp--, ppt--) {
+      v=*ppt;
+      v+=(long long)(asi * (uint32_t)*bsp);
+      *ppt=v;
+    }
+  }
+  for (i = 0; i < 15; ++i) { v=t[i+16]; v=MUL38(v); o[i]=t[i]+v; }
+  o[15]=t[15];
+}
+
+static inline void S(gf o,const gf a)
+{
+  unsigned i,j;
+  uint16_t as[16];
+
+  CS(as, a);
+
+  long long t[31],v;
+  for (i = 0; i < 31; ++i) t[i]=0;
+  for (i = 0; i < 16; ++i) {
+    uint32_t ai = (uint32_t)as[i];
+    t[i<<1]+=(uint32_t)(ai*ai);
+    for(j=i+1;j<16;j++) {
+      v=t[i+j];
+      v+=((long long)(ai*(uint32_t)as[j]))<<1;
+      t[i+j]=v;
+    }
+  }
+  for (i = 0; i < 15; ++i) { v=t[i+16]; v=MUL38(v); o[i]=t[i]+v; }
+  o[15]=t[15];
+}
+
+static inline void inv25519(gf o,const gf i)
+{
+  gf c;
+  int a;
+  for (a = 0; a < 16; ++a) c[a]=i[a];
+  for(a=249;a;a--) {
+    S(c,c);
+    M(c,c,i);
+  }
+  S(c,c);
+  S(c,c);
+  M(c,c,i);
+  S(c,c);
+  S(c,c);
+  M(c,c,i);
+  S(c,c);
+  M(c,c,i);
+  for (a = 0; a < 16; ++a) o[a]=c[a];
+}
+
+static inline void pow2523(gf o,const gf i)
+{
+  gf c;
+  int a;
+  for (a = 0; a < 16; ++a) c[a]=i[a];
+  for(a=249;a;a--) {
+    S(c,c);
+    M(c,c,i);
+  }
+  S(c,c);
+  S(c,c);
+  M(c,c,i);
+  for (a = 0; a < 16; ++a) o[a]=c[a];
+}
+
+#if defined(FE25519_BACKEND) && FE25519_BACKEND == FE25519_BACKEND_REF
+
+typedef gf fe25519;
+
+static inline void fe25519_0(fe25519 h) { memset(h, 0, sizeof(fe25519)); }
+static inline void fe25519_1(fe25519 h) { memset(h, 0, sizeof(fe25519)); h[0] = 1; }
+static inline void fe25519_copy(fe25519 h, const fe25519 f) { set25519(h, f); }
+static inline void fe25519_add(fe25519 h, const fe25519 f, const fe25519 g) { A(h, f, g); }
+static inline void fe25519_sub(fe25519 h, const fe25519 f, const fe25519 g) { Z(h, f, g); }
+static inline void fe25519_mul(fe25519 h, const fe25519 f, const fe25519 g) { M(h, f, g); }
+static inline void fe25519_sq(fe25519 h, const fe25519 f) { S(h, f); }
+static inline void fe25519_sq2(fe25519 h, const fe25519 f) { S(h, f); A(h, h, h); }
+static inline void fe25519_frombytes(fe25519 h, const unsigned char *s) { unpack25519(h, s); }
+static inline void fe25519_tobytes(unsigned char *s, const fe25519 h) { pack25519(s, h); }
+
+static inline void fe25519_neg(fe25519 h, const fe25519 f)
+{
+  fe25519 zero;
+  fe25519_0(zero);
+  Z(h, zero, f);
+}
+
+static inline void fe25519_mul121665(fe25519 h, const fe25519 f)
+{
+  static const gf _121665 = {0xDB41,1};
+  M(h, f, _121665);
+}
+
+static inline void fe25519_cswap(fe25519 f, fe25519 g, unsigned int b)
+{
+  long long x, mask = -(long long) b;
+  int i;
+  for (i = 0; i < 16; i++) {
+    x = mask & (f[i] ^ g[i]);
+    f[i] ^= x;
+    g[i] ^= x;
+  }
+}
+
+#endif
+
+#endif /* HOMEKIT_CRYPTO_FE25519_REF_H_ */
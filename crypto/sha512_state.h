@@ -0,0 +1,51 @@
+/*
+ * sha512_state.h
+ *
+ * Incremental SHA-512 on top of tweetnacl's crypto_hashblocks_sha512.
+ * Lets callers hash transcripts field by field instead of building one
+ * concatenated heap buffer for crypto_hash_sha512.
+ *
+ * A state can be copied by value to fork the hash of a common prefix.
+ *
+ * HMAC-SHA512 and HKDF-SHA512 (RFC 5869) are built on the same state. An
+ * HMAC state holds the hashes of the inner and outer key pads, so a keyed
+ * state is computed once and copied for every message under that key.
+ * crypto_kdf_hkdf_sha512_extract returns such a state keyed with the PRK,
+ * which crypto_kdf_hkdf_sha512_expand can be called on any number of times.
+ */
+
+#ifndef HOMEKIT_CRYPTO_SHA512_STATE_H_
+#define HOMEKIT_CRYPTO_SHA512_STATE_H_
+
+typedef struct {
+  unsigned char h[64];
+  unsigned char buffer[128];
+  unsigned long long length;
+  unsigned long long buffered;
+} crypto_hash_sha512_state;
+
+typedef struct {
+  crypto_hash_sha512_state ictx;
+  crypto_hash_sha512_state octx;
+} crypto_auth_hmacsha512_state;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern int crypto_hash_sha512_init(crypto_hash_sha512_state *);
+extern int crypto_hash_sha512_update(crypto_hash_sha512_state *,const unsigned char *,unsigned long long);
+extern int crypto_hash_sha512_final(crypto_hash_sha512_state *,unsigned char *);
+
+extern int crypto_auth_hmacsha512_init(crypto_auth_hmacsha512_state *,const unsigned char *,unsigned long long);
+extern int crypto_auth_hmacsha512_update(crypto_auth_hmacsha512_state *,const unsigned char *,unsigned long long);
+extern int crypto_auth_hmacsha512_final(crypto_auth_hmacsha512_state *,unsigned char *);
+
+extern int crypto_kdf_hkdf_sha512_extract(crypto_auth_hmacsha512_state *,const unsigned char *,unsigned long long,const unsigned char *,unsigned long long);
+extern int crypto_kdf_hkdf_sha512_expand(unsigned char *,unsigned long long,const crypto_auth_hmacsha512_state *,const unsigned char *,unsigned long long);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HOMEKIT_CRYPTO_SHA512_STATE_H_ */
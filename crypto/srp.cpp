@@ -12,6 +12,7 @@
  */
 
 #include "srp.h"
+#include <HKDebug.h>
 
 #define E(V)  (((V) << 24) | ((V) >> 24) | (((V) >> 8) & 0x0000FF00) | (((V) << 8) & 0x00FF0000))
 static const uint32_t srp_N[] PROGMEM =
@@ -65,14 +66,63 @@ static void MPI_ERROR_CHECK(int CODE)
     }
 }
 
+// Set once a pool was released with limbs in use, it is never freed and no new pool is attached
+static bool mpiPoolLeaked = false;
+
+/**
+ * @brief Allocate the limb pool for one SRP phase in a single block and attach it
+ * 
+ * The pool is taken from the heap on purpose: pair setup runs once per pairing, and a static arena would keep
+ * 12 KB of the ESP8266's RAM reserved for the whole uptime. The block is freed again before the response is sent.
+ * 
+ * @return uint8_t* Pool memory, nullptr if the heap is too fragmented or a pool leaked (the MPIs then use the
+ * heap directly)
+ */
+static uint8_t *beginMPIPool()
+{
+    if (mpiPoolLeaked)
+    {
+        HKLOGWARNING("[Srp::beginMPIPool] MPI pool leaked before, using the heap for MPIs\r\n");
+        return nullptr;
+    }
+    uint8_t *pool = (uint8_t *) malloc(SRP_MPI_POOL_SIZE);
+    if (!pool)
+    {
+        HKLOGERROR("[Srp::beginMPIPool] Could not allocate %u bytes for the MPI pool (%u bytes free), using the heap for MPIs\r\n", SRP_MPI_POOL_SIZE, ESP.getFreeHeap());
+        return nullptr;
+    }
+    mbedtls_mpi_pool_init(pool, SRP_MPI_POOL_SIZE);
+    return pool;
+}
+
+/**
+ * @brief Detach and free the limb pool. Every mbedtls_mpi must be freed by now, otherwise the pool is leaked
+ * so the remaining limbs stay valid.
+ * 
+ * @param pool Pool memory returned by beginMPIPool
+ */
+static void endMPIPool(uint8_t *pool)
+{
+    if (pool)
+    {
+        size_t leaked = mbedtls_mpi_pool_release();
+        if (leaked != 0)
+        {
+            HKLOGERROR("[Srp::endMPIPool] %u bytes of MPI pool still in use, leaking pool\r\n", leaked);
+            mpiPoolLeaked = true;
+            return;
+        }
+        free(pool);
+    }
+}
+
 Srp::Srp(const char *pincode)
 {
     int err_code;
 
-    // The MPI library uses a ridiculous amount of memory. We use the stack allocator
+    // The MPI library uses a ridiculous amount of memory. We use the pool allocator
     // so we don't tie this memory up except when we absolutely need to.
-    //uint8_t memory[11 * 1024];
-    //mbedtls_memory_buffer_alloc_init(memory, sizeof(memory));
+    uint8_t *pool = beginMPIPool();
 
     // Generate salt
     os_get_random(srp_salt, sizeof(srp_salt));
@@ -85,17 +135,21 @@ Srp::Srp(const char *pincode)
     mbedtls_mpi x;
     mbedtls_mpi_init(&x);
     {
-        uint8_t *message = (uint8_t *) malloc(sizeof(srp_salt) + 64);
-        memcpy(message, srp_salt, sizeof(srp_salt));
-
-        char pinMessageCopy[21];
-        memcpy_P(pinMessageCopy, pinMessage, 12);
-        strcat(pinMessageCopy, pincode);
-
-        crypto_hash_sha512(message + sizeof(srp_salt), (uint8_t *)pinMessageCopy, sizeof(pinMessageCopy));
-        crypto_hash_sha512(message, message, sizeof(srp_salt) + 64);
-        err_code = mbedtls_mpi_read_binary(&x, message, 64);
-        free(message);
+        uint8_t hash[64];
+        char pinMessageCopy[12];
+        memcpy_P(pinMessageCopy, pinMessage, sizeof(pinMessageCopy));
+
+        crypto_hash_sha512_state state;
+        crypto_hash_sha512_init(&state);
+        crypto_hash_sha512_update(&state, (uint8_t *) pinMessageCopy, strlen(pinMessageCopy));
+        crypto_hash_sha512_update(&state, (uint8_t *) pincode, strlen(pincode));
+        crypto_hash_sha512_final(&state, hash);
+
+        crypto_hash_sha512_init(&state);
+        crypto_hash_sha512_update(&state, srp_salt, sizeof(srp_salt));
+        crypto_hash_sha512_update(&state, hash, sizeof(hash));
+        crypto_hash_sha512_final(&state, hash);
+        err_code = mbedtls_mpi_read_binary(&x, hash, sizeof(hash));
         MPI_ERROR_CHECK(err_code);
     }
 
@@ -161,7 +215,7 @@ Srp::Srp(const char *pincode)
     mbedtls_mpi_free(&g);
     mbedtls_mpi_free(&x);
 
-    //mbedtls_memory_buffer_alloc_free();
+    endMPIPool(pool);
 }
 
 void Srp::start()
@@ -174,10 +228,9 @@ uint8_t Srp::setA(uint8_t* abuf, uint16_t length, moretime_t moretime)
 {
     int err_code;
 
-    // The MPI library uses a ridiculous amount of memory. We use the stack allocator
+    // The MPI library uses a ridiculous amount of memory. We use the pool allocator
     // so we don't tie this memory up except when we absolutely need to.
-    //uint8_t memory[11 * 1024];
-    //mbedtls_memory_buffer_alloc_init(memory, sizeof(memory));
+    uint8_t *pool = beginMPIPool();
 
     // getK
     {
@@ -197,13 +250,14 @@ uint8_t Srp::setA(uint8_t* abuf, uint16_t length, moretime_t moretime)
             mbedtls_mpi u;
             mbedtls_mpi_init(&u);
             {
-                uint8_t *message = (uint8_t *) malloc(length + sizeof(srp_B));
-                memcpy(message, abuf, length);
-                memcpy(message + length, srp_B, sizeof(srp_B));
-                crypto_hash_sha512(message, message, length + sizeof(srp_B));
-
-                err_code = mbedtls_mpi_read_binary(&u, message, 64);
-                free(message);
+                uint8_t hash[64];
+                crypto_hash_sha512_state state;
+                crypto_hash_sha512_init(&state);
+                crypto_hash_sha512_update(&state, abuf, length);
+                crypto_hash_sha512_update(&state, srp_B, sizeof(srp_B));
+                crypto_hash_sha512_final(&state, hash);
+
+                err_code = mbedtls_mpi_read_binary(&u, hash, sizeof(hash));
                 MPI_ERROR_CHECK(err_code);
             }
 
@@ -258,51 +312,53 @@ uint8_t Srp::setA(uint8_t* abuf, uint16_t length, moretime_t moretime)
         crypto_hash_sha512(srp_K, sbuf, sizeof(sbuf));
     }
 
-    //mbedtls_memory_buffer_alloc_free();
+    endMPIPool(pool);
 
     // getM1 - username s abuf srp_B K
     {
-        size_t messageSize = sizeof(srp_N_hash_srp_G_hash) + 64 + sizeof(srp_salt) + length + 384 + sizeof(srp_K);
-        uint8_t *message = (uint8_t *) malloc(messageSize);
-        uint8_t *srp_N_hash_srp_G_hash_buf = (uint8_t *)malloc(sizeof(srp_N_hash_srp_G_hash));
-        memcpy_P(srp_N_hash_srp_G_hash_buf, srp_N_hash_srp_G_hash, sizeof(srp_N_hash_srp_G_hash));
-        memcpy(message, srp_N_hash_srp_G_hash, sizeof(srp_N_hash_srp_G_hash));
-        free(srp_N_hash_srp_G_hash_buf);
-
+        uint8_t hash[64];
         char pinMessageCopy[10];
         memcpy_P(pinMessageCopy, pinMessage, 10);
 
-        crypto_hash_sha512(message + sizeof(srp_N_hash_srp_G_hash), (uint8_t *) pinMessageCopy, 10); // First 10 chars only - not the PIN part
-        memcpy(message + sizeof(srp_N_hash_srp_G_hash) + 64, srp_salt, sizeof(srp_salt));
-        memcpy(message + sizeof(srp_N_hash_srp_G_hash) + 64 + sizeof(srp_salt), abuf, length);
-        memcpy(message + sizeof(srp_N_hash_srp_G_hash) + 64 + sizeof(srp_salt) + length, srp_B, sizeof(srp_B));
-        memcpy(message + sizeof(srp_N_hash_srp_G_hash) + 64 + sizeof(srp_salt) + length + 384, srp_K, sizeof(srp_K));
+        crypto_hash_sha512_state state;
+        crypto_hash_sha512_init(&state);
+        crypto_hash_sha512_update(&state, (uint8_t *) pinMessageCopy, 10); // First 10 chars only - not the PIN part
+        crypto_hash_sha512_final(&state, hash);
+
+        uint8_t srp_N_hash_srp_G_hash_buf[sizeof(srp_N_hash_srp_G_hash)];
+        memcpy_P(srp_N_hash_srp_G_hash_buf, srp_N_hash_srp_G_hash, sizeof(srp_N_hash_srp_G_hash));
+
+        crypto_hash_sha512_init(&state);
+        crypto_hash_sha512_update(&state, srp_N_hash_srp_G_hash_buf, sizeof(srp_N_hash_srp_G_hash_buf));
+        crypto_hash_sha512_update(&state, hash, sizeof(hash));
+        crypto_hash_sha512_update(&state, srp_salt, sizeof(srp_salt));
+        crypto_hash_sha512_update(&state, abuf, length);
+        crypto_hash_sha512_update(&state, srp_B, sizeof(srp_B));
+        crypto_hash_sha512_update(&state, srp_K, sizeof(srp_K));
+        crypto_hash_sha512_final(&state, hash);
+
         srp_serverM1 = 1;
         if (srp_clientM1)
         {
-            uint8_t hash[64];
-            crypto_hash_sha512(hash, message, messageSize);
             if (memcmp(hash, srp_M1, sizeof(srp_M1)) != 0)
             {
-                free(message);
                 return 0;
             }
         }
         else
         {
-            crypto_hash_sha512(srp_M1, message, messageSize);
+            memcpy(srp_M1, hash, sizeof(srp_M1));
         }
-        free(message);
     }
 
     // getM2
     {
-        uint8_t *message = (uint8_t *) malloc(length + sizeof(srp_M1) + sizeof(srp_K));
-        memcpy(message, abuf, length);
-        memcpy(message + length, srp_M1, sizeof(srp_M1));
-        memcpy(message + length + sizeof(srp_M1), srp_K, sizeof(srp_K));
-        crypto_hash_sha512(srp_M2, message, length + sizeof(srp_M1) + sizeof(srp_K));
-        free(message);
+        crypto_hash_sha512_state state;
+        crypto_hash_sha512_init(&state);
+        crypto_hash_sha512_update(&state, abuf, length);
+        crypto_hash_sha512_update(&state, srp_M1, sizeof(srp_M1));
+        crypto_hash_sha512_update(&state, srp_K, sizeof(srp_K));
+        crypto_hash_sha512_final(&state, srp_M2);
     }
 
     return 1;
@@ -349,30 +405,6 @@ uint8_t* Srp::getK(void)
     return srp_K;
 }
 
-void crypto_sha512hmac(uint8_t* hash, uint8_t* salt, uint8_t salt_length, uint8_t* data, uint8_t data_length)
-{
-    uint8_t *message1 = (uint8_t *) malloc(128 + data_length);
-    uint8_t message2[128 + 64];
-
-    memset(message1, 0x36, 128);
-    memset(message2, 0x5C, 128);
-    for (unsigned i = salt_length; i--; )
-    {
-        message1[i] = 0x36 ^ salt[i];
-        message2[i] = 0x5C ^ salt[i];
-    }
-    memcpy(message1 + 128, data, data_length);
-    crypto_hash_sha512(message2 + 128, message1, 128 + data_length);
-    free(message1);
-    crypto_hash_sha512(hash, message2, sizeof(message2));
-}
-
-void crypto_hkdf(uint8_t* target, uint8_t* salt, uint8_t salt_length, uint8_t* info, uint8_t info_length, uint8_t* ikm, uint8_t ikm_length)
-{
-    crypto_sha512hmac(target, salt, salt_length, ikm, ikm_length);
-    crypto_sha512hmac(target, target, 64, info, info_length);
-}
-
 uint8_t crypto_verifyAndDecrypt(const uint8_t* key, uint8_t* nonce, uint8_t* encrypted, uint8_t length, uint8_t* output_buf, uint8_t* mac)
 {
     uint8_t zeros64[64];
@@ -423,15 +455,7 @@ void crypto_encryptAndSeal(const uint8_t* key, uint8_t* nonce, uint8_t* plain, u
 }
 
 void hkdf(uint8_t *target, uint8_t *ikm, uint8_t ikmLength, uint8_t *salt, uint8_t saltLength, uint8_t *info, uint8_t infoLength) {
-    uint8_t prk[64];
-    SHA512 sha = SHA512();
-    sha.resetHMAC(salt, saltLength);
-    sha.update(ikm, ikmLength);
-    sha.finalizeHMAC(salt, saltLength, prk, 64);
-
-    sha.reset();
-    sha.clear();
-    sha.resetHMAC(prk, 64);
-    sha.update(info, infoLength);
-    sha.finalizeHMAC(prk, 64, target, 32);
+    crypto_auth_hmacsha512_state prk;
+    crypto_kdf_hkdf_sha512_extract(&prk, salt, saltLength, ikm, ikmLength);
+    crypto_kdf_hkdf_sha512_expand(target, 32, &prk, info, infoLength);
 }
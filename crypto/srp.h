@@ -14,9 +14,15 @@
 #define BIGNUM_BYTES        384
 #define BIGNUM_WORDS        (BIGNUM_BYTES / 4)
 
+// Limb pool for one SRP phase (Srp::Srp or Srp::setA). Both peak at about 10.5 KB
+// with 3072 bit numbers; check mbedtls_mpi_pool_peak() when changing the window size.
+// It is allocated from the heap for each phase, see beginMPIPool() in srp.cpp.
+#define SRP_MPI_POOL_SIZE   (12 * 1024)
+
+#include <Arduino.h>
 #include <mbedtls/bignum.h>
+#include <mbedtls/mpi_pool.h>
 #include <mbedtls/sha512.h>
-#include <SHA512.h>
 #include "tweetnacl.h"
 
 
@@ -47,8 +53,6 @@ private:
     uint8_t srp_serverM1:1;
 };
 
-extern void crypto_sha512hmac(uint8_t* hash, uint8_t* salt, uint8_t salt_length, uint8_t* data, uint8_t data_length);
-
 extern uint8_t crypto_verifyAndDecryptAAD(const uint8_t* key, uint8_t* nonce, uint8_t *aad, uint8_t aadLength, uint8_t* encrypted, uint8_t length, uint8_t* output_buf, uint8_t* mac);
 extern uint8_t crypto_verifyAndDecrypt(const uint8_t* key, uint8_t* nonce, uint8_t* encrypted, uint8_t length, uint8_t* output_buf, uint8_t* mac);
 extern void crypto_encryptAndSealAAD(const uint8_t* key, uint8_t* nonce, uint8_t *aad, uint8_t aadLength, uint8_t* plain, uint16_t length, uint8_t* output_buf, uint8_t* output_mac);
@@ -5,6 +5,7 @@
  *
  * 1. Replaced salsa20 with chacha20
  * 2. Improved performance, especially around multiply routines. No assembly yet (it would probably help a great deal).
+ * 3. Field arithmetic moved to fe25519_ref.h, X25519 moved to x25519.c on top of the selectable fe25519 backends.
  *
  *  Created on: Jun 21, 2015
  *      Modified: tim
@@ -14,6 +15,9 @@
 #include <stdint.h>
 #include <osapi.h>
 
+#include "fe25519_ref.h"
+#include "sha512_state.h"
+
 #define FOR(i,n) for (i = 0;i < n;++i)
 
 typedef unsigned char u8;
@@ -23,15 +27,10 @@ typedef unsigned long u32;
 typedef unsigned long long u64;
 typedef long i32;
 typedef long long i64;
-typedef i64 gf[16];
 
-static const u8
-  _0[16],
-  _9[32] = {9};
 static const gf
   gf0,
   gf1 = {1},
-  _121665 = {0xDB41,1},
   D = {0x78a3, 0x1359, 0x4dca, 0x75eb, 0xd8ab, 0x4141, 0x0a4d, 0x0070, 0xe898, 0x7779, 0x4079, 0x8cc7, 0xfe73, 0x2b6f, 0x6cee, 0x5203},
   D2 = {0xf159, 0x26b2, 0x9b94, 0xebd6, 0xb156, 0x8283, 0x149a, 0x00e0, 0xd130, 0xeef3, 0x80f2, 0x198e, 0xfce7, 0x56df, 0xd9dc, 0x2406},
   X = {0xd51a, 0x8f25, 0x2d60, 0xc956, 0xa7b2, 0x9525, 0xc760, 0x692c, 0xdc5c, 0xfdd6, 0xe231, 0xc0a4, 0x53fe, 0xcd6e, 0x36d3, 0x2169},
@@ -222,65 +221,6 @@ int crypto_onetimeauth_poly1305_verify(const u8 *h,const u8 *m,u32 n,const u8 *k
   return crypto_verify_16(h,x);
 }
 
-static inline void set25519(gf r, const gf a)
-{
-  int i;
-  FOR(i,16) r[i]=a[i];
-}
-
-//#define MUL38(V) ((v)*38)
-#define MUL38(V) ((((((V) << 3) + (V)) << 1) + (V)) << 1)
-
-static void car25519(gf o)
-{
-  i64 c=0;
-  unsigned i;
-  FOR(i,16) {
-    i64 v=o[i]+c;
-    o[i]=v&0xFFFF;
-    c=v>>16;
-  }
-  while (c) {
-    c=MUL38(c);
-    for(i = 0; c && i < 16; i++) {
-      i64 v=o[i]+c;
-      o[i]=v&0xFFFF;
-      c=v>>16;
-    }
-  }
-}
-
-static inline void sel25519(gf p,gf q)
-{
-   gf t;
-   memcpy(t,p,sizeof(t));
-   memcpy(p,q,sizeof(t));
-   memcpy(q,t,sizeof(t));
-}
-
-static void pack25519(u8 *o,const gf n)
-{
-  int i,j,b;
-  gf m,t;
-  FOR(i,16) t[i]=n[i];
-  car25519(t);
-  FOR(j,2) {
-    m[0]=t[0]-0xffed;
-    for(i=1;i<15;i++) {
-      m[i]=t[i]-0xffff-((m[i-1]>>16)&1);
-      m[i-1]&=0xffff;
-    }
-    m[15]=t[15]-0x7fff-((m[14]>>16)&1);
-    b=(m[15]>>16)&1;
-    m[14]&=0xffff;
-    if (!b) sel25519(t,m);
-  }
-  FOR(i,16) {
-    o[2*i]=t[i]&0xff;
-    o[2*i+1]=t[i]>>8;
-  }
-}
-
 static int neq25519(const gf a, const gf b)
 {
   u8 c[32],d[32];
@@ -296,228 +236,6 @@ static u8 par25519(const gf a)
   return d[0]&1;
 }
 
-static void unpack25519(gf o, const u8 *n)
-{
-  unsigned i;
-  FOR(i,16) o[i]=(i64)(n[2*i]|((u32)n[2*i+1]<<8));
-  o[15]&=0x7fff;
-}
-
-static inline void A(gf o,const gf a,const gf b)
-{
-  unsigned i;
-  FOR(i,16) o[i]=a[i]+b[i];
-}
-
-static inline void Z(gf o,const gf a,const gf b)
-{
-  unsigned i;
-  FOR(i,16) o[i]=a[i]-b[i];
-}
-
-static inline void CS(u16 s[16], const gf o)
-{
-  i64 c=0;
-  unsigned i;
-  FOR(i,16) {
-    i64 v=o[i]+c;
-    s[i]=(u16)v;
-    c=v>>16;
-  }
-  while (c) {
-    c=MUL38(c);
-    for(i = 0; c && i < 16; i++) {
-      i64 v=s[i]+c;
-      s[i]=(u16)v;
-      c=v>>16;
-    }
-  }
-}
-
-#if defined(USE_UNACL_SCALARMULT)
-
-extern void fe25519_mul(u16 o[16], u16 x[16], u16 y[16]);
-extern void fe25519_square(u16 o[16], u16 x[16]);
-
-static void M(gf o, const gf a, const gf b)
-{
-  unsigned i;
-  u16 as[16];
-  u16 bs[16];
-  u16 os[16];
-
-  CS(as, a);
-  CS(bs, b);
-
-  fe25519_mul(os, as, bs);
-
-  FOR(i,16) o[i] = os[i];
-}
-
-static void S(gf o, const gf a)
-{
-  unsigned i;
-  u16 as[16];
-  u16 os[16];
-
-  CS(as, a);
-
-  fe25519_square(os, as);
-
-  FOR(i,16) o[i] = os[i];
-}
-
-#else
-
-static void M(gf o,const gf a,const gf b)
-{
-  unsigned i;
-  u16 as[16];
-  u16 bs[16];
-
-  CS(as, a);
-  CS(bs, b);
-
-  i64 t[31],v;
-  FOR(i,31) t[i]=0;
-  i64* pt = &t[15];
-  for (u16* asp = &as[15]; asp >= as; asp--, pt--) {
-    u32 asi = *asp;
-    i64* ppt = pt + 15;
-    for (u16* bsp = &bs[15]; bsp >= bs; bsp--, ppt--) {
-      v=*ppt;
-      v+=(i64)(asi * (u32)*bsp);
-      *ppt=v;
-    }
-  }
-  FOR(i,15) { v=t[i+16]; v=MUL38(v); o[i]=t[i]+v; }
-  o[15]=t[15]; // Problem
-}
-
-static void S(gf o,const gf a)
-{
-  unsigned i,j;
-  u16 as[16];
-
-  CS(as, a);
-
-  i64 t[31],v;
-  FOR(i,31) t[i]=0;
-  FOR(i,16) {
-    u32 ai = (u32)as[i];
-    t[i<<1]+=(u32)(ai*ai);
-    for(j=i+1;j<16;j++) {
-      v=t[i+j];
-      v+=((i64)(ai*(u32)as[j]))<<1;
-      t[i+j]=v;
-    }
-  }
-  FOR(i,15) { v=t[i+16]; v=MUL38(v); o[i]=t[i]+v; }
-  o[15]=t[15];
-}
-
-#endif
-
-static void inv25519(gf o,const gf i)
-{
-  gf c;
-  int a;
-  FOR(a,16) c[a]=i[a];
-  for(a=249;a;a--) {
-    S(c,c);
-    M(c,c,i);
-  }
-  S(c,c);
-  S(c,c);
-  M(c,c,i);
-  S(c,c);
-  S(c,c);
-  M(c,c,i);
-  S(c,c);
-  M(c,c,i);
-  FOR(a,16) o[a]=c[a];
-}
-
-static void pow2523(gf o,const gf i)
-{
-  gf c;
-  int a;
-  FOR(a,16) c[a]=i[a];
-  for(a=249;a;a--) {
-    S(c,c);
-    M(c,c,i);
-  }
-  S(c,c);
-  S(c,c);
-  M(c,c,i);
-  FOR(a,16) o[a]=c[a];
-}
-
-//#if defined(USE_TWEETNACL_SCALARMULT)
-
-int crypto_scalarmult_curve25519(u8 *q,const u8 *n,const u8 *p)
-{
-  u8 z[32],r;
-  i64 x[80];
-  int i;
-  gf a,b,c,d,e,f;
-  FOR(i,31) z[i]=n[i];
-  z[31]=(n[31]&127)|64;
-  z[0]&=248;
-  unpack25519(x,p);
-  FOR(i,16) {
-    b[i]=x[i];
-    d[i]=a[i]=c[i]=0;
-  }
-  a[0]=d[0]=1;
-  for(i=254;i>=0;--i) {
-    r=(z[i>>3]>>(i&7))&1;
-    if(r) {
-      sel25519(a,b);
-      sel25519(c,d);
-    }
-    A(e,a,c);
-    Z(a,a,c);
-    A(c,b,d);
-    Z(b,b,d);
-    S(d,e);
-    S(f,a);
-    M(a,c,a);
-    M(c,b,e);
-    A(e,a,c);
-    Z(a,a,c);
-    S(b,a);
-    Z(c,d,f);
-    M(a,c,_121665);
-    A(a,a,d);
-    M(c,c,a);
-    M(a,d,f);
-    M(d,b,x);
-    S(b,e);
-    if(r) {
-      sel25519(a,b);
-      sel25519(c,d);
-    }
-  }
-  FOR(i,16) {
-    x[i+16]=a[i];
-    x[i+32]=c[i];
-    x[i+48]=b[i];
-    x[i+64]=d[i];
-  }
-  inv25519(x+32,x+32);
-  M(x+16,x+16,x+32);
-  pack25519(q,x+16);
-  return 0;
-}
-
-int crypto_scalarmult_curve25519_base(u8 *q,const u8 *n)
-{
-  return crypto_scalarmult_curve25519(q,n,_9);
-}
-
-//#endif
-
 static u64 R(u64 x,int c) { return (x >> c) | (x << (64 - c)); }
 static u64 Ch(u64 x,u64 y,u64 z) { return (x & y) ^ (~x & z); }
 static u64 Maj(u64 x,u64 y,u64 z) { return (x & y) ^ (x & z) ^ (y & z); }
@@ -619,6 +337,145 @@ int crypto_hash_sha512(u8 *out,const u8 *m,u64 n)
   return 0;
 }
 
+int crypto_hash_sha512_init(crypto_hash_sha512_state *state)
+{
+  int i;
+  FOR(i,64) state->h[i] = iv[i];
+  state->length = 0;
+  state->buffered = 0;
+  return 0;
+}
+
+int crypto_hash_sha512_update(crypto_hash_sha512_state *state,const u8 *m,u64 n)
+{
+  u64 i,take,blocks;
+
+  state->length += n;
+
+  if (state->buffered) {
+    take = 128 - state->buffered;
+    if (take > n) take = n;
+    FOR(i,take) state->buffer[state->buffered + i] = m[i];
+    state->buffered += take;
+    m += take;
+    n -= take;
+    if (state->buffered < 128) return 0;
+    crypto_hashblocks_sha512(state->h,state->buffer,128);
+    state->buffered = 0;
+  }
+
+  blocks = n & ~(u64)127;
+  if (blocks) {
+    crypto_hashblocks_sha512(state->h,m,blocks);
+    m += blocks;
+    n -= blocks;
+  }
+
+  FOR(i,n) state->buffer[i] = m[i];
+  state->buffered = n;
+  return 0;
+}
+
+int crypto_hash_sha512_final(crypto_hash_sha512_state *state,u8 *out)
+{
+  u64 i,n = state->buffered;
+
+  state->buffer[n++] = 128;
+  if (n > 112) {
+    for (i = n;i < 128;++i) state->buffer[i] = 0;
+    crypto_hashblocks_sha512(state->h,state->buffer,128);
+    n = 0;
+  }
+  for (i = n;i < 119;++i) state->buffer[i] = 0;
+  state->buffer[119] = state->length >> 61;
+  ts64(state->buffer + 120,state->length << 3);
+  crypto_hashblocks_sha512(state->h,state->buffer,128);
+
+  FOR(i,64) out[i] = state->h[i];
+  return 0;
+}
+
+int crypto_auth_hmacsha512_init(crypto_auth_hmacsha512_state *state,const u8 *k,u64 n)
+{
+  u8 pad[128],kh[64];
+  u64 i;
+
+  if (n > 128) {
+    crypto_hash_sha512(kh,k,n);
+    k = kh;
+    n = 64;
+  }
+
+  FOR(i,128) pad[i] = 0x36 ^ (i < n ? k[i] : 0);
+  crypto_hash_sha512_init(&state->ictx);
+  crypto_hash_sha512_update(&state->ictx,pad,128);
+
+  FOR(i,128) pad[i] = 0x5c ^ (i < n ? k[i] : 0);
+  crypto_hash_sha512_init(&state->octx);
+  crypto_hash_sha512_update(&state->octx,pad,128);
+
+  FOR(i,128) pad[i] = 0;
+  FOR(i,64) kh[i] = 0;
+  return 0;
+}
+
+int crypto_auth_hmacsha512_update(crypto_auth_hmacsha512_state *state,const u8 *m,u64 n)
+{
+  return crypto_hash_sha512_update(&state->ictx,m,n);
+}
+
+int crypto_auth_hmacsha512_final(crypto_auth_hmacsha512_state *state,u8 *out)
+{
+  u8 ih[64];
+  u64 i;
+
+  crypto_hash_sha512_final(&state->ictx,ih);
+  crypto_hash_sha512_update(&state->octx,ih,64);
+  crypto_hash_sha512_final(&state->octx,out);
+
+  FOR(i,64) ih[i] = 0;
+  return 0;
+}
+
+int crypto_kdf_hkdf_sha512_extract(crypto_auth_hmacsha512_state *prk,const u8 *salt,u64 saltlen,const u8 *ikm,u64 ikmlen)
+{
+  u8 k[64];
+  u64 i;
+
+  crypto_auth_hmacsha512_init(prk,salt,saltlen);
+  crypto_auth_hmacsha512_update(prk,ikm,ikmlen);
+  crypto_auth_hmacsha512_final(prk,k);
+  crypto_auth_hmacsha512_init(prk,k,64);
+
+  FOR(i,64) k[i] = 0;
+  return 0;
+}
+
+int crypto_kdf_hkdf_sha512_expand(u8 *out,u64 outlen,const crypto_auth_hmacsha512_state *prk,const u8 *info,u64 infolen)
+{
+  crypto_auth_hmacsha512_state st;
+  u8 t[64],counter;
+  u64 i,take;
+
+  if (outlen > 255 * 64) return -1;
+
+  for (counter = 1;outlen;++counter) {
+    st = *prk;
+    if (counter > 1) crypto_auth_hmacsha512_update(&st,t,64);
+    crypto_auth_hmacsha512_update(&st,info,infolen);
+    crypto_auth_hmacsha512_update(&st,&counter,1);
+    crypto_auth_hmacsha512_final(&st,t);
+
+    take = outlen < 64 ? outlen : 64;
+    FOR(i,take) out[i] = t[i];
+    out += take;
+    outlen -= take;
+  }
+
+  FOR(i,64) t[i] = 0;
+  return 0;
+}
+
 static void add(gf p[4],gf q[4])
 {
   gf a,b,c,d,t,e,f,g,h;
@@ -738,6 +595,11 @@ static void reduce(u8 *r)
   modL(r,x);
 }
 
+void crypto_sign_ed25519_sc_reduce(u8 *s)
+{
+  reduce(s);
+}
+
 int crypto_sign_ed25519(u8 *sm,u64 *smlen,const u8 *m,u64 n,const u8 *sk)
 {
   u8 d[64],h[64],r[64];
@@ -770,6 +632,44 @@ int crypto_sign_ed25519(u8 *sm,u64 *smlen,const u8 *m,u64 n,const u8 *sk)
   return 0;
 }
 
+void crypto_sign_ed25519_expand(u8 *az,const u8 *seed)
+{
+  crypto_hash_sha512(az, seed, 32);
+  az[0] &= 248;
+  az[31] &= 127;
+  az[31] |= 64;
+}
+
+int crypto_sign_ed25519_detached(u8 *sig,const u8 *m,u64 n,const u8 *az,const u8 *pk)
+{
+  u8 h[64],r[64];
+  i64 i,j,x[64];
+  gf p[4];
+  crypto_hash_sha512_state hs;
+
+  crypto_hash_sha512_init(&hs);
+  crypto_hash_sha512_update(&hs, az + 32, 32);
+  crypto_hash_sha512_update(&hs, m, n);
+  crypto_hash_sha512_final(&hs, r);
+  reduce(r);
+  scalarbase(p,r);
+  pack(sig,p);
+
+  crypto_hash_sha512_init(&hs);
+  crypto_hash_sha512_update(&hs, sig, 32);
+  crypto_hash_sha512_update(&hs, pk, 32);
+  crypto_hash_sha512_update(&hs, m, n);
+  crypto_hash_sha512_final(&hs, h);
+  reduce(h);
+
+  FOR(i,64) x[i] = 0;
+  FOR(i,32) x[i] = (u64) r[i];
+  FOR(i,32) FOR(j,32) x[i+j] += h[i] * (u64) az[j];
+  modL(sig + 32,x);
+
+  return 0;
+}
+
 static int unpackneg(gf r[4],const u8 p[32])
 {
   gf t, chk, num, den, den2, den4, den6;
@@ -8,6 +8,8 @@
 #ifndef HOMEKIT_TWEETNACL_TWEETNACL_H_
 #define HOMEKIT_TWEETNACL_TWEETNACL_H_
 
+#include "sha512_state.h"
+
 #define crypto_sign_keypair     crypto_sign_ed25519_keypair
 #define crypto_sign_open        crypto_sign_ed25519_open
 #define crypto_sign             crypto_sign_ed25519
@@ -27,6 +29,10 @@ extern int crypto_onetimeauth_poly1305_verify(const unsigned char *,const unsign
 extern int crypto_sign_ed25519(unsigned char *,unsigned long long *,const unsigned char *,unsigned long long,const unsigned char *);
 extern int crypto_sign_ed25519_open(unsigned char *,unsigned long long *,const unsigned char *,unsigned long long,const unsigned char *);
 extern int crypto_sign_ed25519_keypair(unsigned char *,unsigned char *);
+extern void crypto_sign_ed25519_expand(unsigned char *,const unsigned char *);
+extern int crypto_sign_ed25519_detached(unsigned char *,const unsigned char *,unsigned long long,const unsigned char *,const unsigned char *);
+extern int crypto_sign_ed25519_verify_detached(const unsigned char *,const unsigned char *,unsigned long long,const unsigned char *);
+extern void crypto_sign_ed25519_sc_reduce(unsigned char *);
 
 extern int crypto_stream_chacha20_xor(unsigned char *,const unsigned char *,unsigned long long,const unsigned char *,const unsigned char *,const unsigned char);
 
@@ -0,0 +1,72 @@
+/*
+ * x25519.c
+ *
+ * X25519 (RFC 7748) Montgomery ladder on top of the field backend selected
+ * in fe25519.h. Replaces the 16 bit only scalar multiplication of tweetnacl.
+ */
+
+#include "fe25519.h"
+#include "tweetnacl.h"
+
+static const unsigned char basepoint[32] = {9};
+
+int crypto_scalarmult_curve25519(unsigned char *q, const unsigned char *n, const unsigned char *p)
+{
+  unsigned char e[32];
+  fe25519 x1, x2, z2, x3, z3, a, b, aa, bb, da, cb, e2;
+  unsigned int swap = 0, bit;
+  int i;
+
+  memcpy(e, n, 32);
+  e[0] &= 248;
+  e[31] &= 127;
+  e[31] |= 64;
+
+  fe25519_frombytes(x1, p);
+  fe25519_1(x2);
+  fe25519_0(z2);
+  fe25519_copy(x3, x1);
+  fe25519_1(z3);
+
+  for (i = 254; i >= 0; --i) {
+    bit = (e[i >> 3] >> (i & 7)) & 1;
+    swap ^= bit;
+    fe25519_cswap(x2, x3, swap);
+    fe25519_cswap(z2, z3, swap);
+    swap = bit;
+
+    fe25519_add(a, x2, z2);       /* A = x2 + z2 */
+    fe25519_sub(b, x2, z2);       /* B = x2 - z2 */
+    fe25519_sq(aa, a);            /* AA = A^2 */
+    fe25519_sq(bb, b);            /* BB = B^2 */
+    fe25519_add(cb, x3, z3);      /* C = x3 + z3 */
+    fe25519_sub(da, x3, z3);      /* D = x3 - z3 */
+    fe25519_mul(da, da, a);       /* DA = D * A */
+    fe25519_mul(cb, cb, b);       /* CB = C * B */
+    fe25519_sub(e2, aa, bb);      /* E = AA - BB */
+
+    fe25519_add(x3, da, cb);
+    fe25519_sq(x3, x3);           /* x3 = (DA + CB)^2 */
+    fe25519_sub(z3, da, cb);
+    fe25519_sq(z3, z3);
+    fe25519_mul(z3, x1, z3);      /* z3 = x1 * (DA - CB)^2 */
+    fe25519_mul(x2, aa, bb);      /* x2 = AA * BB */
+    fe25519_mul121665(a, e2);
+    fe25519_add(a, aa, a);
+    fe25519_mul(z2, e2, a);       /* z2 = E * (AA + a24 * E) */
+  }
+  fe25519_cswap(x2, x3, swap);
+  fe25519_cswap(z2, z3, swap);
+
+  fe25519_invert(z2, z2);
+  fe25519_mul(x2, x2, z2);
+  fe25519_tobytes(q, x2);
+
+  memset(e, 0, sizeof(e));
+  return 0;
+}
+
+int crypto_scalarmult_curve25519_base(unsigned char *q, const unsigned char *n)
+{
+  return crypto_scalarmult_curve25519(q, n, basepoint);
+}
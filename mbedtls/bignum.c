@@ -54,9 +54,15 @@
 #include <stdio.h>
 #include <stdlib.h>
 #define mbedtls_printf     printf
+#if defined(MBEDTLS_MPI_POOL_C)
+#include "mpi_pool.h"
+#define mbedtls_calloc    mbedtls_mpi_pool_calloc
+#define mbedtls_free       mbedtls_mpi_pool_free
+#else
 #define mbedtls_calloc    calloc
 #define mbedtls_free       free
 #endif
+#endif
 
 /* Implementation that should never be optimized out by the compiler */
 static void mbedtls_mpi_zeroize( mbedtls_mpi_uint *v, size_t n ) {
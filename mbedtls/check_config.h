@@ -250,6 +250,11 @@
 #error "MBEDTLS_MEMORY_BUFFER_ALLOC_C defined, but not all prerequisites"
 #endif
 
+#if defined(MBEDTLS_MPI_POOL_C) &&                                     \
+    ( !defined(MBEDTLS_BIGNUM_C) || defined(MBEDTLS_PLATFORM_C) )
+#error "MBEDTLS_MPI_POOL_C defined, but not all prerequisites"
+#endif
+
 #if defined(MBEDTLS_PADLOCK_C) && !defined(MBEDTLS_HAVE_ASM)
 #error "MBEDTLS_PADLOCK_C defined, but not all prerequisites"
 #endif
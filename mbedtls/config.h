@@ -1673,6 +1673,19 @@
  */
 #define MBEDTLS_BIGNUM_C
 
+/**
+ * \def MBEDTLS_MPI_POOL_C
+ *
+ * Let the bignum library take its limbs from a caller supplied buffer while
+ * one is attached with mbedtls_mpi_pool_init() (not part of upstream).
+ *
+ * Module:  mpi_pool.c
+ * Caller:  bignum.c
+ *
+ * Requires: MBEDTLS_BIGNUM_C, !MBEDTLS_PLATFORM_C
+ */
+#define MBEDTLS_MPI_POOL_C
+
 /**
  * \def MBEDTLS_BLOWFISH_C
  *
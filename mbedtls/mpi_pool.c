@@ -0,0 +1,169 @@
+/*
+ *  Bounded pool allocator for bignum limbs
+ *
+ *  Not part of upstream mbed TLS, see mpi_pool.h.
+ *
+ *  Layout: [hdr|data][hdr|data]...[hdr|data] top ... end
+ *
+ *  Every block starts with a header holding its total size and whether it
+ *  is in use. New blocks are taken from the first free block that is large
+ *  enough (splitting off the rest) or pushed at the top. Freeing a block
+ *  drops the top back to the end of the last used block.
+ */
+
+#if !defined(MBEDTLS_CONFIG_FILE)
+#include "config.h"
+#else
+#include MBEDTLS_CONFIG_FILE
+#endif
+
+#if defined(MBEDTLS_MPI_POOL_C)
+
+#include "mpi_pool.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct
+{
+    size_t size;    /* total block size including this header */
+    size_t used;
+} mpi_pool_block;
+
+#define MPI_POOL_ALIGN      8
+#define MPI_POOL_HDR        ( ( sizeof( mpi_pool_block ) + MPI_POOL_ALIGN - 1 ) & ~( MPI_POOL_ALIGN - 1 ) )
+#define MPI_POOL_BLOCK( o ) ( (mpi_pool_block *) ( pool.buf + ( o ) ) )
+
+static struct
+{
+    unsigned char *buf;
+    size_t len;
+    size_t top;
+    size_t peak;
+    size_t overflows;
+    unsigned char *orphan;  /* pool released with blocks in use */
+    size_t orphan_len;
+} pool;
+
+void mbedtls_mpi_pool_init( unsigned char *buf, size_t len )
+{
+    pool.buf = buf;
+    pool.len = len & ~( MPI_POOL_ALIGN - 1 );
+    pool.top = 0;
+    pool.peak = 0;
+    pool.overflows = 0;
+}
+
+size_t mbedtls_mpi_pool_release( void )
+{
+    size_t off, leaked = 0;
+
+    for( off = 0; off < pool.top; off += MPI_POOL_BLOCK( off )->size )
+        if( MPI_POOL_BLOCK( off )->used )
+            leaked += MPI_POOL_BLOCK( off )->size;
+
+    /* The caller has to keep the buffer, blocks still in it are not
+     * handed to free() later */
+    if( leaked != 0 )
+    {
+        pool.orphan = pool.buf;
+        pool.orphan_len = pool.len;
+    }
+
+    pool.buf = NULL;
+    pool.len = 0;
+    pool.top = 0;
+
+    return( leaked );
+}
+
+void *mbedtls_mpi_pool_calloc( size_t n, size_t size )
+{
+    mpi_pool_block *b, *next;
+    size_t off, need;
+
+    if( pool.buf == NULL )
+        return( calloc( n, size ) );
+
+    if( size != 0 && n > ( pool.len - MPI_POOL_HDR ) / size )
+        goto overflow;
+
+    need = MPI_POOL_HDR + ( ( n * size + MPI_POOL_ALIGN - 1 ) & ~( MPI_POOL_ALIGN - 1 ) );
+
+    /* First fit below the top, merging runs of free blocks on the way */
+    for( off = 0; off < pool.top; off += b->size )
+    {
+        b = MPI_POOL_BLOCK( off );
+        if( b->used )
+            continue;
+
+        while( off + b->size < pool.top && !( next = MPI_POOL_BLOCK( off + b->size ) )->used )
+            b->size += next->size;
+
+        if( b->size < need )
+            continue;
+
+        if( b->size - need >= MPI_POOL_HDR + MPI_POOL_ALIGN )
+        {
+            next = MPI_POOL_BLOCK( off + need );
+            next->size = b->size - need;
+            next->used = 0;
+            b->size = need;
+        }
+        b->used = 1;
+        memset( (unsigned char *) b + MPI_POOL_HDR, 0, b->size - MPI_POOL_HDR );
+        return( (unsigned char *) b + MPI_POOL_HDR );
+    }
+
+    if( need > pool.len - pool.top )
+        goto overflow;
+
+    b = MPI_POOL_BLOCK( pool.top );
+    b->size = need;
+    b->used = 1;
+    pool.top += need;
+    if( pool.top > pool.peak )
+        pool.peak = pool.top;
+
+    memset( (unsigned char *) b + MPI_POOL_HDR, 0, need - MPI_POOL_HDR );
+    return( (unsigned char *) b + MPI_POOL_HDR );
+
+overflow:
+    pool.overflows++;
+    return( calloc( n, size ) );
+}
+
+void mbedtls_mpi_pool_free( void *ptr )
+{
+    unsigned char *p = (unsigned char *) ptr;
+    size_t off, end = 0;
+
+    if( pool.orphan != NULL && p >= pool.orphan && p < pool.orphan + pool.orphan_len )
+        return;
+
+    if( pool.buf == NULL || p < pool.buf || p >= pool.buf + pool.len )
+    {
+        free( ptr );
+        return;
+    }
+
+    ( (mpi_pool_block *) ( p - MPI_POOL_HDR ) )->used = 0;
+
+    /* Pop every free block that now sits at the top */
+    for( off = 0; off < pool.top; off += MPI_POOL_BLOCK( off )->size )
+        if( MPI_POOL_BLOCK( off )->used )
+            end = off + MPI_POOL_BLOCK( off )->size;
+    pool.top = end;
+}
+
+size_t mbedtls_mpi_pool_peak( void )
+{
+    return( pool.peak );
+}
+
+size_t mbedtls_mpi_pool_overflows( void )
+{
+    return( pool.overflows );
+}
+
+#endif /* MBEDTLS_MPI_POOL_C */
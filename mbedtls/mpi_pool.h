@@ -0,0 +1,70 @@
+/**
+ * \file mpi_pool.h
+ *
+ * \brief  Bounded pool allocator for bignum limbs
+ *
+ *  Not part of upstream mbed TLS.
+ *
+ *  While a pool is attached, mbedtls_mpi_grow() and mbedtls_mpi_shrink()
+ *  take their limbs from one caller supplied buffer instead of the heap.
+ *  Blocks are carved off the top of the buffer like a stack; freed blocks
+ *  are merged with their free neighbours and popped again once they reach
+ *  the top, so the short-lived temporaries of mbedtls_mpi_exp_mod() are
+ *  reused in place instead of fragmenting the heap.
+ *
+ *  The pool is meant to live for one computation: attach it, run the
+ *  bignum code, free every mbedtls_mpi and detach it again. Requests that
+ *  do not fit fall back to calloc() and are counted, so an undersized pool
+ *  degrades to the old behaviour instead of failing.
+ */
+#ifndef MBEDTLS_MPI_POOL_H
+#define MBEDTLS_MPI_POOL_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * \brief          Attach a buffer as limb pool and reset the statistics
+ *
+ * \param buf      Buffer, aligned for mbedtls_mpi_uint
+ * \param len      Size of the buffer in bytes
+ */
+void mbedtls_mpi_pool_init( unsigned char *buf, size_t len );
+
+/**
+ * \brief          Detach the pool. All blocks must have been freed.
+ *
+ *                 If blocks are still in use the buffer must not be freed.
+ *                 Later frees of those blocks are ignored.
+ *
+ * \return         0 if the pool was empty, otherwise the number of bytes
+ *                 that were still allocated
+ */
+size_t mbedtls_mpi_pool_release( void );
+
+/**
+ * \brief          Allocation hooks used by bignum.c
+ */
+void *mbedtls_mpi_pool_calloc( size_t n, size_t size );
+void mbedtls_mpi_pool_free( void *ptr );
+
+/**
+ * \brief          Highest number of pool bytes in use (including block
+ *                 headers) since the last mbedtls_mpi_pool_init()
+ */
+size_t mbedtls_mpi_pool_peak( void );
+
+/**
+ * \brief          Number of allocations since the last
+ *                 mbedtls_mpi_pool_init() that did not fit and went to the heap
+ */
+size_t mbedtls_mpi_pool_overflows( void );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* mpi_pool.h */
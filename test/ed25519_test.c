@@ -0,0 +1,219 @@
+/*
+ * Host test and benchmark for crypto/ed25519.c
+ *
+ * Build and run from the repository root:
+ *   cc -O2 -Itest/host -o ed25519_test test/ed25519_test.c crypto/ed25519.c crypto/tweetnacl.c crypto/x25519.c && ./ed25519_test
+ *
+ * Checks the RFC 8032 section 7.1 vectors 1 to 3, rejects tampered and non-canonical signatures and compares
+ * crypto_sign_ed25519_verify_detached with the tweetnacl crypto_sign_ed25519_open it replaced on random
+ * signatures. The benchmark prints both per verification. Add -DFE25519_BACKEND=0, 1 or 2 to test another
+ * field backend.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_RDTSC 1
+#endif
+
+#include "../crypto/tweetnacl.h"
+
+int os_get_random(unsigned char *buf, size_t len)
+{
+  size_t i;
+  for (i = 0; i < len; i++) buf[i] = rand();
+  return 0;
+}
+
+struct vector {
+  const char *secret;
+  const char *public;
+  const char *message;
+  const char *signature;
+};
+
+static const struct vector vectors[] = {
+  {
+    "9d61b19deffd5a60ba844af492ec2cc44449c5697b326919703bac031cae7f60",
+    "d75a980182b10ab7d54bfed3c964073a0ee172f3daa62325af021a68f707511a",
+    "",
+    "e5564300c360ac729086e2cc806e828a84877f1eb8e5d974d873e065224901555fb8821590a33bacc61e39701cf9b46bd25bf5f0595bbe24655141438e7a100b"
+  },
+  {
+    "4ccd089b28ff96da9db6c346ec114e0f5b8a319f35aba624da8cf6ed4fb8a6fb",
+    "3d4017c3e843895a92b70aa74d1b7ebc9c982ccf2ec4968cc0cd55f12af4660c",
+    "72",
+    "92a009a9f0d4cab8720e820b5f642540a2b27b5416503f8fb3762223ebdb69da085ac1e43e15996e458f3613d0f11d8c387b2eaeb4302aeeb00d291612bb0c00"
+  },
+  {
+    "c5aa8df43f9f837bedb7442f31dcb7b166d38535076f094b85ce3a2e0b4458f7",
+    "fc51cd8e6218a1a38da47ed00230f0580816ed13ba3303ac5deb911548908025",
+    "af82",
+    "6291d657deec24024827e69c3abe01a30ce548a284743a445e3680d7db5ac3ac18ff9b538d16f290ae67f760984dc6594a7c15e9716ed28dc027beceea1ec40a"
+  }
+};
+
+/* Group order, little endian */
+static const unsigned char order[32] = {
+  0xed, 0xd3, 0xf5, 0x5c, 0x1a, 0x63, 0x12, 0x58, 0xd6, 0x9c, 0xf7, 0xa2, 0xde, 0xf9, 0xde, 0x14,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10
+};
+
+static int failures = 0;
+
+static size_t fromHex(unsigned char *target, const char *hex)
+{
+  size_t length = strlen(hex) / 2, i;
+  for (i = 0; i < length; i++) {
+    unsigned int byte;
+    sscanf(hex + 2 * i, "%2x", &byte);
+    target[i] = byte;
+  }
+  return length;
+}
+
+static void expect(int condition, const char *what, int vector)
+{
+  if (!condition) {
+    printf("vector %d: %s\n", vector, what);
+    failures++;
+  }
+}
+
+/* tweetnacl verification as used before, signature and message are passed as one buffer */
+static int verifyOpen(const unsigned char *sig, const unsigned char *m, unsigned long long n, const unsigned char *pk)
+{
+  unsigned char sm[64 + 256], out[64 + 256];
+  unsigned long long outLength;
+  memcpy(sm, sig, 64);
+  memcpy(sm + 64, m, n);
+  return crypto_sign_ed25519_open(out, &outLength, sm, n + 64, pk);
+}
+
+static void testVectors(void)
+{
+  int v;
+  for (v = 0; v < (int) (sizeof(vectors) / sizeof(vectors[0])); v++) {
+    unsigned char seed[32], pk[32], az[64], m[16], sig[64], expected[64], tampered[64];
+    size_t n;
+    int i, carry;
+
+    fromHex(seed, vectors[v].secret);
+    fromHex(pk, vectors[v].public);
+    n = fromHex(m, vectors[v].message);
+    fromHex(expected, vectors[v].signature);
+
+    crypto_sign_ed25519_expand(az, seed);
+    crypto_sign_ed25519_detached(sig, m, n, az, pk);
+    expect(memcmp(sig, expected, 64) == 0, "signature differs", v + 1);
+    expect(crypto_sign_ed25519_verify_detached(expected, m, n, pk) == 0, "valid signature rejected", v + 1);
+
+    memcpy(tampered, expected, 64);
+    tampered[0] ^= 1;
+    expect(crypto_sign_ed25519_verify_detached(tampered, m, n, pk) != 0, "flipped bit in R accepted", v + 1);
+
+    memcpy(tampered, expected, 64);
+    tampered[32] ^= 1;
+    expect(crypto_sign_ed25519_verify_detached(tampered, m, n, pk) != 0, "flipped bit in S accepted", v + 1);
+
+    memcpy(tampered, expected, 64);
+    tampered[63] |= 0x80;
+    expect(crypto_sign_ed25519_verify_detached(tampered, m, n, pk) != 0, "S with top bit set accepted", v + 1);
+
+    /* S + L is the same scalar, but not canonical */
+    memcpy(tampered, expected, 64);
+    for (i = 0, carry = 0; i < 32; i++) {
+      carry += tampered[32 + i] + order[i];
+      tampered[32 + i] = carry;
+      carry >>= 8;
+    }
+    expect(crypto_sign_ed25519_verify_detached(tampered, m, n, pk) != 0, "non-canonical S accepted", v + 1);
+
+    m[0] ^= 1;
+    expect(n == 0 || crypto_sign_ed25519_verify_detached(expected, m, n, pk) != 0, "changed message accepted", v + 1);
+    m[0] ^= 1;
+
+    pk[0] ^= 1;
+    expect(crypto_sign_ed25519_verify_detached(expected, m, n, pk) != 0, "wrong public key accepted", v + 1);
+  }
+}
+
+/* Random keys and messages, with every fourth signature damaged, have to be judged like tweetnacl does */
+static void testRandom(int count)
+{
+  int i, mismatches = 0, accepted = 0;
+  for (i = 0; i < count; i++) {
+    unsigned char seed[32], pk[32], sk[64], az[64], m[256], sig[64];
+    unsigned long long n = rand() % sizeof(m);
+    int ours, reference;
+
+    crypto_sign_ed25519_keypair(pk, sk);
+    memcpy(seed, sk, 32);
+    crypto_sign_ed25519_expand(az, seed);
+    os_get_random(m, n);
+    crypto_sign_ed25519_detached(sig, m, n, az, pk);
+    if (i % 4 == 3) {
+      int bit = rand() % 512;
+      sig[bit / 8] ^= 1 << (bit % 8);
+    }
+
+    ours = crypto_sign_ed25519_verify_detached(sig, m, n, pk);
+    reference = verifyOpen(sig, m, n, pk);
+    if ((ours == 0) != (reference == 0)) mismatches++;
+    if (ours == 0) accepted++;
+  }
+  printf("random: %d of %d accepted, %d differ from tweetnacl\n", accepted, count, mismatches);
+  failures += mismatches;
+  if (accepted != count - count / 4) failures++;
+}
+
+static double now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static unsigned long long cycles(void)
+{
+#ifdef HAVE_RDTSC
+  return __rdtsc();
+#else
+  return 0;
+#endif
+}
+
+static void benchmark(const char *name, int (*verify)(const unsigned char *, const unsigned char *, unsigned long long, const unsigned char *), int iterations)
+{
+  unsigned char seed[32], pk[32], az[64], m[100], sig[64];
+  double start;
+  unsigned long long startCycles;
+  int i, result = 0;
+
+  fromHex(seed, vectors[0].secret);
+  fromHex(pk, vectors[0].public);
+  memset(m, 0x5a, sizeof(m));
+  crypto_sign_ed25519_expand(az, seed);
+  crypto_sign_ed25519_detached(sig, m, sizeof(m), az, pk);
+
+  start = now();
+  startCycles = cycles();
+  for (i = 0; i < iterations; i++) result |= verify(sig, m, sizeof(m), pk);
+  printf("benchmark: %s %.1f us, %llu cycles per verify%s\n", name, (now() - start) * 1e6 / iterations,
+         (cycles() - startCycles) / iterations, result ? " (FAILED)" : "");
+  if (result) failures++;
+}
+
+int main(void)
+{
+  testVectors();
+  testRandom(2000);
+  benchmark("verify_detached", crypto_sign_ed25519_verify_detached, 2000);
+  benchmark("tweetnacl open", verifyOpen, 200);
+
+  printf("%s\n", failures ? "FAILED" : "OK");
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,175 @@
+//
+// Host test and benchmark for JSON/f2s.cpp
+//
+// Build and run from the repository root:
+//   g++ -O2 -std=gnu++11 -Itest/host -IJSON -o f2s_test test/f2s_test.cpp JSON/f2s.cpp && ./f2s_test
+//
+// Without arguments every positive finite float is formatted and parsed back with strtof, which takes a few
+// minutes. Pass a stride, e.g. ./f2s_test 101, for a quick run over every 101st float.
+//
+
+#include "f2s.h"
+
+#include <chrono>
+#include <cmath>
+#include <stdio.h>
+
+static float fromBits(uint32_t bits) {
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static uint32_t toBits(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+/**
+ * @brief Every float has to parse back to the same bits, the negative one too
+ */
+static unsigned long testRoundTrip(uint32_t stride) {
+    char buffer[F2S_MAX_LENGTH + 1];
+    unsigned long failures = 0;
+    size_t longest = 0;
+    for (uint64_t bits = 1; bits < 0x7F800000u; bits += stride) {
+        float value = fromBits(bits);
+        size_t length = f2s_format(buffer, value);
+        buffer[length] = '\0';
+        if (length > longest) {
+            longest = length;
+        }
+        if (length > F2S_MAX_LENGTH || toBits(strtof(buffer, nullptr)) != bits) {
+            if (failures++ < 10) {
+                printf("round trip failed: %08x -> %s\n", (uint32_t) bits, buffer);
+            }
+        }
+
+        length = f2s_format(buffer, -value);
+        buffer[length] = '\0';
+        if (buffer[0] != '-' || toBits(strtof(buffer, nullptr)) != (bits | 0x80000000u)) {
+            if (failures++ < 10) {
+                printf("round trip failed: -%08x -> %s\n", (uint32_t) bits, buffer);
+            }
+        }
+    }
+    printf("round trip: %lu failures, longest %u characters\n", failures, (unsigned) longest);
+    return failures;
+}
+
+/**
+ * @brief No shorter digit string may round trip, and of all strings with that many digits the closest is taken.
+ * printf is correctly rounded, so it is the reference for both.
+ */
+static unsigned long testShortest(uint32_t stride) {
+    unsigned long failures = 0;
+    unsigned long checked = 0;
+    for (uint64_t bits = 1; bits < 0x7F800000u; bits += stride) {
+        float value = fromBits(bits);
+        FloatDecimal decimal = f2s_decimal(value);
+        int digits = snprintf(nullptr, 0, "%u", decimal.mantissa);
+        char reference[40];
+        if (digits > 1) {
+            snprintf(reference, sizeof(reference), "%.*e", digits - 2, value);
+            if (strtof(reference, nullptr) == value) {
+                if (failures++ < 10) {
+                    printf("not shortest: %08x %ue%d, %s\n", (uint32_t) bits, decimal.mantissa, decimal.exponent, reference);
+                }
+            }
+        }
+
+        char result[40];
+        snprintf(reference, sizeof(reference), "%.*e", digits - 1, value);
+        snprintf(result, sizeof(result), "%ue%d", decimal.mantissa, decimal.exponent);
+        if (strtod(reference, nullptr) != strtod(result, nullptr) && strtof(reference, nullptr) == value) {
+            if (failures++ < 10) {
+                printf("not closest: %08x %s, %s\n", (uint32_t) bits, result, reference);
+            }
+        }
+        checked++;
+    }
+    printf("shortest: %lu failures in %lu values\n", failures, checked);
+    return failures;
+}
+
+static unsigned long expect(const char *result, const char *expected) {
+    if (strcmp(result, expected) != 0) {
+        printf("expected %s, got %s\n", expected, result);
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Fixed values, including zero, exponent switches and minStep rounding
+ */
+static unsigned long testValues() {
+    struct {
+        float value;
+        const char *expected;
+    } values[] = {
+            {0.0f, "0"}, {-0.0f, "0"}, {21.5f, "21.5"}, {-21.5f, "-21.5"}, {0.1f, "0.1"}, {100.0f, "100"},
+            {123456789.0f, "123456790"}, {1e-7f, "1e-7"}, {1e21f, "1e+21"}, {3.4028235e38f, "3.4028235e+38"},
+            {1.4e-45f, "1e-45"}
+    };
+    struct {
+        float value;
+        float step;
+        const char *expected;
+    } steps[] = {
+            {21.4999f, 0.1f, "21.5"}, {21.46f, 0.5f, "21.5"}, {99.99f, 1.0f, "100"}, {-3.14159f, 0.01f, "-3.14"},
+            {1234.5f, 10.0f, "1230"}, {22.0f, 0.1f, "22"}, {37.77f, 0.25f, "37.75"}
+    };
+
+    char buffer[F2S_MAX_LENGTH + 1];
+    unsigned long failures = 0;
+    for (auto &test : values) {
+        buffer[f2s_format(buffer, test.value)] = '\0';
+        failures += expect(buffer, test.expected);
+    }
+    for (auto &test : steps) {
+        buffer[f2s_format_step(buffer, test.value, test.step)] = '\0';
+        failures += expect(buffer, test.expected);
+    }
+    printf("values: %lu failures\n", failures);
+    return failures;
+}
+
+/**
+ * @brief Throughput for typical sensor values, compared to the "%1.15g" formatting used before
+ */
+static void benchmark() {
+    const uint32_t iterations = 10000000;
+    char buffer[32];
+    volatile size_t sink = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < iterations; i++) {
+        sink += f2s_format(buffer, 15.0f + (i % 4000) * 0.01f);
+    }
+    auto middle = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < iterations; i++) {
+        sink += snprintf(buffer, sizeof(buffer), "%1.15g", 15.0f + (i % 4000) * 0.01f);
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    printf("benchmark: f2s %.1f ns, printf %.1f ns per value\n",
+           std::chrono::duration<double, std::nano>(middle - start).count() / iterations,
+           std::chrono::duration<double, std::nano>(end - middle).count() / iterations);
+}
+
+int main(int argc, char **argv) {
+    uint32_t stride = argc > 1 ? strtoul(argv[1], nullptr, 10) : 1;
+    if (stride == 0) {
+        stride = 1;
+    }
+
+    unsigned long failures = testValues();
+    failures += testRoundTrip(stride);
+    failures += testShortest(stride * 4099);
+    benchmark();
+
+    printf("%s\n", failures ? "FAILED" : "OK");
+    return failures ? 1 : 0;
+}
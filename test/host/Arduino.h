@@ -0,0 +1,17 @@
+//
+// Minimal Arduino.h for the host tests in test/, only what the tested sources use
+//
+
+#ifndef HAP_SERVER_TEST_ARDUINO_H
+#define HAP_SERVER_TEST_ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "pgmspace.h"
+
+typedef uint8_t byte;
+
+#endif //HAP_SERVER_TEST_ARDUINO_H
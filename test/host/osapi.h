@@ -0,0 +1,20 @@
+//
+// Random numbers for the host tests, each test defines os_get_random
+//
+
+#ifndef HAP_SERVER_TEST_OSAPI_H
+#define HAP_SERVER_TEST_OSAPI_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int os_get_random(unsigned char *buf, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //HAP_SERVER_TEST_OSAPI_H
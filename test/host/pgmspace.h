@@ -0,0 +1,13 @@
+//
+// Flash access maps to plain memory on the host
+//
+
+#ifndef HAP_SERVER_TEST_PGMSPACE_H
+#define HAP_SERVER_TEST_PGMSPACE_H
+
+#include <string.h>
+
+#define PROGMEM
+#define memcpy_P memcpy
+
+#endif //HAP_SERVER_TEST_PGMSPACE_H
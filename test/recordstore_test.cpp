@@ -0,0 +1,268 @@
+//
+// Host test and benchmark for HKRecordStore.cpp on the HKFileFlash backend
+//
+// Build and run every sector count from the repository root:
+//   for n in 1 2 3 4; do g++ -O2 -std=gnu++11 -DHKSTORE_SECTORS=$n -I. -o recordstore_test test/recordstore_test.cpp HKRecordStore.cpp && ./recordstore_test || break; done
+//
+// Replays a HomeKit like workload (config number bumps, pairings added and removed, WiFi settings) against a
+// model of the expected values and cuts the power at random flash operations, including torn writes and
+// erases. After every cut the store is replayed from the file: each key has to hold its previous value, or the
+// value of the interrupted put. With a single sector a cut during compaction may lose the whole store instead.
+// Prints write amplification, erases and replay time.
+//
+
+#include "HKRecordStore.h"
+
+#include <chrono>
+#include <map>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+static const char *path = "recordstore_test.bin";
+
+/**
+ * @brief Passes everything to the file backend until the countdown runs out, then tears the operation
+ */
+class CutFlash : public HKFlash {
+public:
+    explicit CutFlash(HKFlash *flash) : flash(flash), countdown(-1), cut(false) {
+    }
+
+    bool read(uint8_t sector, uint16_t offset, void *data, size_t size) override {
+        return !cut && flash->read(sector, offset, data, size);
+    }
+
+    bool write(uint8_t sector, uint16_t offset, const void *data, size_t size) override {
+        if (cut || tick()) {
+            // Only a random prefix reaches the flash
+            size_t torn = size ? rand() % size : 0;
+            if (torn) {
+                flash->write(sector, offset, data, torn);
+            }
+            return false;
+        }
+        return flash->write(sector, offset, data, size);
+    }
+
+    bool erase(uint8_t sector) override {
+        if (cut || tick()) {
+            // A partial erase leaves random bits
+            flash->erase(sector);
+            uint8_t garbage[64];
+            for (uint8_t &byte : garbage) {
+                byte = rand();
+            }
+            flash->write(sector, (rand() % (HKSTORE_SECTOR_SIZE / sizeof(garbage))) * sizeof(garbage), garbage, sizeof(garbage));
+            return false;
+        }
+        return flash->erase(sector);
+    }
+
+    void arm(long operations) {
+        countdown = operations;
+        cut = false;
+    }
+
+    bool wasCut() const {
+        return cut;
+    }
+private:
+    bool tick() {
+        if (countdown >= 0 && countdown-- == 0) {
+            cut = true;
+        }
+        return cut;
+    }
+
+    HKFlash *flash;
+    long countdown;
+    bool cut;
+};
+
+typedef std::map<uint16_t, std::string> Model;
+
+static unsigned long failures = 0;
+
+static std::string read(HKRecordStore &store, uint16_t key) {
+    int size = store.get(key, nullptr, 0);
+    if (size < 0) {
+        return std::string();
+    }
+    std::string value(size, '\0');
+    store.get(key, &value[0], size);
+    return value;
+}
+
+/**
+ * @brief Next operation of the workload: mostly small config updates, sometimes pairings and WiFi settings
+ */
+static void nextOperation(uint16_t &key, std::string &value) {
+    int kind = rand() % 100;
+    size_t size;
+    if (kind < 60) {
+        key = 1;            // config number
+        size = 8;
+    } else if (kind < 90) {
+        key = 4 + rand() % 16;  // pairing slot
+        size = rand() % 4 ? 104 : 0;
+    } else {
+        key = 2 + rand() % 2;   // SSID, password
+        size = 1 + rand() % 64;
+    }
+    value.resize(size);
+    for (char &c : value) {
+        c = rand();
+    }
+}
+
+static bool apply(HKRecordStore &store, uint16_t key, const std::string &value) {
+    return value.empty() ? store.remove(key) : store.put(key, value.data(), value.size());
+}
+
+/**
+ * @brief Every key has to match the model, except the interrupted one which may also hold its new value
+ */
+static void verify(HKRecordStore &store, Model &model, uint16_t pendingKey, const std::string &pendingValue, bool cut) {
+    bool empty = true;
+    for (uint16_t key = 0; key < HKSTORE_MAX_KEYS; key++) {
+        empty &= !store.contains(key);
+    }
+    if (cut && empty && HKSTORE_SECTORS == 1) {
+        model.clear();
+        return;
+    }
+
+    for (uint16_t key = 0; key < HKSTORE_MAX_KEYS; key++) {
+        std::string value = read(store, key);
+        std::string expected = model.count(key) ? model[key] : std::string();
+        if (cut && key == pendingKey && value == pendingValue) {
+            expected = pendingValue;
+        }
+        if (value != expected) {
+            if (failures++ < 10) {
+                printf("key %u: %u bytes, expected %u bytes%s\n", key, (unsigned) value.size(), (unsigned) expected.size(), cut ? " after power cut" : "");
+            }
+        }
+        if (expected.empty()) {
+            model.erase(key);
+        } else {
+            model[key] = expected;
+        }
+    }
+}
+
+static void testWorkload(unsigned long operations) {
+    remove(path);
+    HKFileFlash file(path);
+    HKRecordStore store(&file);
+    if (!store.begin()) {
+        printf("begin failed\n");
+        failures++;
+        return;
+    }
+
+    Model model;
+    for (unsigned long i = 0; i < operations; i++) {
+        uint16_t key;
+        std::string value;
+        nextOperation(key, value);
+        if (!apply(store, key, value)) {
+            printf("operation %lu failed\n", i);
+            failures++;
+            return;
+        }
+        if (value.empty()) {
+            model.erase(key);
+        } else {
+            model[key] = value;
+        }
+    }
+    verify(store, model, 0, std::string(), false);
+
+    // Replay from flash
+    HKRecordStore replayed(&file);
+    replayed.begin();
+    verify(replayed, model, 0, std::string(), false);
+
+    const HKRecordStore::Stats &stats = store.getStats();
+    printf("workload: %lu operations, write amplification %.2f, %.1f erases per 1000 operations\n", operations,
+           (double) stats.flashBytes / stats.payloadBytes, stats.sectorErases * 1000.0 / operations);
+
+    const int replays = 1000;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < replays; i++) {
+        HKRecordStore store(&file);
+        store.begin();
+    }
+    auto end = std::chrono::steady_clock::now();
+    printf("replay: %.1f us, %u records\n", std::chrono::duration<double, std::micro>(end - start).count() / replays, replayed.getStats().replayedRecords);
+    remove(path);
+}
+
+static void testPowerCuts(int cuts) {
+    remove(path);
+    HKFileFlash file(path);
+    CutFlash flash(&file);
+    Model model;
+    int lost = 0;
+    {
+        HKRecordStore store(&flash);
+        store.begin();
+    }
+
+    for (int i = 0; i < cuts; i++) {
+        HKRecordStore store(&flash);
+        flash.arm(-1);
+        if (!store.begin()) {
+            printf("begin failed after %d cuts\n", i);
+            failures++;
+            return;
+        }
+        bool hadData = !model.empty();
+        verify(store, model, 0, std::string(), false);
+
+        // Run until the power is cut
+        uint16_t key = 0;
+        std::string value;
+        flash.arm(rand() % 400);
+        while (true) {
+            nextOperation(key, value);
+            if (!apply(store, key, value)) {
+                break;
+            }
+            if (value.empty()) {
+                model.erase(key);
+            } else {
+                model[key] = value;
+            }
+        }
+        if (!flash.wasCut()) {
+            printf("store failed without power cut\n");
+            failures++;
+            return;
+        }
+
+        flash.arm(-1);
+        HKRecordStore recovered(&flash);
+        if (!recovered.begin()) {
+            printf("begin failed after power cut\n");
+            failures++;
+            return;
+        }
+        verify(recovered, model, key, value, true);
+        lost += hadData && model.empty();
+    }
+    printf("power cuts: %d, store lost %d times\n", cuts, lost);
+    remove(path);
+}
+
+int main() {
+    srand(1);
+    printf("sectors: %d\n", HKSTORE_SECTORS);
+    testWorkload(100000);
+    testPowerCuts(2000);
+
+    printf("%s\n", failures ? "FAILED" : "OK");
+    return failures ? 1 : 0;
+}
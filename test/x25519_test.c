@@ -0,0 +1,174 @@
+/*
+ * Host test and benchmark for crypto/x25519.c and the field backends in crypto/fe25519*.h
+ *
+ * Build and run every backend from the repository root:
+ *   for b in 0 1 2; do cc -O2 -DFE25519_BACKEND=$b -Itest/host -o x25519_test test/x25519_test.c crypto/x25519.c crypto/tweetnacl.c && ./x25519_test || break; done
+ *
+ * Checks RFC 7748 section 5.2 (both single vectors, 1 and 1000 iterations of the ladder) and the section 6.1
+ * Diffie-Hellman example. 1000 ladders on pseudo random inputs are hashed, the digest has to be the same for
+ * every backend. Pass -m to also run the 1,000,000 iteration vector, which takes minutes.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../crypto/fe25519.h"
+#include "../crypto/tweetnacl.h"
+
+int os_get_random(unsigned char *buf, size_t len)
+{
+  size_t i;
+  for (i = 0; i < len; i++) buf[i] = rand();
+  return 0;
+}
+
+/* First 16 bytes of the SHA-512 over the outputs of testRandom(), taken from the reference backend */
+static const char randomDigest[] = "24b6097b8700f03da4d8acd6f4a32165";
+
+static int failures = 0;
+
+static void fromHex(unsigned char *target, const char *hex)
+{
+  size_t i;
+  for (i = 0; i < 32; i++) {
+    unsigned int byte;
+    sscanf(hex + 2 * i, "%2x", &byte);
+    target[i] = byte;
+  }
+}
+
+static void toHex(char *target, const unsigned char *data, size_t length)
+{
+  size_t i;
+  for (i = 0; i < length; i++) sprintf(target + 2 * i, "%02x", data[i]);
+}
+
+static void expect(const unsigned char *result, const char *expected, const char *what)
+{
+  char hex[65];
+  toHex(hex, result, 32);
+  if (strcmp(hex, expected) != 0) {
+    printf("%s: got %s, expected %s\n", what, hex, expected);
+    failures++;
+  }
+}
+
+static void testVectors(void)
+{
+  unsigned char scalar[32], u[32], out[32];
+
+  fromHex(scalar, "a546e36bf0527c9d3b16154b82465edd62144c0ac1fc5a18506a2244ba449ac4");
+  fromHex(u, "e6db6867583030db3594c1a424b15f7c726624ec26b3353b10a903a6d0ab1c4c");
+  crypto_scalarmult_curve25519(out, scalar, u);
+  expect(out, "c3da55379de9c6908e94ea4df28d084f32eccf03491c71f754b4075577a28552", "5.2 vector 1");
+
+  fromHex(scalar, "4b66e9d4d1b4673c5ad22691957d6af5c11b6421e0ea01d42ca4169e7918ba0d");
+  fromHex(u, "e5210f12786811d3f4b7959d0538ae2c31dbe7106fc03c3efc4cd549c715a493");
+  crypto_scalarmult_curve25519(out, scalar, u);
+  expect(out, "95cbde9476e8907d7aade45cb4b873f88b595a68799fa152e6f8f7647aac7957", "5.2 vector 2");
+}
+
+static void testIterations(int million)
+{
+  unsigned char k[32] = {9}, u[32] = {9}, out[32];
+  long i;
+  for (i = 1; i <= (million ? 1000000 : 1000); i++) {
+    crypto_scalarmult_curve25519(out, k, u);
+    memcpy(u, k, 32);
+    memcpy(k, out, 32);
+    if (i == 1) expect(k, "422c8e7a6227d7bca1350b3e2bb7279f7897b87bb6854b783c60e80311ae3079", "5.2 after 1 iteration");
+    if (i == 1000) expect(k, "684cf59ba83309552800ef566f2f4d3c1c3887c49360e3875f2eb94d99532c51", "5.2 after 1000 iterations");
+  }
+  if (million) expect(k, "7c3911e0ab2586fd864497297e575e6f3bc601c0883c30df5f4dd2d24f665424", "5.2 after 1000000 iterations");
+}
+
+static void testDiffieHellman(void)
+{
+  unsigned char alice[32], bob[32], alicePublic[32], bobPublic[32], aliceShared[32], bobShared[32];
+
+  fromHex(alice, "77076d0a7318a57d3c16c17251b26645df4c2f87ebc0992ab177fba51db92c2a");
+  fromHex(bob, "5dab087e624a8a4b79e17f8b83800ee66f3bb1292618b6fd1c2f8b27ff88e0eb");
+  crypto_scalarmult_curve25519_base(alicePublic, alice);
+  crypto_scalarmult_curve25519_base(bobPublic, bob);
+  expect(alicePublic, "8520f0098930a754748b7ddcb43ef75a0dbf3a0d26381af4eba4a98eaa9b4e6a", "6.1 Alice's public key");
+  expect(bobPublic, "de9edb7d7b7dc1b4d35b61c2ece435373f8343c85b78674dadfc7e146f882b4f", "6.1 Bob's public key");
+
+  crypto_scalarmult_curve25519(aliceShared, alice, bobPublic);
+  crypto_scalarmult_curve25519(bobShared, bob, alicePublic);
+  expect(aliceShared, "4a5d9d5ba4ce2de1728e3bf480350f25e07e21c947d19e3376f09b3c1e161742", "6.1 Alice's shared secret");
+  expect(bobShared, "4a5d9d5ba4ce2de1728e3bf480350f25e07e21c947d19e3376f09b3c1e161742", "6.1 Bob's shared secret");
+}
+
+/* xorshift64, so the inputs do not depend on the C library */
+static unsigned long long next(unsigned long long *state)
+{
+  *state ^= *state << 13;
+  *state ^= *state >> 7;
+  *state ^= *state << 17;
+  return *state;
+}
+
+/* Random scalars and points, including u coordinates at or above p, must give the same output on every backend */
+static void testRandom(void)
+{
+  unsigned char outputs[1000][32], digest[64], scalar[32], u[32];
+  char hex[129];
+  unsigned long long state = 0x9e3779b97f4a7c15ull;
+  int i, j;
+
+  for (i = 0; i < 1000; i++) {
+    for (j = 0; j < 32; j++) {
+      scalar[j] = next(&state);
+      u[j] = next(&state);
+    }
+    if (i % 10 == 0) memset(u, 0xff, 31);
+    crypto_scalarmult_curve25519(outputs[i], scalar, u);
+  }
+  crypto_hash_sha512(digest, outputs[0], sizeof(outputs));
+  toHex(hex, digest, 16);
+  printf("random digest: %s\n", hex);
+  if (strcmp(hex, randomDigest) != 0) {
+    printf("random ladders differ from the reference backend\n");
+    failures++;
+  }
+}
+
+static double now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Pair-verify M2 takes one multiplication with the base point and one with the controller's key */
+static void benchmark(void)
+{
+  unsigned char secret[32], publicKey[32], peer[32] = {9}, shared[32];
+  const int iterations = 1000;
+  double start;
+  int i;
+
+  memset(secret, 0x42, sizeof(secret));
+  start = now();
+  for (i = 0; i < iterations; i++) {
+    crypto_scalarmult_curve25519_base(publicKey, secret);
+    crypto_scalarmult_curve25519(shared, secret, peer);
+    peer[1] = shared[1];
+  }
+  printf("benchmark: %s %.1f us per pair-verify M2 key exchange\n", FE25519_BACKEND_NAME, (now() - start) * 1e6 / iterations);
+}
+
+int main(int argc, char **argv)
+{
+  printf("backend: %s\n", FE25519_BACKEND_NAME);
+  testVectors();
+  testIterations(argc > 1 && strcmp(argv[1], "-m") == 0);
+  testDiffieHellman();
+  testRandom();
+  benchmark();
+
+  printf("%s\n", failures ? "FAILED" : "OK");
+  return failures ? 1 : 0;
+}